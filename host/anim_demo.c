@@ -0,0 +1,216 @@
+/* Generated by tools/oled_anim.py */
+#include "oled.h"
+
+const uint8_t anim_demo[] PROGMEM = {
+	0x30, 0x00, 0x80, 0x08,	/* 48 frames, 128x64 */
+	/* frame 0 */
+	0x07, 0x00, 0x80, 0x03, 0xFF, 0xFF, 0xF3, 0xF3, 0x83, 0x03, 0x83, 0xF3, 0x83, 0x03, 0x83, 0xF3,
+	0x83, 0x03, 0x83, 0xF3, 0x83, 0x03, 0x83, 0xF3, 0x83, 0x03, 0x83, 0xF3, 0x83, 0x03, 0x83, 0xF3,
+	0x83, 0x03, 0x83, 0xF3, 0x83, 0x03, 0x83, 0xF3, 0x83, 0x03, 0x83, 0xF3, 0x83, 0x03, 0x83, 0xF3,
+	0x83, 0x03, 0x83, 0xF3, 0x83, 0x03, 0x83, 0xF3, 0x83, 0x03, 0x83, 0xF3, 0x83, 0x03, 0x83, 0xF3,
+	0x83, 0x03, 0x83, 0xF3, 0x01, 0x03, 0x03, 0x83, 0xFF, 0x01, 0xF0, 0xF0, 0x83, 0x0F, 0x83, 0xF0,
+	0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0,
+	0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0,
+	0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0,
+	0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0, 0x01, 0x0F, 0x0F, 0x83, 0xFF, 0x01, 0xF0, 0xF0,
+	0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0,
+	0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0,
+	0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0,
+	0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0, 0x01, 0x0F, 0x0F, 0x83,
+	0xFF, 0xFB, 0x00, 0x83, 0xFF, 0x84, 0x00, 0x01, 0xE0, 0xF0, 0x82, 0xF8, 0x00, 0xFC, 0x82, 0xF8,
+	0x01, 0xF0, 0xE0, 0xEB, 0x00, 0x83, 0xFF, 0x83, 0x00, 0x02, 0x01, 0x0F, 0x1F, 0x82, 0x3F, 0x00,
+	0x7F, 0x82, 0x3F, 0x02, 0x1F, 0x0F, 0x01, 0xEA, 0x00, 0x83, 0xFF, 0x85, 0x00, 0x01, 0xFC, 0xFC,
+	0xF3, 0x00, 0x83, 0xFF, 0xFB, 0xC0, 0x01, 0xFF, 0xFF, 0xFF,
+	/* frame 1 */
+	0x36, 0x06, 0x0F, 0x84, 0x00, 0x82, 0x80, 0x00, 0xC0, 0x82, 0x80, 0x84, 0x00, 0x01, 0x10, 0xFE,
+	0x88, 0xFF, 0x01, 0xFE, 0x10, 0x83, 0x00, 0x00, 0x01, 0x82, 0x03, 0x00, 0x07, 0x82, 0x03, 0x00,
+	0x01, 0x83, 0x00, 0x83, 0xFC, 0x88, 0x00, 0xFF,
+	/* frame 2 */
+	0x36, 0x08, 0x0F, 0x82, 0x00, 0x01, 0xC0, 0xE0, 0x82, 0xF0, 0x00, 0xF8, 0x82, 0xF0, 0x01, 0xE0,
+	0xC0, 0x82, 0x00, 0x02, 0x02, 0x1F, 0x3F, 0x82, 0x7F, 0x00, 0xFF, 0x82, 0x7F, 0x02, 0x3F, 0x1F,
+	0x02, 0x8E, 0x00, 0x86, 0xFC, 0x87, 0x00, 0xFF,
+	/* frame 3 */
+	0x36, 0x0A, 0x0F, 0x04, 0x00, 0x00, 0x40, 0xF8, 0xFC, 0x82, 0xFE, 0x00, 0xFF, 0x82, 0xFE, 0x02,
+	0xFC, 0xF8, 0x40, 0x82, 0x00, 0x01, 0x03, 0x07, 0x82, 0x0F, 0x00, 0x1F, 0x82, 0x0F, 0x01, 0x07,
+	0x03, 0x8F, 0x00, 0x86, 0xFC, 0x87, 0x00, 0xFF,
+	/* frame 4 */
+	0x26, 0x0C, 0x0F, 0x83, 0x0F, 0x00, 0xF0, 0x82, 0x70, 0x00, 0xCF, 0x82, 0x8F, 0x82, 0xF0, 0x03,
+	0x00, 0x00, 0x10, 0xFE, 0x88, 0xFF, 0x01, 0xFE, 0x10, 0x83, 0x00, 0x00, 0x01, 0x82, 0x03, 0x00,
+	0x07, 0x82, 0x03, 0x00, 0x01, 0x90, 0x00, 0x86, 0xFC, 0x87, 0x00, 0xFF,
+	/* frame 5 */
+	0x26, 0x0E, 0x0F, 0x12, 0x0F, 0x0F, 0xF0, 0xF0, 0x70, 0x30, 0xCF, 0xCF, 0xEF, 0xCF, 0x30, 0x30,
+	0x70, 0xF0, 0x0F, 0x00, 0x00, 0x08, 0x7F, 0x88, 0xFF, 0x01, 0x7F, 0x08, 0x84, 0x00, 0x82, 0x01,
+	0x00, 0x03, 0x82, 0x01, 0x91, 0x00, 0x87, 0xFC, 0x86, 0x00, 0xFF,
+	/* frame 6 */
+	0x26, 0x10, 0x0F, 0x82, 0xF0, 0x01, 0x70, 0xCF, 0x82, 0xEF, 0x00, 0x00, 0x82, 0x10, 0x07, 0xCF,
+	0x8F, 0x0F, 0x00, 0x00, 0x04, 0x3F, 0x7F, 0x86, 0xFF, 0x02, 0x7F, 0x3F, 0x04, 0x87, 0x00, 0x00,
+	0x01, 0x94, 0x00, 0x87, 0xFC, 0x86, 0x00, 0xFF,
+	/* frame 7 */
+	0x26, 0x12, 0x0F, 0x12, 0xF0, 0xF0, 0x0F, 0x0F, 0x8F, 0xCF, 0x30, 0x30, 0x10, 0x30, 0xCF, 0xCF,
+	0x8F, 0x0F, 0xF0, 0x00, 0x00, 0x08, 0x7F, 0x88, 0xFF, 0x01, 0x7F, 0x08, 0x84, 0x00, 0x82, 0x01,
+	0x00, 0x03, 0x82, 0x01, 0x91, 0x00, 0x87, 0xFC, 0x86, 0x00, 0xFF,
+	/* frame 8 */
+	0x26, 0x14, 0x0F, 0x83, 0x0F, 0x00, 0xF0, 0x82, 0x70, 0x00, 0xCF, 0x82, 0x8F, 0x82, 0xF0, 0x03,
+	0x00, 0x00, 0x10, 0xFE, 0x88, 0xFF, 0x01, 0xFE, 0x10, 0x83, 0x00, 0x00, 0x01, 0x82, 0x03, 0x00,
+	0x07, 0x82, 0x03, 0x00, 0x01, 0x90, 0x00, 0x88, 0xFC, 0x85, 0x00, 0xFF,
+	/* frame 9 */
+	0x26, 0x16, 0x0F, 0x01, 0x0F, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0, 0x05, 0x0F, 0x00, 0x00,
+	0x40, 0xF8, 0xFC, 0x82, 0xFE, 0x00, 0xFF, 0x82, 0xFE, 0x02, 0xFC, 0xF8, 0x40, 0x82, 0x00, 0x01,
+	0x03, 0x07, 0x82, 0x0F, 0x00, 0x1F, 0x82, 0x0F, 0x01, 0x07, 0x03, 0x8F, 0x00, 0x88, 0xFC, 0x85,
+	0x00, 0xFF,
+	/* frame 10 */
+	0x36, 0x18, 0x0F, 0x82, 0x00, 0x01, 0xC0, 0xE0, 0x82, 0xF0, 0x00, 0xF8, 0x82, 0xF0, 0x01, 0xE0,
+	0xC0, 0x82, 0x00, 0x02, 0x02, 0x1F, 0x3F, 0x82, 0x7F, 0x00, 0xFF, 0x82, 0x7F, 0x02, 0x3F, 0x1F,
+	0x02, 0x8E, 0x00, 0x88, 0xFC, 0x85, 0x00, 0xFF,
+	/* frame 11 */
+	0x36, 0x1A, 0x0F, 0x84, 0x00, 0x82, 0x80, 0x00, 0xC0, 0x82, 0x80, 0x84, 0x00, 0x01, 0x10, 0xFE,
+	0x88, 0xFF, 0x01, 0xFE, 0x10, 0x83, 0x00, 0x00, 0x01, 0x82, 0x03, 0x00, 0x07, 0x82, 0x03, 0x02,
+	0x01, 0x00, 0x00, 0x89, 0xFC, 0x84, 0x00, 0xFF,
+	/* frame 12 */
+	0x36, 0x1C, 0x0F, 0x91, 0x00, 0x01, 0xE0, 0xF0, 0x82, 0xF8, 0x00, 0xFC, 0x82, 0xF8, 0x01, 0xF0,
+	0xE0, 0x82, 0x00, 0x02, 0x01, 0x0F, 0x1F, 0x82, 0x3F, 0x00, 0x7F, 0x82, 0x3F, 0x02, 0x1F, 0x0F,
+	0x01, 0x89, 0xFC, 0x84, 0x00, 0xFF,
+	/* frame 13 */
+	0x36, 0x1E, 0x0F, 0x84, 0x00, 0x82, 0x80, 0x00, 0xC0, 0x82, 0x80, 0x84, 0x00, 0x01, 0x10, 0xFE,
+	0x88, 0xFF, 0x01, 0xFE, 0x10, 0x83, 0x00, 0x00, 0x01, 0x82, 0x03, 0x00, 0x07, 0x82, 0x03, 0x02,
+	0x01, 0x00, 0x00, 0x89, 0xFC, 0x84, 0x00, 0xFF,
+	/* frame 14 */
+	0x36, 0x20, 0x0F, 0x82, 0x00, 0x01, 0xC0, 0xE0, 0x82, 0xF0, 0x00, 0xF8, 0x82, 0xF0, 0x01, 0xE0,
+	0xC0, 0x82, 0x00, 0x02, 0x02, 0x1F, 0x3F, 0x82, 0x7F, 0x00, 0xFF, 0x82, 0x7F, 0x02, 0x3F, 0x1F,
+	0x02, 0x8E, 0x00, 0x8A, 0xFC, 0x83, 0x00, 0xFF,
+	/* frame 15 */
+	0x36, 0x22, 0x0F, 0x04, 0x00, 0x00, 0x40, 0xF8, 0xFC, 0x82, 0xFE, 0x00, 0xFF, 0x82, 0xFE, 0x02,
+	0xFC, 0xF8, 0x40, 0x82, 0x00, 0x01, 0x03, 0x07, 0x82, 0x0F, 0x00, 0x1F, 0x82, 0x0F, 0x01, 0x07,
+	0x03, 0x8F, 0x00, 0x8A, 0xFC, 0x83, 0x00, 0xFF,
+	/* frame 16 */
+	0x26, 0x24, 0x0F, 0x83, 0x0F, 0x00, 0xF0, 0x82, 0x70, 0x00, 0xCF, 0x82, 0x8F, 0x82, 0xF0, 0x03,
+	0x00, 0x00, 0x10, 0xFE, 0x88, 0xFF, 0x01, 0xFE, 0x10, 0x83, 0x00, 0x00, 0x01, 0x82, 0x03, 0x00,
+	0x07, 0x82, 0x03, 0x00, 0x01, 0x90, 0x00, 0x8A, 0xFC, 0x83, 0x00, 0xFF,
+	/* frame 17 */
+	0x26, 0x26, 0x0F, 0x12, 0x0F, 0x0F, 0xF0, 0xF0, 0x70, 0x30, 0xCF, 0xCF, 0xEF, 0xCF, 0x30, 0x30,
+	0x70, 0xF0, 0x0F, 0x00, 0x00, 0x08, 0x7F, 0x88, 0xFF, 0x01, 0x7F, 0x08, 0x84, 0x00, 0x82, 0x01,
+	0x00, 0x03, 0x82, 0x01, 0x91, 0x00, 0x8B, 0xFC, 0x82, 0x00, 0xFF,
+	/* frame 18 */
+	0x26, 0x28, 0x0F, 0x82, 0xF0, 0x01, 0x70, 0xCF, 0x82, 0xEF, 0x00, 0x00, 0x82, 0x10, 0x07, 0xCF,
+	0x8F, 0x0F, 0x00, 0x00, 0x04, 0x3F, 0x7F, 0x86, 0xFF, 0x02, 0x7F, 0x3F, 0x04, 0x87, 0x00, 0x00,
+	0x01, 0x94, 0x00, 0x8B, 0xFC, 0x82, 0x00, 0xFF,
+	/* frame 19 */
+	0x26, 0x2A, 0x0F, 0x12, 0xF0, 0xF0, 0x0F, 0x0F, 0x8F, 0xCF, 0x30, 0x30, 0x10, 0x30, 0xCF, 0xCF,
+	0x8F, 0x0F, 0xF0, 0x00, 0x00, 0x08, 0x7F, 0x88, 0xFF, 0x01, 0x7F, 0x08, 0x84, 0x00, 0x82, 0x01,
+	0x00, 0x03, 0x82, 0x01, 0x91, 0x00, 0x8B, 0xFC, 0x82, 0x00, 0xFF,
+	/* frame 20 */
+	0x26, 0x2C, 0x0F, 0x83, 0x0F, 0x00, 0xF0, 0x82, 0x70, 0x00, 0xCF, 0x82, 0x8F, 0x82, 0xF0, 0x03,
+	0x00, 0x00, 0x10, 0xFE, 0x88, 0xFF, 0x01, 0xFE, 0x10, 0x83, 0x00, 0x00, 0x01, 0x82, 0x03, 0x00,
+	0x07, 0x82, 0x03, 0x00, 0x01, 0x90, 0x00, 0x8C, 0xFC, 0x01, 0x00, 0x00, 0xFF,
+	/* frame 21 */
+	0x26, 0x2E, 0x0F, 0x01, 0x0F, 0x0F, 0x83, 0xF0, 0x83, 0x0F, 0x83, 0xF0, 0x05, 0x0F, 0x00, 0x00,
+	0x40, 0xF8, 0xFC, 0x82, 0xFE, 0x00, 0xFF, 0x82, 0xFE, 0x02, 0xFC, 0xF8, 0x40, 0x82, 0x00, 0x01,
+	0x03, 0x07, 0x82, 0x0F, 0x00, 0x1F, 0x82, 0x0F, 0x01, 0x07, 0x03, 0x8F, 0x00, 0x8C, 0xFC, 0x01,
+	0x00, 0x00, 0xFF,
+	/* frame 22 */
+	0x36, 0x30, 0x0F, 0x82, 0x00, 0x01, 0xC0, 0xE0, 0x82, 0xF0, 0x00, 0xF8, 0x82, 0xF0, 0x01, 0xE0,
+	0xC0, 0x82, 0x00, 0x02, 0x02, 0x1F, 0x3F, 0x82, 0x7F, 0x00, 0xFF, 0x82, 0x7F, 0x02, 0x3F, 0x1F,
+	0x02, 0x8E, 0x00, 0x8C, 0xFC, 0x01, 0x00, 0x00, 0xFF,
+	/* frame 23 */
+	0x36, 0x32, 0x0F, 0x84, 0x00, 0x82, 0x80, 0x00, 0xC0, 0x82, 0x80, 0x84, 0x00, 0x01, 0x10, 0xFE,
+	0x88, 0xFF, 0x01, 0xFE, 0x10, 0x83, 0x00, 0x00, 0x01, 0x82, 0x03, 0x00, 0x07, 0x82, 0x03, 0x02,
+	0x01, 0x00, 0x00, 0x8D, 0xFC, 0x00, 0x00, 0xFF,
+	/* frame 24 */
+	0x36, 0x34, 0x0F, 0x91, 0x00, 0x01, 0xE0, 0xF0, 0x82, 0xF8, 0x00, 0xFC, 0x82, 0xF8, 0x01, 0xF0,
+	0xE0, 0x82, 0x00, 0x02, 0x01, 0x0F, 0x1F, 0x82, 0x3F, 0x00, 0x7F, 0x82, 0x3F, 0x02, 0x1F, 0x0F,
+	0x01, 0x8D, 0xFC, 0x00, 0x00, 0xFF,
+	/* frame 25 */
+	0x36, 0x36, 0x0F, 0x84, 0x00, 0x82, 0x80, 0x00, 0xC0, 0x82, 0x80, 0x84, 0x00, 0x01, 0x10, 0xFE,
+	0x88, 0xFF, 0x01, 0xFE, 0x10, 0x83, 0x00, 0x00, 0x01, 0x82, 0x03, 0x00, 0x07, 0x82, 0x03, 0x02,
+	0x01, 0x00, 0x00, 0x8D, 0xFC, 0x00, 0x00, 0xFF,
+	/* frame 26 */
+	0x36, 0x38, 0x0F, 0x82, 0x00, 0x01, 0xC0, 0xE0, 0x82, 0xF0, 0x00, 0xF8, 0x82, 0xF0, 0x01, 0xE0,
+	0xC0, 0x82, 0x00, 0x02, 0x02, 0x1F, 0x3F, 0x82, 0x7F, 0x00, 0xFF, 0x82, 0x7F, 0x02, 0x3F, 0x1F,
+	0x02, 0x8E, 0x00, 0x8E, 0xFC, 0xFF,
+	/* frame 27 */
+	0x36, 0x3A, 0x0F, 0x04, 0x00, 0x00, 0x40, 0xF8, 0xFC, 0x82, 0xFE, 0x00, 0xFF, 0x82, 0xFE, 0x02,
+	0xFC, 0xF8, 0x40, 0x82, 0x00, 0x01, 0x03, 0x07, 0x82, 0x0F, 0x00, 0x1F, 0x82, 0x0F, 0x01, 0x07,
+	0x03, 0x8F, 0x00, 0x8E, 0xFC, 0xFF,
+	/* frame 28 */
+	0x26, 0x3C, 0x0F, 0x83, 0x0F, 0x00, 0xF0, 0x82, 0x70, 0x00, 0xCF, 0x82, 0x8F, 0x82, 0xF0, 0x03,
+	0x00, 0x00, 0x10, 0xFE, 0x88, 0xFF, 0x01, 0xFE, 0x10, 0x83, 0x00, 0x00, 0x01, 0x82, 0x03, 0x00,
+	0x07, 0x82, 0x03, 0x00, 0x01, 0x90, 0x00, 0x8E, 0xFC, 0xFF,
+	/* frame 29 */
+	0x26, 0x3E, 0x10, 0x13, 0x0F, 0x0F, 0xF0, 0xF0, 0x70, 0x30, 0xCF, 0xCF, 0xEF, 0xCF, 0x30, 0x30,
+	0x70, 0xF0, 0x0F, 0x0F, 0x00, 0x00, 0x08, 0x7F, 0x88, 0xFF, 0x01, 0x7F, 0x08, 0x85, 0x00, 0x82,
+	0x01, 0x00, 0x03, 0x82, 0x01, 0x93, 0x00, 0x8F, 0xFC, 0xFF,
+	/* frame 30 */
+	0x26, 0x40, 0x10, 0x82, 0xF0, 0x01, 0x70, 0xCF, 0x82, 0xEF, 0x00, 0x00, 0x82, 0x10, 0x08, 0xCF,
+	0x8F, 0x0F, 0x0F, 0x00, 0x00, 0x04, 0x3F, 0x7F, 0x86, 0xFF, 0x02, 0x7F, 0x3F, 0x04, 0x88, 0x00,
+	0x00, 0x01, 0x96, 0x00, 0x8F, 0xFC, 0xFF,
+	/* frame 31 */
+	0x26, 0x42, 0x10, 0x13, 0xF0, 0xF0, 0x0F, 0x0F, 0x8F, 0xCF, 0x30, 0x30, 0x10, 0x30, 0xCF, 0xCF,
+	0x8F, 0x0F, 0xF0, 0xF0, 0x00, 0x00, 0x08, 0x7F, 0x88, 0xFF, 0x01, 0x7F, 0x08, 0x85, 0x00, 0x82,
+	0x01, 0x00, 0x03, 0x82, 0x01, 0x93, 0x00, 0x8F, 0xFC, 0xFF,
+	/* frame 32 */
+	0x26, 0x44, 0x11, 0x83, 0x0F, 0x00, 0xF0, 0x82, 0x70, 0x00, 0xCF, 0x82, 0x8F, 0x83, 0xF0, 0x04,
+	0x0F, 0x00, 0x00, 0x10, 0xFE, 0x88, 0xFF, 0x01, 0xFE, 0x10, 0x85, 0x00, 0x00, 0x01, 0x82, 0x03,
+	0x00, 0x07, 0x82, 0x03, 0x00, 0x01, 0x94, 0x00, 0x90, 0xFC, 0xFF,
+	/* frame 33 */
+	0x22, 0x49, 0x07, 0x82, 0xF0, 0x83, 0x0F, 0x33, 0x46, 0x0F, 0x04, 0x00, 0x00, 0x40, 0xF8, 0xFC,
+	0x82, 0xFE, 0x00, 0xFF, 0x82, 0xFE, 0x02, 0xFC, 0xF8, 0x40, 0x44, 0x48, 0x0C, 0x02, 0x00, 0x03,
+	0x07, 0x82, 0x0F, 0x00, 0x1F, 0x82, 0x0F, 0x01, 0x07, 0x03, 0x66, 0x55, 0x02, 0x01, 0xFC, 0xFC,
+	0xFF,
+	/* frame 34 */
+	0x33, 0x48, 0x0E, 0x82, 0x00, 0x01, 0xC0, 0xE0, 0x82, 0xF0, 0x00, 0xF8, 0x82, 0xF0, 0x01, 0xE0,
+	0xC0, 0x44, 0x49, 0x0E, 0x03, 0x00, 0x02, 0x1F, 0x3F, 0x82, 0x7F, 0x00, 0xFF, 0x82, 0x7F, 0x02,
+	0x3F, 0x1F, 0x02, 0x66, 0x57, 0x02, 0x01, 0xFC, 0xFC, 0xFF,
+	/* frame 35 */
+	0x36, 0x4A, 0x12, 0x84, 0x00, 0x82, 0x80, 0x00, 0xC0, 0x82, 0x80, 0x87, 0x00, 0x01, 0x10, 0xFE,
+	0x88, 0xFF, 0x01, 0xFE, 0x10, 0x86, 0x00, 0x00, 0x01, 0x82, 0x03, 0x00, 0x07, 0x82, 0x03, 0x00,
+	0x01, 0x84, 0x00, 0x91, 0xFC, 0xFF,
+	/* frame 36 */
+	0x36, 0x4C, 0x12, 0x94, 0x00, 0x01, 0xE0, 0xF0, 0x82, 0xF8, 0x00, 0xFC, 0x82, 0xF8, 0x01, 0xF0,
+	0xE0, 0x85, 0x00, 0x02, 0x01, 0x0F, 0x1F, 0x82, 0x3F, 0x00, 0x7F, 0x82, 0x3F, 0x02, 0x1F, 0x0F,
+	0x01, 0x82, 0x00, 0x91, 0xFC, 0xFF,
+	/* frame 37 */
+	0x36, 0x4E, 0x12, 0x84, 0x00, 0x82, 0x80, 0x00, 0xC0, 0x82, 0x80, 0x87, 0x00, 0x01, 0x10, 0xFE,
+	0x88, 0xFF, 0x01, 0xFE, 0x10, 0x86, 0x00, 0x00, 0x01, 0x82, 0x03, 0x00, 0x07, 0x82, 0x03, 0x00,
+	0x01, 0x84, 0x00, 0x91, 0xFC, 0xFF,
+	/* frame 38 */
+	0x36, 0x50, 0x13, 0x82, 0x00, 0x01, 0xC0, 0xE0, 0x82, 0xF0, 0x00, 0xF8, 0x82, 0xF0, 0x01, 0xE0,
+	0xC0, 0x86, 0x00, 0x02, 0x02, 0x1F, 0x3F, 0x82, 0x7F, 0x00, 0xFF, 0x82, 0x7F, 0x02, 0x3F, 0x1F,
+	0x02, 0x96, 0x00, 0x92, 0xFC, 0xFF,
+	/* frame 39 */
+	0x33, 0x53, 0x0E, 0x03, 0x00, 0x40, 0xF8, 0xFC, 0x82, 0xFE, 0x00, 0xFF, 0x82, 0xFE, 0x02, 0xFC,
+	0xF8, 0x40, 0x44, 0x52, 0x0E, 0x82, 0x00, 0x01, 0x03, 0x07, 0x82, 0x0F, 0x00, 0x1F, 0x82, 0x0F,
+	0x01, 0x07, 0x03, 0x66, 0x63, 0x02, 0x01, 0xFC, 0xFC, 0xFF,
+	/* frame 40 */
+	0x22, 0x59, 0x07, 0x82, 0x70, 0x00, 0xCF, 0x82, 0x8F, 0x33, 0x54, 0x0F, 0x03, 0x00, 0x00, 0x10,
+	0xFE, 0x88, 0xFF, 0x01, 0xFE, 0x10, 0x44, 0x55, 0x0C, 0x82, 0x00, 0x00, 0x01, 0x82, 0x03, 0x00,
+	0x07, 0x82, 0x03, 0x00, 0x01, 0x66, 0x65, 0x02, 0x01, 0xFC, 0xFC, 0xFF,
+	/* frame 41 */
+	0x22, 0x59, 0x0A, 0x09, 0xF0, 0x70, 0x30, 0xCF, 0xCF, 0xEF, 0xCF, 0x30, 0x30, 0x70, 0x33, 0x56,
+	0x0F, 0x03, 0x00, 0x00, 0x08, 0x7F, 0x88, 0xFF, 0x01, 0x7F, 0x08, 0x44, 0x58, 0x0A, 0x82, 0x00,
+	0x82, 0x01, 0x00, 0x03, 0x82, 0x01, 0x66, 0x67, 0x03, 0x82, 0xFC, 0xFF,
+	/* frame 42 */
+	0x22, 0x5A, 0x0C, 0x02, 0xF0, 0x70, 0xCF, 0x82, 0xEF, 0x00, 0x00, 0x82, 0x10, 0x01, 0xCF, 0x8F,
+	0x33, 0x58, 0x0F, 0x04, 0x00, 0x00, 0x04, 0x3F, 0x7F, 0x86, 0xFF, 0x02, 0x7F, 0x3F, 0x04, 0x44,
+	0x5B, 0x07, 0x84, 0x00, 0x01, 0x01, 0x00, 0x66, 0x6A, 0x02, 0x01, 0xFC, 0xFC, 0xFF,
+	/* frame 43 */
+	0x22, 0x5B, 0x0C, 0x0B, 0xF0, 0x0F, 0x0F, 0x8F, 0xCF, 0x30, 0x30, 0x10, 0x30, 0xCF, 0xCF, 0x8F,
+	0x33, 0x5A, 0x0F, 0x03, 0x00, 0x00, 0x08, 0x7F, 0x88, 0xFF, 0x01, 0x7F, 0x08, 0x44, 0x5F, 0x07,
+	0x82, 0x01, 0x00, 0x03, 0x82, 0x01, 0x66, 0x6C, 0x02, 0x01, 0xFC, 0xFC, 0xFF,
+	/* frame 44 */
+	0x22, 0x5E, 0x0A, 0x02, 0x0F, 0x0F, 0xF0, 0x82, 0x70, 0x00, 0xCF, 0x82, 0x8F, 0x33, 0x5C, 0x0F,
+	0x03, 0x00, 0x00, 0x10, 0xFE, 0x88, 0xFF, 0x01, 0xFE, 0x10, 0x44, 0x5F, 0x0A, 0x01, 0x00, 0x01,
+	0x82, 0x03, 0x00, 0x07, 0x82, 0x03, 0x00, 0x01, 0x66, 0x6E, 0x03, 0x82, 0xFC, 0xFF,
+	/* frame 45 */
+	0x22, 0x61, 0x07, 0x82, 0xF0, 0x83, 0x0F, 0x33, 0x5E, 0x0F, 0x04, 0x00, 0x00, 0x40, 0xF8, 0xFC,
+	0x82, 0xFE, 0x00, 0xFF, 0x82, 0xFE, 0x02, 0xFC, 0xF8, 0x40, 0x44, 0x60, 0x0C, 0x02, 0x00, 0x03,
+	0x07, 0x82, 0x0F, 0x00, 0x1F, 0x82, 0x0F, 0x01, 0x07, 0x03, 0x66, 0x71, 0x02, 0x01, 0xFC, 0xFC,
+	0xFF,
+	/* frame 46 */
+	0x33, 0x60, 0x0E, 0x82, 0x00, 0x01, 0xC0, 0xE0, 0x82, 0xF0, 0x00, 0xF8, 0x82, 0xF0, 0x01, 0xE0,
+	0xC0, 0x44, 0x61, 0x0E, 0x03, 0x00, 0x02, 0x1F, 0x3F, 0x82, 0x7F, 0x00, 0xFF, 0x82, 0x7F, 0x02,
+	0x3F, 0x1F, 0x02, 0x66, 0x73, 0x02, 0x01, 0xFC, 0xFC, 0xFF,
+	/* frame 47 */
+	0x33, 0x63, 0x0B, 0x83, 0x00, 0x82, 0x80, 0x00, 0xC0, 0x82, 0x80, 0x44, 0x62, 0x0F, 0x03, 0x00,
+	0x00, 0x10, 0xFE, 0x88, 0xFF, 0x01, 0xFE, 0x10, 0x55, 0x66, 0x09, 0x00, 0x01, 0x82, 0x03, 0x00,
+	0x07, 0x82, 0x03, 0x00, 0x01, 0x66, 0x75, 0x03, 0x82, 0xFC, 0xFF,
+};
@@ -0,0 +1,44 @@
+#!/usr/bin/env python3
+"""Makes frames of demo animation used by host/bench.c, as a PBM strip.
+Regenerate host/anim_demo.c with:
+	host/anim_demo.py > /tmp/demo.pbm
+	tools/oled_anim.py -n anim_demo --frame-height 64 /tmp/demo.pbm > host/anim_demo.c
+"""
+import sys
+
+WIDTH, HEIGHT, FRAMES = 128, 64, 48
+
+
+def frame(n):
+    px = [[0] * WIDTH for _ in range(HEIGHT)]
+    # Static border and checkered background of the upper half
+    for x in range(WIDTH):
+        for y in range(HEIGHT):
+            if x < 2 or x >= WIDTH - 2 or y < 2 or y >= HEIGHT - 2:
+                px[y][x] = 1
+            elif 4 <= y < 24 and (x // 4 + y // 4) % 2:
+                px[y][x] = 1
+    # Ball bouncing across the screen
+    bx = 12 + n * 2
+    by = 40 - int(28 * abs((n % 24) - 12) * (24 - abs((n % 24) - 12) * 2) / 144)
+    for x in range(bx - 6, bx + 7):
+        for y in range(by - 6, by + 7):
+            if (x - bx) ** 2 + (y - by) ** 2 <= 36 and 0 <= x < WIDTH and 0 <= y < HEIGHT:
+                px[y][x] ^= 1
+    # Progress bar
+    for x in range(8, 8 + 112 * (n + 1) // FRAMES):
+        for y in range(50, 56):
+            px[y][x] = 1
+    return px
+
+
+def main():
+    rows = [row for n in range(FRAMES) for row in frame(n)]
+    out = sys.stdout.buffer
+    out.write(b'P4\n%d %d\n' % (WIDTH, len(rows)))
+    for row in rows:
+        out.write(bytes(sum(row[x + b] << (7 - b) for b in range(8)) for x in range(0, WIDTH, 8)))
+
+
+if __name__ == '__main__':
+    main()
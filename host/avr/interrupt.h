@@ -0,0 +1,16 @@
+/* Host stand-in for <avr/interrupt.h>. See host/sim.h */
+#ifndef OLED_HOST_AVR_INTERRUPT_H
+#define OLED_HOST_AVR_INTERRUPT_H
+
+#include "io.h"
+
+#define sei() do { SREG |= _BV(SREG_I); } while (0)
+#define cli() do { SREG &= (uint8_t)~_BV(SREG_I); } while (0)
+
+/* Vectors are ordinary functions called by the simulator */
+#define ISR_BLOCK
+#define ISR_NOBLOCK
+#define ISR_NAKED
+#define ISR(vector, ...) void vector(void); void vector(void)
+
+#endif /* OLED_HOST_AVR_INTERRUPT_H */
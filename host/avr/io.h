@@ -0,0 +1,112 @@
+/* Host stand-in for <avr/io.h>. See host/sim.h */
+#ifndef OLED_HOST_AVR_IO_H
+#define OLED_HOST_AVR_IO_H
+
+#include "../sim.h"
+
+#define _BV(bit) (1 << (bit))
+
+#define SREG	(*sim_reg(SIM_SREG))
+#define SREG_I	7
+
+/* TWI peripheral. Bit positions match ATmega328p */
+#define TWBR	(*sim_reg(SIM_TWBR))
+#define TWSR	(*sim_reg(SIM_TWSR))
+#define TWAR	(*sim_reg(SIM_TWAR))
+#define TWDR	(*sim_reg(SIM_TWDR))
+#define TWCR	(*sim_reg(SIM_TWCR))
+#define PRR	(*sim_reg(SIM_PRR))
+
+#define TWINT	7
+#define TWEA	6
+#define TWSTA	5
+#define TWSTO	4
+#define TWWC	3
+#define TWEN	2
+#define TWIE	0
+
+#define TWS7	7
+#define TWS6	6
+#define TWS5	5
+#define TWS4	4
+#define TWS3	3
+#define TWPS1	1
+#define TWPS0	0
+
+#define PRTWI	7
+
+/* SPI */
+#define SPCR	(*sim_reg(SIM_SPCR))
+#define SPSR	(*sim_reg(SIM_SPSR))
+#define SPDR	(*sim_reg(SIM_SPDR))
+
+#define SPIE	7
+#define SPE	6
+#define DORD	5
+#define MSTR	4
+#define CPOL	3
+#define CPHA	2
+#define SPR1	1
+#define SPR0	0
+
+#define SPIF	7
+#define WCOL	6
+#define SPI2X	0
+
+/* USART0, bits as in master SPI mode */
+#define UCSR0A	(*sim_reg(SIM_UCSR0A))
+#define UCSR0B	(*sim_reg(SIM_UCSR0B))
+#define UCSR0C	(*sim_reg(SIM_UCSR0C))
+#define UDR0	(*sim_reg(SIM_UDR0))
+#define UBRR0	(*sim_reg16(SIM_UBRR0))
+
+#define RXC0	7
+#define TXC0	6
+#define UDRE0	5
+
+#define RXCIE0	7
+#define TXCIE0	6
+#define UDRIE0	5
+#define RXEN0	4
+#define TXEN0	3
+
+#define UMSEL01	7
+#define UMSEL00	6
+#define UDORD0	2
+#define UCPHA0	1
+#define UCPOL0	0
+
+/* I/O ports. Pins are numbered 0..7 in each */
+#define PORTB	(*sim_reg(SIM_PORTB))
+#define DDRB	(*sim_reg(SIM_DDRB))
+#define PORTC	(*sim_reg(SIM_PORTC))
+#define DDRC	(*sim_reg(SIM_DDRC))
+#define PINC	(*sim_reg(SIM_PINC))
+#define PORTD	(*sim_reg(SIM_PORTD))
+#define DDRD	(*sim_reg(SIM_DDRD))
+
+#define DDB2	2
+#define DDB3	3
+#define DDB5	5
+#define DDD1	1
+#define DDD4	4
+
+#define PRSPI	2
+#define PRUSART0 1
+
+/* Timer1 */
+#define TCCR1A	(*sim_reg(SIM_TCCR1A))
+#define TCCR1B	(*sim_reg(SIM_TCCR1B))
+#define TCNT1	(*sim_reg16(SIM_TCNT1))
+#define OCR1A	(*sim_reg16(SIM_OCR1A))
+#define TIMSK1	(*sim_reg(SIM_TIMSK1))
+#define TIFR1	(*sim_reg(SIM_TIFR1))
+
+#define CS12	2
+#define CS11	1
+#define CS10	0
+
+#define OCIE1A	1
+#define OCF1A	1
+
+#endif /* OLED_HOST_AVR_IO_H */
@@ -0,0 +1,19 @@
+/* Host stand-in for <avr/pgmspace.h>. Program memory is ordinary memory */
+#ifndef OLED_HOST_AVR_PGMSPACE_H
+#define OLED_HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_ptr(addr) (*(void * const *)(addr))
+
+#define memcpy_P memcpy
+#define strlen_P strlen
+
+#endif /* OLED_HOST_AVR_PGMSPACE_H */
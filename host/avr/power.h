@@ -0,0 +1,14 @@
+/* Host stand-in for <avr/power.h>. See host/sim.h */
+#ifndef OLED_HOST_AVR_POWER_H
+#define OLED_HOST_AVR_POWER_H
+
+#include "io.h"
+
+#define power_twi_enable()  (PRR &= (uint8_t)~_BV(PRTWI))
+#define power_twi_disable() (PRR |= (uint8_t)_BV(PRTWI))
+#define power_spi_enable()  (PRR &= (uint8_t)~_BV(PRSPI))
+#define power_spi_disable() (PRR |= (uint8_t)_BV(PRSPI))
+#define power_usart0_enable()  (PRR &= (uint8_t)~_BV(PRUSART0))
+#define power_usart0_disable() (PRR |= (uint8_t)_BV(PRUSART0))
+
+#endif /* OLED_HOST_AVR_POWER_H */
@@ -0,0 +1,1494 @@
+/* Throughput benchmark of the OLED library on emulated TWI bus. See sim.h
+ * Build and run with: make bench
+ *
+ * For every drawing routine it reports host time per call, then refreshes
+ * what the routine has changed and reports bytes on the wire, TWI_vect
+ * invocations and simulated bus time of that refresh. Display GDDRAM is
+ * compared against frame buffer after each refresh, any mismatch makes the
+ * benchmark exit with failure.
+ */
+#include "oled.h"
+#include "oled_fonts.h"
+#include "sim.h"
+#include <util/delay.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(OLED_SPI)
+/* CS pins are on PORTC, see Makefile */
+#define BENCH_HZ	(F_CPU / 2)
+#define BENCH_ADDR	0
+#if defined(OLED_SPI_USART)
+#define BENCH_BUS	"USART SPI"
+#else
+#define BENCH_BUS	"SPI"
+#endif
+#else
+#define BENCH_HZ	400000UL
+#define BENCH_ADDR	0x3C
+#if defined(OLED_TWI_FASTISR)
+#define BENCH_BUS	"TWI fast ISR"
+#elif defined(OLED_STATS)
+#define BENCH_BUS	"TWI with stats"
+#else
+#define BENCH_BUS	"TWI"
+#endif
+#endif
+/* Grayscale planes per second. TWI needs 30 ms per plane */
+#if defined(OLED_SPI)
+#define BENCH_GRAY_HZ	200
+#else
+#define BENCH_GRAY_HZ	30
+#endif
+#define BENCH_WIDTH	128
+#define BENCH_HEIGHT	64
+#if defined(OLED_STATIC_WIDTH)
+#define BENCH_GEOMETRY	", static geometry"
+#else
+#define BENCH_GEOMETRY	""
+#endif
+#define BENCH_ITERS	2000
+
+static uint8_t fb[BENCH_WIDTH * BENCH_HEIGHT / 8];
+extern const uint8_t anim_demo[];	/* See host/anim_demo.py */
+/* 16x16 sprite: ring in a disc-shaped mask, made by sprite_init() */
+static uint8_t sprite[2 * 16], sprite_mask[2 * 16];
+static OLED oled;
+static struct sim_ssd1306 *dev;
+static int failures;
+
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+static void bench_reset(void)
+{
+	sim_reset();
+#if defined(OLED_SPI)
+	sim_spi_wiring(SIM_PORTC, SIM_PORTB, OLED_SPI_DC_BIT);
+#endif
+}
+
+
+/* Drawing routines being measured. Called with iteration number */
+static void draw_pixel(uint16_t i)
+{
+	OLED_put_pixel(&oled, i % BENCH_WIDTH, (i / BENCH_WIDTH) % BENCH_HEIGHT, i & 1);
+}
+
+static void draw_hline(uint16_t i)
+{
+	OLED_put_rectangle(&oled, 10, 47, 117, 47, i & 1);
+}
+
+static void draw_outline(uint16_t i)
+{
+	OLED_put_rectangle(&oled, 4, 4, 123, 57, i & 1);
+}
+
+static void draw_box(uint16_t i)
+{
+	OLED_put_rectangle(&oled, 21, 13, 44, 36, OLED_FILL | (i & 1));
+}
+
+static void draw_fill(uint16_t i)
+{
+	OLED_put_rectangle(&oled, 0, 0, BENCH_WIDTH - 1, BENCH_HEIGHT - 1, OLED_FILL | (i & 1));
+}
+
+static void draw_text(uint16_t i)
+{
+	OLED_put_string(&oled, &OLED_font5x7, 0, 8, "Text on page boundary", OLED_FILL | (i & 1));
+}
+
+static void draw_text_shifted(uint16_t i)
+{
+	OLED_put_string(&oled, &OLED_font5x7, 0, 27, "Text at any row: y=27", OLED_FILL | (i & 1));
+}
+
+/* Masked sprite, drawn inverted on odd iterations */
+static void draw_sprite(uint16_t i)
+{
+	OLED_blit(&oled, 40, 21, 16, 16, sprite, sprite_mask, (i & 1) ? OLED_BLIT_COPYINV : OLED_BLIT_COPY);
+}
+
+/* The same as draw_sprite, done pixel by pixel */
+static void draw_sprite_pixels(uint16_t i)
+{
+	for (uint8_t x = 0; x < 16; x++) {
+		for (uint8_t y = 0; y < 16; y++) {
+			uint8_t bit = 1 << (y % 8);
+			if (sprite_mask[(y / 8) * 16 + x] & bit)
+				OLED_put_pixel(&oled, 40 + x, 21 + y, ((sprite[(y / 8) * 16 + x] & bit) != 0) != (i & 1));
+		}
+	}
+}
+
+/* 10 sprites moving across the screen, some of them partially off-screen */
+static void draw_sprites(uint16_t i)
+{
+	for (int16_t s = 0; s < 10; s++) {
+		int16_t x = (s * 29 + i) % (BENCH_WIDTH + 16) - 16;
+		int16_t y = (s * 13 + i / 2) % (BENCH_HEIGHT + 16) - 8;
+		OLED_blit(&oled, x, y, 16, 16, sprite, sprite_mask, OLED_BLIT_XOR);
+	}
+}
+
+/* Raster operations: every other iteration erases what the previous drew */
+static void draw_xor_outline(uint16_t i)
+{
+	(void)i;
+	OLED_put_rectangle(&oled, 4, 4, 123, 57, OLED_XOR);
+}
+
+static void draw_xor_box(uint16_t i)
+{
+	(void)i;
+	OLED_put_rectangle(&oled, 21, 13, 44, 36, OLED_FILL | OLED_XOR);
+}
+
+static void draw_xor_text(uint16_t i)
+{
+	(void)i;
+	OLED_put_string(&oled, &OLED_font5x7, 0, 27, "Text at any row: y=27", OLED_XOR);
+}
+
+/* Shapes, and naive ones made of bounds-checked OLED_put_pixel calls which
+ * give the same pixels. bench_shapes checks that they do
+ */
+static bool is_on_screen(int16_t x, int16_t y)
+{
+	return (x >= 0) && (x < BENCH_WIDTH) && (y >= 0) && (y < BENCH_HEIGHT);
+}
+
+static void naive_pixel(int16_t x, int16_t y, uint8_t color)
+{
+	if (is_on_screen(x, y))
+		OLED_put_pixel(&oled, x, y, color);
+}
+
+static void naive_line(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t color)
+{
+	int16_t dx = abs(x1 - x0), dy = abs(y1 - y0);
+	int16_t sx = (x1 < x0) ? -1 : 1, sy = (y1 < y0) ? -1 : 1;
+	bool is_steep = dy > dx;
+	int16_t d_long = is_steep ? dy : dx, d_short = is_steep ? dx : dy;
+	for (int16_t k = 0; k <= d_long; k++) {
+		int16_t m = (2 * (int32_t)k * d_short + d_long) / (2 * d_long);
+		if (is_steep)
+			naive_pixel(x0 + sx * m, y0 + sy * k, color);
+		else
+			naive_pixel(x0 + sx * k, y0 + sy * m, color);
+	}
+}
+
+static void naive_circle(int16_t xc, int16_t yc, int16_t r, bool is_fill, uint8_t color)
+{
+	int16_t x = 0, y = r, d = 1 - r;
+	while (x <= y) {
+		for (int8_t sign = -1; sign <= 1; sign += 2) {
+			if (is_fill) {
+				for (int16_t i = -y; i <= y; i++)
+					naive_pixel(xc + sign * x, yc + i, color);
+				for (int16_t i = -x; i <= x; i++)
+					naive_pixel(xc + sign * y, yc + i, color);
+			} else {
+				naive_pixel(xc + sign * x, yc + y, color);
+				naive_pixel(xc + sign * x, yc - y, color);
+				naive_pixel(xc + sign * y, yc + x, color);
+				naive_pixel(xc + sign * y, yc - x, color);
+			}
+		}
+		if (d < 0) {
+			d += 2 * x + 3;
+		} else {
+			d += 2 * (x - y) + 5;
+			y--;
+		}
+		x++;
+	}
+}
+
+/* Even-odd test of each pixel center in bounding box */
+static void naive_polygon_fill(const OLED_point *pts, uint8_t n, uint8_t color)
+{
+	for (int16_t x = 0; x < BENCH_WIDTH; x++) {
+		for (int16_t y = 0; y < BENCH_HEIGHT; y++) {
+			bool is_in = false;
+			for (uint8_t i = 0; i < n; i++) {
+				const OLED_point *a = &pts[i], *b = &pts[(i + 1) % n];
+				if (a->x > b->x) {
+					const OLED_point *tmp = a;
+					a = b;
+					b = tmp;
+				}
+				if ((x < a->x) || (x >= b->x))
+					continue;
+				/* Crossing at x+0.5 is num / den, above center y+0.5 */
+				int32_t den = 2 * (b->x - a->x);
+				int32_t num = a->y * den + (2 * (x - a->x) + 1) * (int32_t)(b->y - a->y);
+				if ((2 * y + 1) * den >= 2 * num)
+					is_in = !is_in;
+			}
+			if (is_in)
+				OLED_put_pixel(&oled, x, y, color);
+		}
+	}
+}
+
+static const OLED_point triangle[] = {{10, 60}, {64, 2}, {118, 50}};
+
+static void draw_line(uint16_t i)
+{
+	OLED_put_line(&oled, 0, 0, 127, 63, i & 1);
+}
+
+static void draw_line_naive(uint16_t i)
+{
+	naive_line(0, 0, 127, 63, i & 1);
+}
+
+static void draw_circle(uint16_t i)
+{
+	OLED_put_circle(&oled, 64, 32, 30, i & 1);
+}
+
+static void draw_circle_naive(uint16_t i)
+{
+	naive_circle(64, 32, 30, false, i & 1);
+}
+
+static void draw_disc(uint16_t i)
+{
+	OLED_put_circle(&oled, 64, 32, 30, OLED_FILL | (i & 1));
+}
+
+static void draw_disc_naive(uint16_t i)
+{
+	naive_circle(64, 32, 30, true, i & 1);
+}
+
+static void draw_triangle(uint16_t i)
+{
+	OLED_put_polygon(&oled, triangle, 3, OLED_FILL | (i & 1));
+}
+
+static void draw_triangle_naive(uint16_t i)
+{
+	naive_polygon_fill(triangle, 3, i & 1);
+}
+
+static const struct bench_case {
+	const char *name;
+	void (*draw)(uint16_t i);
+} cases[] = {
+	{"put_pixel", draw_pixel},
+	{"hline 108px", draw_hline},
+	{"outline 120x54", draw_outline},
+	{"fill 24x24", draw_box},
+	{"fill screen", draw_fill},
+	{"text 21ch y=8", draw_text},
+	{"text 21ch y=27", draw_text_shifted},
+	{"sprite 16x16 blit", draw_sprite},
+	{"sprite 16x16 pixel", draw_sprite_pixels},
+	{"10 sprites xor", draw_sprites},
+	{"xor outline", draw_xor_outline},
+	{"xor fill 24x24", draw_xor_box},
+	{"xor text y=27", draw_xor_text},
+	{"line 127x63", draw_line},
+	{"line naive", draw_line_naive},
+	{"circle r=30", draw_circle},
+	{"circle naive", draw_circle_naive},
+	{"disc r=30", draw_disc},
+	{"disc naive", draw_disc_naive},
+	{"fill triangle", draw_triangle},
+	{"triangle naive", draw_triangle_naive},
+};
+
+
+static void sprite_init(void)
+{
+	for (int8_t x = 0; x < 16; x++) {
+		for (int8_t y = 0; y < 16; y++) {
+			int16_t r2 = (2 * x - 15) * (2 * x - 15) + (2 * y - 15) * (2 * y - 15);
+			uint8_t bit = 1 << (y % 8);
+			if (r2 <= 16 * 16)
+				sprite_mask[(y / 8) * 16 + x] |= bit;
+			if ((r2 <= 14 * 14) && (r2 >= 8 * 8))
+				sprite[(y / 8) * 16 + x] |= bit;
+		}
+	}
+}
+
+
+static void bench_row(const char *name, double draw_ns)
+{
+	uint16_t mism = sim_ssd1306_compare(dev, fb, BENCH_WIDTH, BENCH_HEIGHT / 8);
+	if (draw_ns >= 0)
+		printf("%-18s %9.1f", name, draw_ns);
+	else
+		printf("%-18s %9s", name, "-");
+	printf(" %7u %7u %6u %6u %9.1f%s\n", oled.refresh_bytes, sim_stats.bytes,
+	       sim_stats.isr_calls, sim_stats.starts, sim_stats.bus_ns / 1000.0,
+	       mism ? "  GDDRAM MISMATCH" : "");
+	if (mism)
+		failures++;
+}
+
+
+static void bench_refresh(bool is_full)
+{
+	sim_stats_reset();
+	if (is_full)
+		OLED_refresh(&oled);
+	else
+		OLED_refresh_dirty(&oled);
+	sim_bus_drain();
+}
+
+
+#if defined(OLED_STATS)
+/* Counters of OLED_stats_snapshot must agree with simulated bus, also
+ * for refresh with nothing to send, which ends outside of ISR
+ */
+static void bench_stats(void)
+{
+	OLED_stats st;
+	OLED_stats_snapshot(&oled, &st, true);
+	OLED_mark_dirty(&oled, 0, 0, BENCH_WIDTH - 1, BENCH_HEIGHT - 1);
+	bench_refresh(false);
+	OLED_stats_snapshot(&oled, &st, true);
+	double bus_cycles = (double)sim_stats.bus_ns * F_CPU / 1e9;
+	bool is_ok = (1 == st.frames) && (st.bytes == sim_stats.bytes) && (st.txns == sim_stats.starts)
+		     && (st.last_refresh_cycles > 0.9 * bus_cycles) && (st.last_refresh_cycles < 1.1 * bus_cycles)
+		     && st.isr_cycles && st.isr_cycles_max && !st.shed_fails;
+	printf("%-18s frames %u, bytes %u, txns %u, refresh cycles %u, isr cycles %u, max %u%s\n",
+	       "stats full", st.frames, st.bytes, st.txns, st.last_refresh_cycles, st.isr_cycles,
+	       st.isr_cycles_max, is_ok ? "" : "  WRONG");
+	bench_refresh(false);
+	OLED_stats_snapshot(&oled, &st, true);
+	bool is_clean_ok = (1 == st.frames) && !st.bytes && (st.last_refresh_cycles < 0x10000);
+	printf("%-18s frames %u, bytes %u, refresh cycles %u%s\n", "stats clean", st.frames, st.bytes,
+	       st.last_refresh_cycles, is_clean_ok ? "" : "  WRONG");
+	if (!is_ok || !is_clean_ok)
+		failures++;
+}
+#endif
+
+
+/* Plays demo animation and reports averages per frame. Frame buffer is not
+ * involved, so instead of GDDRAM check it is refreshed back to display after
+ */
+static void bench_anim(void)
+{
+	OLED_anim anim;
+	uint32_t frames = 0, gddram = 0;
+	OLED_anim_init(&oled, &anim, anim_demo);
+	sim_stats_reset();
+	while (OLED_anim_frame(&oled, &anim)) {
+		sim_bus_drain();
+		gddram += oled.refresh_bytes;
+		frames++;
+	}
+	printf("%-18s %9s %7u %7u %6u %6u %9.1f\n", "anim frame (avg)", "-",
+	       gddram / frames, sim_stats.bytes / frames, sim_stats.isr_calls / frames,
+	       sim_stats.starts / frames, sim_stats.bus_ns / 1000.0 / frames);
+	bench_refresh(false);
+	bench_row("refresh after anim", -1);
+}
+
+
+/* Appends lines to scroll console and reports averages per line, checking
+ * start line too. Then scrolls display in hardware and stops it
+ */
+static void bench_console(void)
+{
+	OLED_console con;
+	char text[] = "Log line 00";
+	uint16_t lines = 2 * (BENCH_HEIGHT / 8);
+	OLED_console_init(&oled, &con, &OLED_font5x7, OLED_BLACK);
+	sim_bus_drain();
+	sim_stats_reset();
+	for (uint16_t i = 0; i < lines; i++) {
+		text[sizeof text - 3] = '0' + i / 10;
+		text[sizeof text - 2] = '0' + i % 10;
+		OLED_console_puts(&con, text);
+	}
+	sim_bus_drain();
+	uint16_t mism = sim_ssd1306_compare(dev, fb, BENCH_WIDTH, BENCH_HEIGHT / 8);
+	bool is_moved = dev->start_line == con.top * 8;
+	printf("%-18s %9s %7u %7u %6u %6u %9.1f%s\n", "console line (avg)", "-",
+	       oled.refresh_bytes, sim_stats.bytes / lines, sim_stats.isr_calls / lines,
+	       sim_stats.starts / lines, sim_stats.bus_ns / 1000.0 / lines,
+	       mism ? "  GDDRAM MISMATCH" : (is_moved ? "" : "  START LINE WRONG"));
+	if (mism || !is_moved)
+		failures++;
+
+	sim_stats_reset();
+	OLED_cmd_scroll(&oled, true, 0, BENCH_HEIGHT / 8 - 1, OLED_SCROLL_2_FRAMES, 1);
+	sim_bus_drain();
+	bool is_scrolling = dev->scrolling && (0x2A == dev->scroll[0]);
+	printf("%-18s %9s %7u %7u %6u %6u %9.1f%s\n", "scroll start", "-", 0u, sim_stats.bytes,
+	       sim_stats.isr_calls, sim_stats.starts, sim_stats.bus_ns / 1000.0,
+	       is_scrolling ? "" : "  NOT SCROLLING");
+	if (!is_scrolling)
+		failures++;
+	OLED_cmd_scroll_stop(&oled);
+	OLED_cmd_startline(&oled, 0);
+	bench_refresh(false);
+	bench_row("refresh after stop", -1);
+}
+
+
+static uint8_t async_done;
+
+static void cbk_async(void *args)
+{
+	(void)args;
+	async_done++;
+}
+
+
+/* Starts full refresh with OLED_refresh_async, which must not be started
+ * again while it is on the bus. Then, with coalescing, starts it again and
+ * requests refresh after each of 4 lines of text drawn while it is on the
+ * bus: all of them go in one more pass and only the last callback is called
+ */
+static void bench_async(uint8_t opts)
+{
+	OLED_err err;
+	bool is_ok = true;
+	sim_stats_reset();
+	async_done = 0;
+	OLED_mark_dirty(&oled, 0, 0, BENCH_WIDTH - 1, BENCH_HEIGHT - 1);
+	is_ok &= OLED_EOK == OLED_refresh_async(&oled, &cbk_async, NULL);
+	is_ok &= OLED_EBUSY == OLED_refresh_async(&oled, &cbk_async, NULL);
+	is_ok &= OLED_EBUSY == OLED_wait_idle(&oled, 1);
+	is_ok &= OLED_EOK == OLED_wait_idle(&oled, 100);
+	is_ok &= 1 == async_done;
+	bench_row(is_ok ? "async full" : "async full FAILED", -1);
+	if (!is_ok)
+		failures++;
+
+	OLED_init(&oled, BENCH_WIDTH, BENCH_HEIGHT, fb, BENCH_HZ, BENCH_ADDR, opts | OLED_OPT_COALESCE);
+	sim_bus_drain();
+	bench_refresh(true);
+	sim_stats_reset();
+	async_done = 0;
+	OLED_mark_dirty(&oled, 0, 0, BENCH_WIDTH - 1, BENCH_HEIGHT - 1);
+	err = OLED_refresh_async(&oled, &cbk_async, NULL);
+	for (uint8_t i = 0; i < 4; i++) {
+		char text[] = "Coalesced 0";
+		text[sizeof text - 2] += i;
+		OLED_put_string(&oled, &OLED_font5x7, 0, 8 * i, text, OLED_FILL | OLED_BLACK);
+		err |= OLED_refresh_async(&oled, &cbk_async, NULL);
+		/* Let a part of the first pass go */
+		for (uint16_t step = 0; step < 100; step++)
+			sim_bus_step();
+	}
+	is_ok = (OLED_EOK == err) && (OLED_EOK == OLED_wait_idle(&oled, 100)) && (2 == async_done);
+	bench_row(is_ok ? "async coalesced" : "async coalesced FAILED", -1);
+	if (!is_ok)
+		failures++;
+
+	/* Request made while drawing holds the lock starts on unlock */
+	sim_stats_reset();
+	async_done = 0;
+	OLED_WITH_SPINLOCK(&oled) {
+		OLED_put_string(&oled, &OLED_font5x7, 0, 40, "Under lock", OLED_FILL | OLED_BLACK);
+		err = OLED_refresh_async(&oled, &cbk_async, NULL);
+	}
+	is_ok = (OLED_EOK == err) && (OLED_EOK == OLED_wait_idle(&oled, 100)) && (1 == async_done);
+	bench_row(is_ok ? "async after lock" : "async after lock FAILED", -1);
+	if (!is_ok)
+		failures++;
+
+	/* With no free slot in queue it must not wait, and not take lock */
+	OLED_pacer_bus_take(1000);
+	for (uint8_t i = 0; i < OLED_CMDBUFFER_LEN - OLED_CMDBUFFER_RESERVE; i++)
+		OLED_cmd_setbrightness(&oled, 0xFF);
+	OLED_put_pixel(&oled, 5, 5, OLED_XOR);
+	is_ok = (OLED_EBUSY == OLED_refresh_async(&oled, &cbk_async, NULL)) && OLED_is_idle(&oled);
+	OLED_pacer_bus_give();
+	sim_bus_drain();
+	bench_refresh(false);
+	bench_row(is_ok ? "async queue full" : "async queue full FAILED", -1);
+	if (!is_ok)
+		failures++;
+}
+
+
+#if !defined(OLED_SPI)
+/* Another driver in the bus window: polled TWI write of a register pointer
+ * to a sensor, which is not there, so it ends with STOP after address NACK.
+ * TWIE stays cleared by the STOP, as usual for such drivers
+ */
+static void bench_borrower(void)
+{
+	TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN);
+	while (!sim_twi_int()) {
+		// nop
+	}
+	TWDR = 0x48 << 1;
+	TWCR = (1 << TWINT) | (1 << TWEN);
+	while (!sim_twi_int()) {
+		// nop
+	}
+	if ((TWSR & 0xF8) == 0x18) {
+		TWDR = 0x00;
+		TWCR = (1 << TWINT) | (1 << TWEN);
+		while (!sim_twi_int()) {
+			// nop
+		}
+	}
+	TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO);
+}
+#endif
+
+
+/* Runs pacer for a second of simulated time. Main loop redraws a line of
+ * text (or the whole frame) every draw_ms and another driver asks for a
+ * 500 us bus window every 5 ms, which on TWI it starts with a transaction
+ * of its own. Pacer must leave GDDRAM up to date
+ */
+static void bench_pacer(const char *name, uint8_t opts, uint8_t fps, uint8_t draw_ms, bool is_full)
+{
+	OLED_pacer_stats st;
+	uint16_t windows = 0, tries = 0;
+	OLED_init(&oled, BENCH_WIDTH, BENCH_HEIGHT, fb, BENCH_HZ, BENCH_ADDR, opts);
+	bench_refresh(true);
+	sim_stats_reset();
+	OLED_pacer_stats_snapshot(&st, true);
+	uint64_t start = sim_cycles;
+	OLED_pacer_start(&oled, fps);
+	for (uint16_t ms = 0; ms < 1000; ms++) {
+		if (!(ms % draw_ms)) {
+			char text[] = "Frame 000";
+			text[sizeof text - 4] += ms / 100;
+			text[sizeof text - 3] += ms / 10 % 10;
+			OLED_WITH_SPINLOCK(&oled) {
+				if (is_full)
+					OLED_mark_dirty(&oled, 0, 0, BENCH_WIDTH - 1, BENCH_HEIGHT - 1);
+				OLED_put_string(&oled, &OLED_font5x7, 0, 16, text, OLED_FILL | OLED_BLACK);
+			}
+		}
+		if (!(ms % 5)) {
+			tries++;
+			if (OLED_pacer_bus_take(500)) {
+				windows++;
+#if !defined(OLED_SPI)
+				bench_borrower();
+#endif
+				_delay_us(400);
+				OLED_pacer_bus_give();
+			}
+		}
+		_delay_ms(1);
+	}
+	/* Last frame is sent by the next deadline */
+	_delay_ms(1000 / fps + 1);
+	OLED_pacer_stop();
+	OLED_wait_idle(&oled, 100);
+	OLED_pacer_stats_snapshot(&st, true);
+
+	double elapsed_ns = (sim_cycles - start) * 1e9 / F_CPU;
+	uint16_t mism = sim_ssd1306_compare(dev, fb, BENCH_WIDTH, BENCH_HEIGHT / 8);
+	printf("%-18s frames %lu, clean %lu, missed %lu, deferred %lu, bus windows %u/%u, bus busy %.0f%%%s\n",
+	       name, (unsigned long)st.frames, (unsigned long)st.clean, (unsigned long)st.missed,
+	       (unsigned long)st.deferred, windows, tries, 100 * sim_stats.bus_ns / elapsed_ns,
+	       mism ? "  GDDRAM MISMATCH" : "");
+	if (mism)
+		failures++;
+}
+
+
+/* At 244 fps deadlines are 2 * 0x8000 + 37 cycles apart, less than timer
+ * ISR takes to re-arm after 37 cycles. No deadline may be lost for a wrap
+ * of Timer1, so a clean frame is counted for each of them
+ */
+static void bench_pacer_steps(uint8_t opts)
+{
+	OLED_pacer_stats st;
+	OLED_init(&oled, BENCH_WIDTH, BENCH_HEIGHT, fb, BENCH_HZ, BENCH_ADDR, opts);
+	bench_refresh(true);
+	OLED_pacer_stats_snapshot(&st, true);
+	OLED_pacer_start(&oled, 244);
+	_delay_ms(1000);
+	OLED_pacer_stop();
+	OLED_pacer_stats_snapshot(&st, true);
+	bool is_ok = (st.clean >= 243) && (st.clean <= 245);
+	printf("%-18s clean %lu%s\n", "pacer short step", (unsigned long)st.clean, is_ok ? "" : "  FAILED");
+	if (!is_ok)
+		failures++;
+}
+
+
+/* Shows 4 bars of grey levels for a second and samples the display, as eye
+ * would see it: part of time each bar is lit (weighted by contrast). It must
+ * be close to level / 3 when planes are weighted by time, level / 4 when by
+ * contrast
+ */
+static void bench_gray(const char *name, uint8_t opts, uint16_t plane_hz, uint8_t contrast)
+{
+	static uint8_t planes[2 * sizeof fb];
+	OLED_gray gray;
+	OLED_pacer_stats st;
+	double lit[OLED_GRAY_LEVELS] = { 0 };
+	uint32_t samples = 0;
+	bool is_ok = true;
+	OLED_init(&oled, BENCH_WIDTH, BENCH_HEIGHT, fb, BENCH_HZ, BENCH_ADDR, opts);
+	sim_bus_drain();
+	OLED_gray_init(&oled, &gray, planes);
+	for (uint8_t level = 0; level < OLED_GRAY_LEVELS; level++)
+		OLED_gray_put_rectangle(&gray, 32 * level, 0, 32 * level + 31, BENCH_HEIGHT - 1, level, OLED_FILL);
+	OLED_gray_put_string(&gray, &OLED_font5x7, 4, 28, "Grey", 2, OLED_FILL);
+	OLED_pacer_stats_snapshot(&st, true);
+	OLED_gray_start(&gray, plane_hz, contrast);
+	_delay_ms(100);
+	for (uint32_t us = 0; us < 1000000; us += 20) {
+		for (uint8_t level = 0; level < OLED_GRAY_LEVELS; level++) {
+			if (dev->gddram[0][32 * level + 16] & 0x01)
+				lit[level] += contrast ? dev->contrast / (double)contrast : 1.0;
+		}
+		samples++;
+		_delay_us(20);
+	}
+	OLED_pacer_stop();
+	OLED_wait_idle(&oled, 100);
+	OLED_pacer_stats_snapshot(&st, true);
+
+	printf("%-18s planes %lu, missed %lu, lit", name, (unsigned long)st.frames, (unsigned long)st.missed);
+	for (uint8_t level = 0; level < OLED_GRAY_LEVELS; level++) {
+		double expected = level / (contrast ? 4.0 : 3.0);
+		lit[level] /= samples;
+		printf(" %.2f", lit[level]);
+		is_ok &= (lit[level] > expected - 0.05) && (lit[level] < expected + 0.05);
+	}
+	printf("%s\n", is_ok ? "" : "  FAILED");
+	if (!is_ok)
+		failures++;
+}
+
+
+/* Another driver keeps queue nearly full for 100 ms, so there is a slot for
+ * contrast of plane but not for its refresh. Planes must be deferred then,
+ * and go on once queue drains
+ */
+static void bench_gray_queue(uint8_t opts)
+{
+	static uint8_t planes[2 * sizeof fb];
+	OLED_gray gray;
+	OLED_pacer_stats st, busy;
+	OLED_init(&oled, BENCH_WIDTH, BENCH_HEIGHT, fb, BENCH_HZ, BENCH_ADDR, opts);
+	sim_bus_drain();
+	OLED_gray_init(&oled, &gray, planes);
+	OLED_pacer_stats_snapshot(&st, true);
+	OLED_gray_start(&gray, BENCH_GRAY_HZ, 0xFF);
+	uint64_t end = sim_cycles + F_CPU / 10;
+	while (sim_cycles < end)
+		OLED_cmd_setbrightness(&oled, 0x80);
+	OLED_pacer_stats_snapshot(&busy, true);
+	_delay_ms(100);
+	OLED_pacer_stop();
+	OLED_wait_idle(&oled, 100);
+	OLED_pacer_stats_snapshot(&st, true);
+	bool is_ok = busy.deferred && (st.frames > BENCH_GRAY_HZ / 20);
+	printf("%-18s planes %lu, deferred %lu, then planes %lu%s\n", "gray queue full",
+	       (unsigned long)busy.frames, (unsigned long)busy.deferred, (unsigned long)st.frames,
+	       is_ok ? "" : "  FAILED");
+	if (!is_ok)
+		failures++;
+}
+
+
+/* Shapes must give the same pixels as naive ones, also when partially off
+ * display, and drawn with OLED_XOR on blank frame the same as with color
+ */
+static void bench_shapes(void)
+{
+	static uint8_t fast[sizeof fb];
+	static const OLED_point star[] = {{64, -10}, {75, 70}, {20, 20}, {110, 20}, {50, 75}};
+	const char *names[] = {"line", "clipped line", "circle", "clipped disc", "triangle", "star"};
+	for (uint8_t c = 0; c < OLED_ARR_SIZE(names); c++) {
+		bool is_ok = true;
+		for (uint8_t pass = 0; pass < 3; pass++) {
+			/* Shape with color, with XOR, then naive one */
+			uint8_t op = (1 == pass) ? OLED_XOR : OLED_BLACK;
+			memset(fb, 0, sizeof fb);
+			switch (c) {
+			case 0:
+				(2 == pass) ? naive_line(3, 60, 120, 17, 1) : OLED_put_line(&oled, 3, 60, 120, 17, op);
+				break;
+			case 1:
+				(2 == pass) ? naive_line(-50, 90, 200, -7, 1) : OLED_put_line(&oled, -50, 90, 200, -7, op);
+				break;
+			case 2:
+				(2 == pass) ? naive_circle(40, 30, 21, false, 1) : OLED_put_circle(&oled, 40, 30, 21, op);
+				break;
+			case 3:
+				(2 == pass) ? naive_circle(120, 5, 17, true, 1)
+					    : OLED_put_circle(&oled, 120, 5, 17, OLED_FILL | op);
+				break;
+			case 4:
+				(2 == pass) ? naive_polygon_fill(triangle, 3, 1)
+					    : OLED_put_polygon(&oled, triangle, 3, OLED_FILL | op);
+				break;
+			case 5:
+				(2 == pass) ? naive_polygon_fill(star, 5, 1)
+					    : OLED_put_polygon(&oled, star, 5, OLED_FILL | op);
+				break;
+			}
+			if (!pass)
+				memcpy(fast, fb, sizeof fb);
+			else
+				is_ok &= !memcmp(fast, fb, sizeof fb);
+		}
+		if (!is_ok) {
+			printf("%s differs from naive one or XOR\n", names[c]);
+			failures++;
+		}
+	}
+	memset(fb, 0, sizeof fb);
+	OLED_refresh(&oled);
+	sim_bus_drain();
+}
+
+
+/* Pushes values to a chart over the lower half of display, then does the same
+ * pixel by pixel and compares
+ */
+static void bench_chart(void)
+{
+	static uint8_t fast[sizeof fb];
+	OLED_chart chart;
+	memset(fb, 0, sizeof fb);
+	OLED_chart_init(&oled, &chart, 0, BENCH_HEIGHT / 16, BENCH_WIDTH - 1, BENCH_HEIGHT / 8 - 1, OLED_BLACK);
+	bench_refresh(false);
+	uint64_t start = now_ns();
+	for (uint16_t i = 0; i < BENCH_ITERS; i++)
+		OLED_chart_push(&chart, (i * 7) % 41);
+	double fast_ns = (double)(now_ns() - start) / BENCH_ITERS;
+	bench_refresh(false);
+	OLED_chart_push(&chart, 13);
+	bench_refresh(false);
+	bench_row("chart push", fast_ns);
+	memcpy(fast, fb, sizeof fb);
+
+	/* Each column of area takes pixels of the next one, the last is blank */
+	memset(fb, 0, sizeof fb);
+	uint8_t last = 0xFF;
+	int16_t bottom = BENCH_HEIGHT - 1;
+	start = now_ns();
+	for (uint16_t i = 0; i <= BENCH_ITERS; i++) {
+		uint8_t v = (i < BENCH_ITERS) ? (i * 7) % 41 : 13;
+		for (int16_t x = 0; x < BENCH_WIDTH; x++) {
+			for (int16_t y = BENCH_HEIGHT / 2; y < BENCH_HEIGHT; y++) {
+				bool bit = (x < BENCH_WIDTH - 1)
+					   && (fb[(y / 8) * BENCH_WIDTH + x + 1] & (1 << (y % 8)));
+				OLED_put_pixel(&oled, x, y, bit);
+			}
+		}
+		if (v > BENCH_HEIGHT / 2 - 1)
+			v = BENCH_HEIGHT / 2 - 1;
+		uint8_t from = ((last != 0xFF) && (last < v)) ? last : v;
+		uint8_t to = ((last != 0xFF) && (last > v)) ? last : v;
+		for (int16_t y = bottom - to; y <= bottom - from; y++)
+			OLED_put_pixel(&oled, BENCH_WIDTH - 1, y, 1);
+		last = v;
+	}
+	double naive_ns = (double)(now_ns() - start) / (BENCH_ITERS + 1);
+	bool is_same = !memcmp(fast, fb, sizeof fb);
+	printf("%-18s %9.1f%s\n", "chart naive", naive_ns, is_same ? "" : "  DIFFERS");
+	if (!is_same)
+		failures++;
+	memset(fb, 0, sizeof fb);
+	OLED_refresh(&oled);
+	sim_bus_drain();
+}
+
+
+/* Drawing of bench_rotation. Stays within 64x64, the part of drawing which
+ * is the same with and without a quarter turn, and crosses its edges
+ */
+static void draw_turnable(void)
+{
+	OLED_put_string(&oled, &OLED_font5x7, 2, 3, "Turn 90", OLED_FILL | OLED_BLACK);
+	OLED_put_string(&oled, &OLED_font5x7, 30, 50, "edge", OLED_XOR);
+	OLED_blit(&oled, 20, 21, 16, 16, sprite, sprite_mask, OLED_BLIT_COPY);
+	OLED_blit(&oled, -5, 30, 16, 16, sprite, NULL, OLED_BLIT_OR);
+	OLED_blit(&oled, 44, -3, 16, 16, sprite, sprite_mask, OLED_BLIT_XOR);
+	OLED_put_rectangle(&oled, 1, 13, 62, 46, OLED_XOR);
+	OLED_put_line(&oled, -8, 63, 70, 12, OLED_XOR);
+	OLED_put_circle(&oled, 60, 40, 10, OLED_FILL | OLED_XOR);
+	OLED_put_triangle(&oled, 5, 60, 30, 40, 50, 62, OLED_FILL | OLED_BLACK);
+}
+
+
+static bool fb_bit(const uint8_t *buf, uint8_t x, uint8_t y)
+{
+	return (buf[(y / 8) * BENCH_WIDTH + x] >> (y % 8)) & 0x01;
+}
+
+
+/* Quarter turn must give drawing made without it, turned: point (u, v) at
+ * column width - 1 - v, row u. Turned text is timed against the same pixels
+ * put one by one. Half turns are done by display, which gets frame again
+ */
+static void bench_rotation(void)
+{
+	static uint8_t plain[sizeof fb], fast[sizeof fb];
+	const char *str = "Turned 0123";
+	memset(fb, 0, sizeof fb);
+	draw_turnable();
+	memcpy(plain, fb, sizeof fb);
+
+	OLED_set_rotation(&oled, OLED_ROTATE_90);
+	memset(fb, 0, sizeof fb);
+	draw_turnable();
+	bool is_ok = (OLED_EBOUNDS == OLED_put_pixel(&oled, BENCH_HEIGHT, 0, 1))
+		     && (OLED_EOK == OLED_put_pixel(&oled, 0, BENCH_WIDTH - 1, 0));
+	for (uint8_t x = 0; x < BENCH_WIDTH; x++) {
+		for (uint8_t y = 0; y < BENCH_HEIGHT; y++) {
+			uint8_t u = y, v = BENCH_WIDTH - 1 - x;
+			is_ok &= fb_bit(fb, x, y) == ((v < BENCH_HEIGHT) && fb_bit(plain, u, v));
+		}
+	}
+	bench_refresh(false);
+	bench_row("turned 90", -1);
+
+	/* Text alone, turned and pixel by pixel */
+	OLED_set_rotation(&oled, OLED_ROTATE_0);
+	memset(plain, 0, sizeof plain);
+	oled.frame_buffer = plain;
+	OLED_put_string(&oled, &OLED_font5x7, 0, 27, str, OLED_FILL | OLED_BLACK);
+	oled.frame_buffer = fb;
+	OLED_set_rotation(&oled, OLED_ROTATE_90);
+	memset(fb, 0, sizeof fb);
+	uint64_t start = now_ns();
+	for (uint16_t i = 0; i < BENCH_ITERS; i++)
+		OLED_put_string(&oled, &OLED_font5x7, 0, 27, str, OLED_FILL | (i & 1));
+	double fast_ns = (double)(now_ns() - start) / BENCH_ITERS;
+	memcpy(fast, fb, sizeof fb);
+	memset(fb, 0, sizeof fb);
+	start = now_ns();
+	for (uint16_t i = 0; i < BENCH_ITERS; i++) {
+		for (uint8_t u = 0; u < BENCH_HEIGHT; u++) {
+			for (uint8_t v = 27; v < 35; v++)
+				OLED_put_pixel(&oled, u, v, fb_bit(plain, u, v) == (i & 1));
+		}
+	}
+	double naive_ns = (double)(now_ns() - start) / BENCH_ITERS;
+	bool is_same = !memcmp(fast, fb, sizeof fb);
+	printf("%-18s %9.1f\n", "turned text", fast_ns);
+	printf("%-18s %9.1f%s\n", "turned text naive", naive_ns, is_same ? "" : "  DIFFERS");
+	if (!is_same)
+		failures++;
+
+	/* Half turn reverses columns and rows of display, frame is sent again */
+	OLED_set_rotation(&oled, OLED_ROTATE_270);
+	sim_stats_reset();
+	OLED_refresh_dirty(&oled);
+	sim_bus_drain();
+	is_ok &= dev->seg_remap && dev->com_reverse;
+	bench_row("turned 270", -1);
+	OLED_set_rotation(&oled, OLED_ROTATE_0);
+	memset(fb, 0, sizeof fb);
+	bench_refresh(false);
+	is_ok &= !dev->seg_remap && !dev->com_reverse;
+	bench_row("turned back", -1);
+	if (!is_ok) {
+		printf("turned drawing or display orientation is wrong\n");
+		failures++;
+	}
+}
+
+
+/* Text cursor over a line of text: XOR block drawn and erased by drawing it
+ * again. Frame buffer must come back unchanged, with only the bytes under the
+ * cursor sent each time
+ */
+static void bench_xor_cursor(void)
+{
+	static uint8_t saved[sizeof fb];
+	OLED_put_string(&oled, &OLED_font5x7, 0, 40, "Cursor over text", OLED_FILL | OLED_BLACK);
+	bench_refresh(false);
+	memcpy(saved, fb, sizeof fb);
+
+	const char *names[] = {"xor cursor on", "xor cursor off"};
+	for (uint8_t pass = 0; pass < 2; pass++) {
+		sim_stats_reset();
+		OLED_put_rectangle(&oled, 36, 39, 41, 47, OLED_FILL | OLED_XOR);
+		OLED_refresh_dirty(&oled);
+		sim_bus_drain();
+		bench_row(names[pass], -1);
+	}
+	if (memcmp(saved, fb, sizeof fb)) {
+		printf("xor cursor did not restore frame buffer\n");
+		failures++;
+	}
+}
+
+
+/* OLED_OPT_CHECKSUM. Refresh of unchanged frame is timed, CPU only, as it
+ * checks all pages and sends nothing. Then redrawn text, which is the same
+ * as before, is skipped and a byte written straight to frame buffer, with
+ * no dirty span, is sent as its whole page
+ */
+static void bench_checksum(uint8_t opts)
+{
+	OLED_init(&oled, BENCH_WIDTH, BENCH_HEIGHT, fb, BENCH_HZ, BENCH_ADDR, opts | OLED_OPT_CHECKSUM);
+	sim_bus_drain();
+	OLED_put_string(&oled, &OLED_font5x7, 0, 8, "Checksum of page", OLED_FILL | OLED_BLACK);
+	bench_refresh(true);
+
+	uint64_t start = now_ns();
+	for (uint16_t i = 0; i < BENCH_ITERS; i++)
+		bench_refresh(false);
+	bench_row("sum clean", (double)(now_ns() - start) / BENCH_ITERS);
+
+	OLED_put_string(&oled, &OLED_font5x7, 0, 8, "Checksum of page", OLED_FILL | OLED_BLACK);
+	bench_refresh(false);
+	bench_row("sum same text", -1);
+	fb[3 * BENCH_WIDTH + 70] ^= 0x18;
+	bench_refresh(false);
+	bench_row("sum direct write", -1);
+	OLED_put_pixel(&oled, 70, 20, OLED_XOR);
+	bench_refresh(false);
+	bench_row("sum put_pixel", -1);
+
+	OLED_init(&oled, BENCH_WIDTH, BENCH_HEIGHT, fb, BENCH_HZ, BENCH_ADDR, opts);
+	sim_bus_drain();
+	bench_refresh(true);
+}
+
+
+/* Refresh right after init, with init commands still queued. They must
+ * reach display intact, not be overwritten by commands of refresh
+ */
+static void bench_init_refresh(uint8_t opts)
+{
+#if defined(OLED_STATIC_WIDTH)
+	const uint8_t h = BENCH_HEIGHT, com_pins = 0x12;
+	OLED_init(&oled, BENCH_WIDTH, BENCH_HEIGHT, fb, BENCH_HZ, BENCH_ADDR, opts);
+#else
+	const uint8_t h = 32, com_pins = 0x02;
+	OLED_init(&oled, BENCH_WIDTH, 32, fb, BENCH_HZ, BENCH_ADDR, opts);
+#endif
+	OLED_refresh(&oled);
+	sim_bus_drain();
+	uint8_t addr_mode = (opts & OLED_OPT_HORIZADDR) ? 0 : 2;
+	bool is_ok = (dev->mux == h - 1) && (dev->com_pins == com_pins) && (dev->addr_mode == addr_mode);
+	uint16_t mism = sim_ssd1306_compare(dev, fb, BENCH_WIDTH, h / 8);
+	printf("%-18s %9s%s\n", "init + refresh", "-",
+	       mism ? "  GDDRAM MISMATCH" : (is_ok ? "" : "  SETUP WRONG"));
+	if (mism || !is_ok)
+		failures++;
+
+	OLED_init(&oled, BENCH_WIDTH, BENCH_HEIGHT, fb, BENCH_HZ, BENCH_ADDR, opts);
+	sim_bus_drain();
+	bench_refresh(true);
+}
+
+
+#if !defined(OLED_STATIC_WIDTH)
+/* Status screen: framed text lines, a gauge and a few sprites */
+static void draw_scene(OLED *o)
+{
+	OLED_put_rectangle(o, 0, 0, BENCH_WIDTH - 1, BENCH_HEIGHT - 1, OLED_NO_FILL | OLED_BLACK);
+	OLED_put_string(o, &OLED_font5x7, 4, 3, "Banded rendering", OLED_FILL | OLED_BLACK);
+	OLED_put_string(o, &OLED_font5x7, 4, 13, "T=23.5C  RH=41%", OLED_FILL | OLED_BLACK);
+	OLED_put_rectangle(o, 4, 24, 123, 31, OLED_NO_FILL | OLED_BLACK);
+	OLED_put_rectangle(o, 6, 26, 80, 29, OLED_FILL | OLED_BLACK);
+	OLED_put_rectangle(o, 2, 11, 125, 21, OLED_XOR);
+	OLED_put_line(o, 84, 26, 122, 52, OLED_BLACK);
+	OLED_put_circle(o, 104, 44, 9, OLED_XOR | OLED_FILL);
+	OLED_put_triangle(o, 60, 60, 70, 35, 80, 60, OLED_BLACK | OLED_FILL);
+	for (int16_t s = 0; s < 6; s++)
+		OLED_blit(o, 6 + s * 20, 37 + (s & 1) * 7, 16, 16, sprite, sprite_mask, OLED_BLIT_COPY);
+}
+
+
+/* Draws the scene and refreshes the whole display BENCH_ITERS / 10 times on
+ * frame buffer and then on 1 and 2 bands. Time includes drawing, rasterizing
+ * and emulated bus, so only the difference between rows is meaningful
+ */
+static void bench_banded(uint8_t opts)
+{
+	static uint8_t bands[OLED_MAX_BANDS * BENCH_WIDTH], dl[320];
+	OLED ref;
+	OLED_init(&ref, BENCH_WIDTH, BENCH_HEIGHT, fb, BENCH_HZ, BENCH_ADDR, opts);
+	sim_bus_drain();
+	memset(fb, 0, sizeof fb);
+	draw_scene(&ref);
+
+	for (uint8_t nb = 0; nb <= OLED_MAX_BANDS; nb++) {
+		char name[20] = "scene frame buffer";
+		if (nb) {
+			snprintf(name, sizeof name, "scene %u band%s", nb, (nb > 1) ? "s" : "");
+			OLED_init_banded(&oled, BENCH_WIDTH, BENCH_HEIGHT, bands, nb, dl, sizeof dl,
+					 BENCH_HZ, BENCH_ADDR, opts);
+		} else {
+			OLED_init(&oled, BENCH_WIDTH, BENCH_HEIGHT, fb, BENCH_HZ, BENCH_ADDR, opts);
+		}
+		sim_bus_drain();
+		uint64_t start = now_ns();
+		for (uint16_t i = 0; i < BENCH_ITERS / 10; i++) {
+			if (nb)
+				OLED_dl_clear(&oled);
+			else
+				memset(fb, 0, sizeof fb);
+			draw_scene(&oled);
+			bench_refresh(true);
+		}
+		bench_row(name, (double)(now_ns() - start) / (BENCH_ITERS / 10));
+	}
+	/* Pixel state with more bits than color and XOR is not recorded */
+	uint16_t dl_len = oled.dl_len;
+	bool is_ok = (OLED_EPARAMS == OLED_put_pixel(&oled, 1, 1, 0x10))
+		     && (OLED_EPARAMS == OLED_put_pixel(&oled, 1, 1, OLED_FILL)) && (dl_len == oled.dl_len);
+	printf("%-18s %9s%s\n", "pixel state", "-", is_ok ? "" : "  WRONG");
+	if (!is_ok)
+		failures++;
+	printf("RAM: frame buffer %u B, band %u B + display list %u B\n",
+	       (unsigned)sizeof fb, BENCH_WIDTH, oled.dl_len);
+}
+#endif
+
+
+#if !defined(OLED_STATIC_WIDTH)
+/* Smaller panels: full refresh must take width * height / 8 bytes and land
+ * at column offset of panel, with multiplex ratio and COM pins set up.
+ * GDDRAM outside of panel is filled with 0xAA first and must stay so
+ */
+static void bench_panels(uint8_t opts)
+{
+	static const struct {
+		uint8_t width, height, col_offset, com_pins;
+	} panels[] = {
+		{128, 32, 0, 0x02},
+		{72, 40, 28, 0x12},
+		{64, 48, 32, 0x12},
+	};
+	static uint8_t pfb[sizeof fb];
+	for (uint8_t n = 0; n < OLED_ARR_SIZE(panels); n++) {
+		uint8_t w = panels[n].width, h = panels[n].height;
+		bench_reset();
+		dev = sim_ssd1306_attach(BENCH_ADDR);
+		dev->col_offset = panels[n].col_offset;
+		memset(dev->gddram, 0xAA, sizeof dev->gddram);
+		sei();
+		memset(pfb, 0, sizeof pfb);
+		/* Geometry is checked at compile time, so it can't be taken from table */
+		OLED_err err;
+		if (0 == n)
+			err = OLED_init(&oled, 128, 32, pfb, BENCH_HZ, BENCH_ADDR, opts);
+		else if (1 == n)
+			err = OLED_init(&oled, 72, 40, pfb, BENCH_HZ, BENCH_ADDR, opts);
+		else
+			err = OLED_init(&oled, 64, 48, pfb, BENCH_HZ, BENCH_ADDR, opts);
+		bool is_ok = OLED_EOK == err;
+		OLED_put_string(&oled, &OLED_font5x7, 0, h - 8, "Panel", OLED_FILL | OLED_BLACK);
+		OLED_put_rectangle(&oled, 0, 0, w - 1, h - 1, OLED_NO_FILL | OLED_BLACK);
+		sim_bus_drain();
+		sim_stats_reset();
+		OLED_refresh(&oled);
+		sim_bus_drain();
+
+		uint16_t mism = sim_ssd1306_compare(dev, pfb, w, h / 8);
+		for (uint8_t page = 0; page < 8; page++) {
+			for (uint8_t x = 0; x < 128; x++) {
+				bool is_panel = (page < h / 8) && (x >= dev->col_offset) && (x < dev->col_offset + w);
+				if (!is_panel && (0xAA != dev->gddram[page][x]))
+					mism++;
+			}
+		}
+		is_ok &= (dev->mux == h - 1) && (dev->com_pins == panels[n].com_pins);
+		char name[20];
+		snprintf(name, sizeof name, "panel %ux%u", w, h);
+		printf("%-18s %9s %7u %7u %6u %6u %9.1f%s\n", name, "-", oled.refresh_bytes, sim_stats.bytes,
+		       sim_stats.isr_calls, sim_stats.starts, sim_stats.bus_ns / 1000.0,
+		       mism ? "  GDDRAM MISMATCH" : (is_ok ? "" : "  SETUP WRONG"));
+		if (mism || !is_ok)
+			failures++;
+	}
+}
+
+
+/* Half turn of a panel narrower than GDDRAM: with segments reversed it is
+ * at 128 - width - col_offset, so full refresh must be sent to columns from
+ * there on. 72x40 is in the middle of GDDRAM and stays, 96x16 moves from 0
+ * to 32. GDDRAM is filled with 0xAA before each refresh, outside of panel
+ * it must stay so
+ */
+static void bench_panels_turned(uint8_t opts)
+{
+	static const struct {
+		uint8_t width, height, col_offset;
+	} panels[] = {
+		{72, 40, 28},
+		{96, 16, 0},
+	};
+	static uint8_t pfb[sizeof fb];
+	for (uint8_t n = 0; n < OLED_ARR_SIZE(panels); n++) {
+		uint8_t w = panels[n].width, h = panels[n].height;
+		bench_reset();
+		dev = sim_ssd1306_attach(BENCH_ADDR);
+		dev->col_offset = panels[n].col_offset;
+		sei();
+		memset(pfb, 0, sizeof pfb);
+		if (0 == n)
+			OLED_init(&oled, 72, 40, pfb, BENCH_HZ, BENCH_ADDR, opts);
+		else
+			OLED_init(&oled, 96, 16, pfb, BENCH_HZ, BENCH_ADDR, opts);
+		OLED_put_string(&oled, &OLED_font5x7, 0, h - 8, "Turn", OLED_FILL | OLED_BLACK);
+		OLED_put_rectangle(&oled, 0, 0, w - 1, h - 1, OLED_NO_FILL | OLED_BLACK);
+		bool is_ok = true;
+		uint16_t mism = 0;
+		for (uint8_t turn = 0; turn < 2; turn++) {
+			OLED_set_rotation(&oled, turn ? OLED_ROTATE_0 : OLED_ROTATE_180);
+			sim_bus_drain();
+			memset(dev->gddram, 0xAA, sizeof dev->gddram);
+			OLED_refresh(&oled);
+			sim_bus_drain();
+			is_ok &= dev->seg_remap == !turn;
+			uint8_t from = turn ? dev->col_offset : 128 - w - dev->col_offset;
+			mism += sim_ssd1306_compare(dev, pfb, w, h / 8);
+			for (uint8_t page = 0; page < 8; page++) {
+				for (uint8_t x = 0; x < 128; x++) {
+					bool is_panel = (page < h / 8) && (x >= from) && (x < from + w);
+					if (!is_panel && (0xAA != dev->gddram[page][x]))
+						mism++;
+				}
+			}
+		}
+		char name[20];
+		snprintf(name, sizeof name, "turned 180 %ux%u", w, h);
+		printf("%-18s %9s%s\n", name, "-", mism ? "  GDDRAM MISMATCH" : (is_ok ? "" : "  SETUP WRONG"));
+		if (mism || !is_ok)
+			failures++;
+	}
+}
+#endif
+
+
+/* Displays sharing the bus. The first one is the benchmark display */
+#define BENCH_DISPLAYS 4
+
+static void bench_multi_row(const char *name, OLED *o, struct sim_ssd1306 **d, uint8_t (*fbs)[sizeof fb])
+{
+	uint32_t gddram = 0;
+	uint16_t mism = 0;
+	printf("%-18s %9s", name, "-");
+	for (uint8_t i = 0; i < BENCH_DISPLAYS; i++) {
+		gddram += o[i].refresh_bytes;
+		mism += sim_ssd1306_compare(d[i], fbs[i], BENCH_WIDTH, BENCH_HEIGHT / 8);
+	}
+	printf(" %7u %7u %6u %6u %9.1f  done us:", gddram, sim_stats.bytes, sim_stats.isr_calls,
+	       sim_stats.starts, sim_stats.bus_ns / 1000.0);
+	for (uint8_t i = 0; i < BENCH_DISPLAYS; i++)
+		printf(" %.0f", d[i]->data_ns / 1000.0);
+	printf("%s\n", mism ? "  GDDRAM MISMATCH" : "");
+	if (mism)
+		failures++;
+}
+
+
+/* Refreshes displays sharing the bus at once, then queues a one pixel update
+ * of the second display behind full refresh of the first one. Reports time
+ * since the start when the last data byte of each display went out
+ */
+static void bench_multi(uint8_t opts)
+{
+	static uint8_t fbs[BENCH_DISPLAYS][sizeof fb];
+	OLED o[BENCH_DISPLAYS];
+	struct sim_ssd1306 *d[BENCH_DISPLAYS];
+	bench_reset();
+	sei();
+	for (uint8_t i = 0; i < BENCH_DISPLAYS; i++)
+		d[i] = sim_ssd1306_attach(BENCH_ADDR + i);
+	/* Address is checked at compile time, so it can't be a loop variable */
+	OLED_init(&o[0], BENCH_WIDTH, BENCH_HEIGHT, fbs[0], BENCH_HZ, BENCH_ADDR, opts);
+	OLED_init(&o[1], BENCH_WIDTH, BENCH_HEIGHT, fbs[1], BENCH_HZ, BENCH_ADDR + 1, opts);
+	OLED_init(&o[2], BENCH_WIDTH, BENCH_HEIGHT, fbs[2], BENCH_HZ, BENCH_ADDR + 2, opts);
+	OLED_init(&o[3], BENCH_WIDTH, BENCH_HEIGHT, fbs[3], BENCH_HZ, BENCH_ADDR + 3, opts);
+	for (uint8_t i = 0; i < BENCH_DISPLAYS; i++) {
+		char text[] = "Display 0";
+		text[sizeof text - 2] += i;
+		memset(fbs[i], 0, sizeof fb);
+		OLED_put_string(&o[i], &OLED_font5x7, 8 * i, 8 * i, text, OLED_FILL | OLED_BLACK);
+	}
+	sim_bus_drain();
+
+	sim_stats_reset();
+	for (uint8_t i = 0; i < BENCH_DISPLAYS; i++)
+		OLED_refresh(&o[i]);
+	sim_bus_drain();
+	bench_multi_row("4 displays full", o, d, fbs);
+
+	sim_stats_reset();
+	OLED_refresh(&o[0]);
+	OLED_put_pixel(&o[1], 100, 50, true);
+	OLED_refresh_dirty(&o[1]);
+	for (uint8_t i = 2; i < BENCH_DISPLAYS; i++)
+		o[i].refresh_bytes = 0;
+	sim_bus_drain();
+	bench_multi_row("full + pixel", o, d, fbs);
+}
+
+
+#if !defined(OLED_SPI)
+/* Reports TWI error counters of a case and whether it ended as expected */
+static void bench_errors_row(const char *name, bool is_ok)
+{
+	OLED_i2c_errors e;
+	OLED_i2c_errors_snapshot(&e, true);
+	printf("%-18s nacks %u, arb lost %u, retries %u, drops %u, timeouts %u, bus us %.1f%s\n",
+	       name, e.nacks, e.arb_lost, e.retries, e.drops, e.timeouts, sim_stats.bus_ns / 1000.0,
+	       is_ok ? "" : "  FAILED");
+	if (!is_ok)
+		failures++;
+}
+
+
+/* Injects TWI faults into full refresh: NACK and lost arbitration must be
+ * retried with GDDRAM left intact, display which is not there must be given
+ * up on, and stuck bus must be recovered by watchdog and the frame sent
+ * again as a whole by the next dirty refresh
+ */
+static void bench_errors(uint8_t opts)
+{
+	OLED_i2c_errors e;
+	OLED ghost;
+	bench_reset();
+	dev = sim_ssd1306_attach(BENCH_ADDR);
+	sei();
+	OLED_init(&oled, BENCH_WIDTH, BENCH_HEIGHT, fb, BENCH_HZ, BENCH_ADDR, opts);
+	sim_bus_drain();
+	for (uint16_t i = 0; i < sizeof fb; i++)
+		fb[i] = i * 7;
+	OLED_i2c_errors_snapshot(&e, true);
+
+	sim_stats_reset();
+	sim_twi_fault(500, 0x30);
+	bench_refresh(true);
+	OLED_i2c_errors_snapshot(&e, false);
+	bench_errors_row("data nack", !sim_ssd1306_compare(dev, fb, BENCH_WIDTH, BENCH_HEIGHT / 8)
+			 && (1 == e.retries) && !e.drops);
+
+	sim_stats_reset();
+	memset(fb, 0x5A, sizeof fb);
+	sim_twi_fault(300, 0x38);
+	bench_refresh(true);
+	OLED_i2c_errors_snapshot(&e, false);
+	bench_errors_row("arbitration lost", !sim_ssd1306_compare(dev, fb, BENCH_WIDTH, BENCH_HEIGHT / 8)
+			 && (1 == e.retries) && !e.drops);
+
+	/* Every transaction is tried OLED_I2C_RETRIES + 1 times */
+	OLED_init(&ghost, BENCH_WIDTH, BENCH_HEIGHT, fb, BENCH_HZ, BENCH_ADDR + 1, opts);
+	sim_bus_drain();
+	sim_stats_reset();
+	OLED_refresh(&ghost);
+	sim_bus_drain();
+	OLED_i2c_errors_snapshot(&e, false);
+	bench_errors_row("no display", OLED_is_idle(&ghost) && e.drops
+			 && (e.nacks == e.drops * (OLED_I2C_RETRIES + 1)));
+
+	/* Drops on the way to another display don't make this one send all */
+	sim_stats_reset();
+	OLED_put_pixel(&oled, 3, 3, OLED_XOR);
+	bench_refresh(false);
+	bench_errors_row("other display drop", (1 == oled.refresh_bytes)
+			 && !sim_ssd1306_compare(dev, fb, BENCH_WIDTH, BENCH_HEIGHT / 8));
+
+	sim_stats_reset();
+	for (uint16_t i = 0; i < sizeof fb; i++)
+		fb[i] = i * 13;
+	/* Internal pull-ups of SDA and SCL must be left on after recovery */
+	uint8_t pullups = (1 << OLED_TWI_SDA_BIT) | (1 << OLED_TWI_SCL_BIT);
+	OLED_TWI_PORT |= pullups;
+	sim_twi_hang(200);
+	OLED_refresh(&oled);
+	bool is_idle = OLED_EOK == OLED_wait_idle(&oled, 1000);
+	bool is_pulled = (OLED_TWI_PORT & pullups) == pullups;
+	OLED_TWI_PORT &= ~pullups;
+	OLED_i2c_errors_snapshot(&e, false);
+	bench_errors_row("stuck bus", is_idle && is_pulled && (1 == e.timeouts));
+
+	/* Animation data comes from decoder, so transaction can't be sent */
+	/* again. Dropped one must leave decoder at the end of its span	   */
+	static const uint8_t *frame_ends[64];
+	OLED_anim anim;
+	OLED_anim_init(&oled, &anim, anim_demo);
+	for (uint16_t n = 0; OLED_anim_frame(&oled, &anim); n++) {
+		sim_bus_drain();
+		frame_ends[n] = anim.pos;
+	}
+	OLED_anim_rewind(&anim);
+	OLED_i2c_errors_snapshot(&e, true);
+	bool is_synced = true;
+	for (uint16_t n = 0; n < anim.num_frames; n++) {
+		sim_stats_reset();
+		sim_twi_fault(30, 0x30);
+		OLED_anim_frame(&oled, &anim);
+		sim_bus_drain();
+		is_synced &= (anim.pos == frame_ends[n]) && OLED_is_idle(&oled);
+	}
+	OLED_i2c_errors_snapshot(&e, false);
+	bench_errors_row("anim data nack", is_synced && e.drops);
+	bench_refresh(false);
+	bench_row("refresh after drop", -1);
+}
+
+
+/* Full frame on 1 MHz (Fm+) TWI, where ISR time per byte is a large part
+ * of the byte time (144 cycles at 16 MHz). See OLED_TWI_FASTISR
+ */
+static void bench_fmplus(uint8_t opts)
+{
+	bench_reset();
+	dev = sim_ssd1306_attach(BENCH_ADDR);
+	sei();
+	OLED_init(&oled, BENCH_WIDTH, BENCH_HEIGHT, fb, 1000000UL, BENCH_ADDR, opts);
+	sim_bus_drain();
+	for (uint16_t i = 0; i < sizeof fb; i++)
+		fb[i] = i * 3;
+	bench_refresh(true);
+	bench_row("full at 1 MHz", -1);
+	printf("%-18s %9s %7.0f cycles/byte\n", "", "",
+	       (double)sim_stats.bus_ns * F_CPU / 1e9 / sim_stats.bytes);
+}
+#endif
+
+
+#if defined(OLED_SPI)
+/* CS pin is a bit of 8-bit port, display with a higher one is refused.
+ * OLED_init checks constant pin at compile time, so __OLED_init is called
+ */
+static void bench_spi_cs(uint8_t opts)
+{
+	OLED other;
+	bool is_ok = (OLED_EPARAMS == __OLED_init(&other, BENCH_WIDTH, BENCH_HEIGHT, fb, BENCH_HZ, 8, opts))
+		     && (OLED_EPARAMS == __OLED_init(&other, BENCH_WIDTH, BENCH_HEIGHT, fb, BENCH_HZ, 0xFF, opts));
+	printf("%-18s %9s%s\n", "spi cs pin", "-", is_ok ? "" : "  WRONG");
+	if (!is_ok)
+		failures++;
+}
+#endif
+
+
+#if defined(OLED_SPI) && !defined(OLED_SPI_USART)
+/* SPI clock must be the fastest one not above requested. __OLED_init is
+ * called, as OLED_init takes only constant frequency. SPI is set up once
+ * for all displays, so it is disabled before each init
+ */
+static void bench_spi_clock(uint8_t opts)
+{
+	static const struct {
+		uint8_t req_div, div;
+	} clocks[] = {{2, 2}, {3, 4}, {4, 4}, {8, 8}, {16, 16}, {32, 32}, {64, 64}, {100, 128}, {128, 128}};
+	bool is_ok = true;
+	for (uint8_t n = 0; n < OLED_ARR_SIZE(clocks); n++) {
+		*sim_reg(SIM_SPCR) = 0;
+		__OLED_init(&oled, BENCH_WIDTH, BENCH_HEIGHT, fb, F_CPU / clocks[n].req_div, BENCH_ADDR, opts);
+		sim_bus_drain();
+		uint8_t spr = *sim_reg(SIM_SPCR) & 0x03;
+		uint16_t div = (3 == spr) ? 128 : 4 << (2 * spr);
+		if (*sim_reg(SIM_SPSR) & (1 << SPI2X))
+			div /= 2;
+		is_ok &= div == clocks[n].div;
+	}
+	printf("%-18s %9s%s\n", "spi dividers", "-", is_ok ? "" : "  WRONG");
+	if (!is_ok)
+		failures++;
+	*sim_reg(SIM_SPCR) = 0;
+	OLED_init(&oled, BENCH_WIDTH, BENCH_HEIGHT, fb, BENCH_HZ, BENCH_ADDR, opts);
+	sim_bus_drain();
+}
+#endif
+
+
+static void bench_mode(const char *title, uint8_t opts)
+{
+	bench_reset();
+	dev = sim_ssd1306_attach(BENCH_ADDR);
+	sei();
+	memset(fb, 0, sizeof fb);
+	OLED_init(&oled, BENCH_WIDTH, BENCH_HEIGHT, fb, BENCH_HZ, BENCH_ADDR, opts);
+	sim_bus_drain();
+
+	printf("\n%s, %s %lu kHz%s\n", title, BENCH_BUS, BENCH_HZ / 1000, BENCH_GEOMETRY);
+	printf("%-18s %9s %7s %7s %6s %6s %9s\n", "case", "draw ns", "gddram",
+	       "wire", "isr", "starts", "bus us");
+
+	bench_refresh(true);
+	bench_row("refresh full", -1);
+	bench_refresh(false);
+	bench_row("refresh clean", -1);
+#if defined(OLED_STATS)
+	bench_stats();
+#endif
+
+	for (size_t c = 0; c < OLED_ARR_SIZE(cases); c++) {
+		uint64_t start = now_ns();
+		for (uint16_t i = 0; i < BENCH_ITERS; i++)
+			cases[c].draw(i);
+		double draw_ns = (double)(now_ns() - start) / BENCH_ITERS;
+		/* Drawing once more from clean state gives refresh of the case */
+		bench_refresh(false);
+		cases[c].draw(1);
+		bench_refresh(false);
+		bench_row(cases[c].name, draw_ns);
+	}
+	bench_anim();
+	bench_console();
+	bench_xor_cursor();
+	bench_shapes();
+	bench_chart();
+	bench_rotation();
+	bench_async(opts);
+	bench_checksum(opts);
+	bench_init_refresh(opts);
+	bench_pacer("pacer 30fps text", opts, 30, 20, false);
+	bench_pacer("pacer 60fps full", opts, 60, 16, true);
+	bench_pacer_steps(opts);
+	bench_gray("gray by time", opts, BENCH_GRAY_HZ, 0);
+	bench_gray("gray by contrast", opts, BENCH_GRAY_HZ, 0xFF);
+	bench_gray_queue(opts);
+#if !defined(OLED_STATIC_WIDTH)
+	bench_banded(opts);
+	bench_panels(opts);
+	bench_panels_turned(opts);
+#endif
+	bench_multi(opts);
+#if defined(OLED_SPI)
+	bench_spi_cs(opts);
+#endif
+#if defined(OLED_SPI) && !defined(OLED_SPI_USART)
+	bench_spi_clock(opts);
+#endif
+#if !defined(OLED_SPI)
+	bench_errors(opts);
+	bench_fmplus(opts);
+#endif
+}
+
+
+int main(void)
+{
+	sprite_init();
+	bench_mode("Page addressing", OLED_OPT_PAGEADDR);
+	bench_mode("Horizontal addressing", OLED_OPT_HORIZADDR);
+
+	if (failures) {
+		printf("\n%d refresh(es) left GDDRAM different from frame buffer\n", failures);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,663 @@
+/* Host-side TWI peripheral and SSD1306 model. See sim.h */
+#include "sim.h"
+#include "avr/io.h"
+#include <stddef.h>
+#include <string.h>
+
+#ifndef F_CPU
+	#define F_CPU 16000000UL
+#endif
+
+#define SIM_MAX_DEVICES 4
+
+/* Vectors are defined by the code under test. Weak so it may omit them */
+void TWI_vect(void) __attribute__((weak));
+void SPI_STC_vect(void) __attribute__((weak));
+void USART_UDRE_vect(void) __attribute__((weak));
+void USART_TX_vect(void) __attribute__((weak));
+void TIMER1_COMPA_vect(void) __attribute__((weak));
+
+struct sim_stats sim_stats;
+uint64_t sim_cycles;
+
+static uint8_t regs[SIM_NUM_REGS] = { [SIM_PRR] = 0xFF };
+static uint16_t regs16[SIM_NUM_REGS16];
+static uint64_t timer1_synced;	/* sim_cycles when TCNT1 was last updated */
+static bool in_isr;
+static bool twi_irq_pending;	/* TWINT flag raised by hardware */
+static enum {
+	BUS_FREE = 0,
+	BUS_ADDR,		/* START sent, SLA+R/W expected */
+	BUS_DATA		/* Slave addressed, data bytes follow */
+} bus;
+static struct sim_ssd1306 devices[SIM_MAX_DEVICES];
+static uint8_t num_devices;
+static struct sim_ssd1306 *target;
+
+/* SPI and USART in master SPI mode */
+static enum sim_regid spi_cs_port, spi_dc_port;
+static uint8_t spi_dc_bit;
+static uint8_t spi_cs_last;		/* CS pins seen by the last step	*/
+static bool spdr_written;		/* SPDR accessed, transfer to start	*/
+static bool spi_irq_pending;		/* SPIF raised by hardware		*/
+static bool udr_written;		/* UDR0 accessed, byte to be buffered	*/
+static bool udr_full;			/* Transmit buffer holds udr_byte	*/
+static uint8_t udr_byte;
+static bool usart_shifting;		/* Shift register holds shift_byte	*/
+static uint8_t shift_byte;
+static uint16_t shift_isr_cycles;	/* ISR time spent while it shifts	*/
+static bool usart_txc;			/* TXC0 flag				*/
+static bool timer1_match;		/* OCF1A flag				*/
+static uint16_t isr_cycles;		/* Reported by ISR being run		*/
+
+/* TWI faults, see sim_twi_fault and sim_twi_hang. Byte 0 is none */
+static uint32_t twi_fault_byte;
+static uint8_t twi_fault_status;
+static uint32_t twi_hang_byte;
+static bool twi_hung;			/* SDA is held low by slave		*/
+
+
+static void bus_cycles(uint64_t cycles)
+{
+	sim_stats.bus_ns += cycles * 1000000000ULL / F_CPU;
+	sim_cycles += cycles;
+}
+
+
+static void bus_bits(uint8_t nbits)
+{
+	uint8_t twps = regs[SIM_TWSR] & 0x03;
+	bus_cycles(nbits * (16 + 2 * (uint64_t)regs[SIM_TWBR] * (1u << (2 * twps))));
+}
+
+
+/* Number of argument bytes following command byte */
+static uint8_t cmd_args(uint8_t cmd)
+{
+	switch (cmd) {
+	case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3:
+	case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+		return 1;
+	case 0x21: case 0x22: case 0xA3:
+		return 2;
+	case 0x29: case 0x2A:
+		return 5;
+	case 0x26: case 0x27:
+		return 6;
+	default:
+		return 0;
+	}
+}
+
+
+static void cmd_exec(struct sim_ssd1306 *dev)
+{
+	uint8_t *c = dev->cmd;
+	sim_stats.cmd_bytes += dev->cmd_len;
+
+	if (c[0] <= 0x0F) {
+		dev->col = (dev->col & 0xF0) | c[0];
+	} else if (c[0] <= 0x1F) {
+		dev->col = (dev->col & 0x0F) | ((c[0] & 0x0F) << 4);
+	} else if (c[0] >= 0x40 && c[0] <= 0x7F) {
+		dev->start_line = c[0] & 0x3F;
+	} else if (c[0] >= 0xB0 && c[0] <= 0xB7) {
+		dev->page = c[0] & 0x07;
+	} else switch (c[0]) {
+	case 0x20:
+		dev->addr_mode = c[1] & 0x03;
+		break;
+	case 0x21:
+		dev->col_start = dev->col = c[1] & 0x7F;
+		dev->col_end = c[2] & 0x7F;
+		break;
+	case 0x22:
+		dev->page_start = dev->page = c[1] & 0x07;
+		dev->page_end = c[2] & 0x07;
+		break;
+	case 0x81:
+		dev->contrast = c[1];
+		break;
+	case 0xA8:
+		dev->mux = c[1] & 0x3F;
+		break;
+	case 0xDA:
+		dev->com_pins = c[1];
+		break;
+	case 0x8D:
+		dev->charge_pump = (c[1] & 0x04) != 0;
+		break;
+	case 0xA0: case 0xA1:
+		dev->seg_remap = c[0] & 0x01;
+		break;
+	case 0xC0: case 0xC8:
+		dev->com_reverse = (c[0] & 0x08) != 0;
+		break;
+	case 0xA6: case 0xA7:
+		dev->inverted = c[0] & 0x01;
+		break;
+	case 0xAE: case 0xAF:
+		dev->display_on = c[0] & 0x01;
+		break;
+	case 0x26: case 0x27: case 0x29: case 0x2A:
+		memcpy(dev->scroll, c, dev->cmd_len);
+		break;
+	case 0x2E: case 0x2F:
+		dev->scrolling = c[0] & 0x01;
+		break;
+	}
+}
+
+
+static void gddram_write(struct sim_ssd1306 *dev, uint8_t byte)
+{
+	sim_stats.data_bytes++;
+	dev->data_ns = sim_stats.bus_ns;
+	dev->gddram[dev->page & 0x07][dev->col & 0x7F] = byte;
+
+	switch (dev->addr_mode) {
+	case 0:		/* Horizontal */
+		if (dev->col == dev->col_end) {
+			dev->col = dev->col_start;
+			dev->page = (dev->page == dev->page_end) ? dev->page_start : dev->page + 1;
+		} else {
+			dev->col++;
+		}
+		break;
+	case 1:		/* Vertical */
+		if (dev->page == dev->page_end) {
+			dev->page = dev->page_start;
+			dev->col = (dev->col == dev->col_end) ? dev->col_start : dev->col + 1;
+		} else {
+			dev->page++;
+		}
+		break;
+	default:	/* Page */
+		dev->col = (dev->col + 1) & 0x7F;
+		break;
+	}
+}
+
+
+/* Byte of GDDRAM data or of command */
+static void dev_write(struct sim_ssd1306 *dev, uint8_t byte, bool is_data)
+{
+	if (is_data) {
+		gddram_write(dev, byte);
+	} else {
+		if (!dev->cmd_len)
+			dev->cmd_need = 1 + cmd_args(byte);
+		dev->cmd[dev->cmd_len++] = byte;
+		if (dev->cmd_len == dev->cmd_need) {
+			cmd_exec(dev);
+			dev->cmd_len = 0;
+		}
+	}
+}
+
+
+/* Byte received over I2C, where control bytes tell data from commands */
+static void dev_byte(struct sim_ssd1306 *dev, uint8_t byte)
+{
+	if (dev->expect_ctrl) {
+		dev->single = (byte & 0x80) != 0;
+		dev->is_data = (byte & 0x40) != 0;
+		dev->expect_ctrl = false;
+		return;
+	}
+
+	dev_write(dev, byte, dev->is_data);
+
+	if (dev->single)
+		dev->expect_ctrl = true;
+}
+
+
+static bool irq_enabled(void)
+{
+	return !in_isr && (regs[SIM_SREG] & _BV(SREG_I));
+}
+
+
+static void isr_dispatch(void (*vect)(void))
+{
+	uint8_t sreg = regs[SIM_SREG];
+	if (NULL == vect)
+		return;
+	in_isr = true;
+	regs[SIM_SREG] &= (uint8_t)~_BV(SREG_I);
+	sim_stats.isr_calls++;
+	vect();
+	regs[SIM_SREG] = sreg;
+	in_isr = false;
+}
+
+
+static void twi_status(uint8_t status)
+{
+	regs[SIM_TWSR] = (regs[SIM_TWSR] & 0x07) | status;
+	twi_irq_pending = true;
+}
+
+
+/* Byte has been put on the wire. Returns true if a fault replaced it */
+static bool twi_fault(void)
+{
+	if (twi_hang_byte && (sim_stats.bytes >= twi_hang_byte)) {
+		twi_hang_byte = 0;
+		twi_hung = true;
+		return true;
+	}
+	if (!twi_fault_byte || (sim_stats.bytes != twi_fault_byte))
+		return false;
+	twi_fault_byte = 0;
+	twi_status(twi_fault_status);
+	if ((0x38 == twi_fault_status) || (0x00 == twi_fault_status)) {
+		if ((NULL != target) && target->cmd_len)
+			target->cmd_len = 0;
+		target = NULL;
+		bus = BUS_FREE;
+	}
+	return true;
+}
+
+
+static bool twi_step(void)
+{
+	uint8_t twcr = regs[SIM_TWCR];
+
+	/* Disabled TWI forgets the transfer. Slave lets SDA go on SCL pulse */
+	if (!(twcr & _BV(TWEN))) {
+		twi_irq_pending = false;
+		target = NULL;
+		bus = BUS_FREE;
+		if (twi_hung && (regs[SIM_DDRC] & _BV(5)))
+			twi_hung = false;
+		return false;
+	}
+	if (twi_hung)
+		return false;
+
+	/* Polled driver clears the flag by writing TWINT, as interrupt is off */
+	if (twi_irq_pending && !(twcr & _BV(TWIE)) && (twcr & _BV(TWINT)))
+		twi_irq_pending = false;
+	if (twi_irq_pending) {
+		if (!irq_enabled() || !(twcr & _BV(TWIE)))
+			return false;
+		twi_irq_pending = false;
+		isr_cycles = 0;
+		isr_dispatch(TWI_vect);
+		bus_cycles(isr_cycles);	/* SCL is held low meanwhile */
+		return true;
+	}
+
+	if (!(twcr & _BV(TWEN)) || !(twcr & _BV(TWINT)))
+		return false;
+	regs[SIM_TWCR] &= (uint8_t)~_BV(TWINT);
+
+	if (twcr & _BV(TWSTO)) {
+		regs[SIM_TWCR] &= (uint8_t)~_BV(TWSTO);
+		if (bus != BUS_FREE) {
+			sim_stats.stops++;
+			bus_bits(2);	/* STOP and bus free time */
+		}
+		if ((NULL != target) && target->cmd_len)
+			target->cmd_len = 0;	/* Incomplete command is dropped */
+		target = NULL;
+		bus = BUS_FREE;
+		if (!(twcr & _BV(TWSTA)))
+			return true;
+	}
+
+	if (twcr & _BV(TWSTA)) {
+		sim_stats.starts++;
+		bus_bits(1);
+		twi_status((bus == BUS_FREE) ? 0x08 : 0x10);
+		target = NULL;
+		bus = BUS_ADDR;
+	} else if (bus == BUS_ADDR) {
+		uint8_t sla = regs[SIM_TWDR];
+		sim_stats.bytes++;
+		bus_bits(9);
+		if (twi_fault())
+			return true;
+		for (uint8_t i = 0; i < num_devices; i++) {
+			if ((devices[i].addr << 1) == sla)
+				target = &devices[i];
+		}
+		if (NULL != target) {
+			target->expect_ctrl = true;
+			target->cmd_len = 0;
+		}
+		bus = BUS_DATA;
+		twi_status((NULL != target) ? 0x18 : 0x20);
+	} else if (bus == BUS_DATA) {
+		sim_stats.bytes++;
+		bus_bits(9);
+		if (twi_fault())
+			return true;
+		if (NULL != target)
+			dev_byte(target, regs[SIM_TWDR]);
+		twi_status((NULL != target) ? 0x28 : 0x30);
+	}
+	return true;
+}
+
+
+/* Byte shifted out over SPI goes to display which CS pin is driven low */
+static void spi_deliver(uint8_t byte)
+{
+	bool is_data = (regs[spi_dc_port] >> spi_dc_bit) & 0x01;
+	uint8_t cs = regs[spi_cs_port];
+	uint8_t ddr = regs[spi_cs_port + 1];	/* DDRx follows PORTx */
+	sim_stats.bytes++;
+	for (uint8_t i = 0; i < num_devices; i++) {
+		uint8_t pin = devices[i].addr;
+		if ((pin < 8) && !(cs & (1 << pin)) && (ddr & (1 << pin)))
+			dev_write(&devices[i], byte, is_data);
+	}
+}
+
+
+/* Counts CS edges of SPI displays as STARTs and STOPs */
+static void spi_watch_cs(void)
+{
+	uint8_t cs = regs[spi_cs_port] | (uint8_t)~regs[spi_cs_port + 1];
+	for (uint8_t i = 0; i < num_devices; i++) {
+		uint8_t bit = (devices[i].addr < 8) ? 1 << devices[i].addr : 0;
+		if ((spi_cs_last & bit) && !(cs & bit))
+			sim_stats.starts++;
+		if (!(spi_cs_last & bit) && (cs & bit))
+			sim_stats.stops++;
+	}
+	spi_cs_last = cs;
+}
+
+
+static bool spi_step(void)
+{
+	uint8_t spcr = regs[SIM_SPCR];
+
+	if (spi_irq_pending) {
+		if (!irq_enabled() || !(spcr & _BV(SPIE)))
+			return false;
+		spi_irq_pending = false;
+		regs[SIM_SPSR] &= (uint8_t)~_BV(SPIF);
+		bus_cycles(SIM_ISR_CYCLES);	/* Nothing is sent meanwhile */
+		isr_dispatch(SPI_STC_vect);
+		return true;
+	}
+
+	if (!spdr_written)
+		return false;
+	spdr_written = false;
+	if (!(spcr & _BV(SPE)) || !(spcr & _BV(MSTR)))
+		return true;
+	/* SPR selects 4, 16, 64 or 128, SPI2X halves it */
+	uint8_t spr = spcr & 0x03;
+	uint16_t div = (spr == 3) ? 128 : 4 << (2 * spr);
+	if (regs[SIM_SPSR] & _BV(SPI2X))
+		div /= 2;
+	bus_cycles(8 * div);
+	spi_deliver(regs[SIM_SPDR]);
+	regs[SIM_SPSR] |= _BV(SPIF);
+	spi_irq_pending = true;
+	return true;
+}
+
+
+static bool usart_step(void)
+{
+	uint8_t ucsrb = regs[SIM_UCSR0B];
+	uint16_t byte_cycles = 16 * (regs16[SIM_UBRR0] + 1);
+
+	if (regs[SIM_UCSR0A] & _BV(TXC0)) {
+		/* Written with 1, which clears the flag */
+		regs[SIM_UCSR0A] &= (uint8_t)~_BV(TXC0);
+		usart_txc = false;
+	}
+	if (udr_written) {
+		udr_written = false;
+		if ((ucsrb & _BV(TXEN0)) && ((regs[SIM_UCSR0C] >> 6) == 0x03)) {
+			udr_full = true;
+			udr_byte = regs[SIM_UDR0];
+		}
+		return true;
+	}
+	if (udr_full && !usart_shifting) {
+		udr_full = false;
+		usart_shifting = true;
+		shift_byte = udr_byte;
+		shift_isr_cycles = 0;
+		return true;
+	}
+	if (!udr_full && (ucsrb & _BV(UDRIE0)) && irq_enabled()) {
+		/* Runs while the previous byte, if any, is shifted out */
+		if (usart_shifting)
+			shift_isr_cycles += SIM_ISR_CYCLES;
+		else
+			bus_cycles(SIM_ISR_CYCLES);
+		isr_dispatch(USART_UDRE_vect);
+		return true;
+	}
+	if (usart_shifting) {
+		usart_shifting = false;
+		bus_cycles((shift_isr_cycles > byte_cycles) ? shift_isr_cycles : byte_cycles);
+		spi_deliver(shift_byte);
+		if (!udr_full)
+			usart_txc = true;
+		return true;
+	}
+	if (usart_txc && (ucsrb & _BV(TXCIE0)) && irq_enabled()) {
+		usart_txc = false;
+		bus_cycles(SIM_ISR_CYCLES);	/* Nothing is sent meanwhile */
+		isr_dispatch(USART_TX_vect);
+		return true;
+	}
+	return false;
+}
+
+
+/* Brings TCNT1 up to sim_cycles, raising OCF1A if it has passed OCR1A */
+static void timer1_sync(void)
+{
+	uint64_t elapsed = sim_cycles - timer1_synced;
+	timer1_synced = sim_cycles;
+	/* Only clk/1 prescaler is modelled, any other one counts the same */
+	if (!(regs[SIM_TCCR1B] & 0x07) || !elapsed)
+		return;
+	uint16_t to_match = regs16[SIM_OCR1A] - regs16[SIM_TCNT1];
+	if (elapsed >= (to_match ? to_match : 0x10000u))
+		timer1_match = true;
+	regs16[SIM_TCNT1] += (uint16_t)elapsed;
+}
+
+
+/* Cycles till the next compare match A, or max if its interrupt is off */
+static uint64_t timer1_till_match(uint64_t max)
+{
+	if (!(regs[SIM_TCCR1B] & 0x07) || !(regs[SIM_TIMSK1] & _BV(OCIE1A)))
+		return max;
+	uint16_t to_match = regs16[SIM_OCR1A] - regs16[SIM_TCNT1];
+	uint64_t cycles = to_match ? to_match : 0x10000u;
+	return (cycles < max) ? cycles : max;
+}
+
+
+static bool timer1_step(void)
+{
+	/* OCF1A written by software clears the flag */
+	if (regs[SIM_TIFR1] & _BV(OCF1A)) {
+		regs[SIM_TIFR1] = 0;
+		timer1_match = false;
+	}
+	timer1_sync();
+	if (!timer1_match || !(regs[SIM_TIMSK1] & _BV(OCIE1A)) || !irq_enabled())
+		return false;
+	timer1_match = false;
+	/* Timer runs on during interrupt response and ISR prologue */
+	sim_cycles += SIM_ISR_CYCLES;
+	isr_dispatch(TIMER1_COMPA_vect);
+	return true;
+}
+
+
+bool sim_bus_step(void)
+{
+	spi_watch_cs();
+	return timer1_step() || twi_step() || spi_step() || usart_step();
+}
+
+
+void sim_bus_drain(void)
+{
+	uint8_t sreg = regs[SIM_SREG];
+	regs[SIM_SREG] |= _BV(SREG_I);
+	while (sim_bus_step()) {
+		// nop
+	}
+	spi_watch_cs();
+	regs[SIM_SREG] = sreg;
+}
+
+
+void sim_delay(uint64_t cycles)
+{
+	uint64_t end = sim_cycles + cycles;
+	while (sim_cycles < end) {
+		if (sim_bus_step())
+			continue;
+		/* Bus is idle, CPU spins till the end or the timer interrupt */
+		sim_cycles += timer1_till_match(end - sim_cycles);
+	}
+	timer1_sync();
+}
+
+
+volatile uint8_t *sim_reg(enum sim_regid reg)
+{
+	sim_cycles++;
+	if (!in_isr)
+		sim_bus_step();
+	/* Transfer starts with the value written after this call returns */
+	if (SIM_SPDR == reg)
+		spdr_written = true;
+	else if (SIM_UDR0 == reg)
+		udr_written = true;
+	else if (SIM_PINC == reg)
+		regs[SIM_PINC] = _BV(5) | (twi_hung ? 0 : _BV(4));
+	return &regs[reg];
+}
+
+
+volatile uint16_t *sim_reg16(enum sim_reg16id reg)
+{
+	sim_cycles++;
+	if (!in_isr)
+		sim_bus_step();
+	timer1_sync();
+	return &regs16[reg];
+}
+
+
+void sim_stats_reset(void)
+{
+	memset(&sim_stats, 0, sizeof sim_stats);
+	for (uint8_t i = 0; i < num_devices; i++)
+		devices[i].data_ns = 0;
+}
+
+
+void sim_isr_cycles(uint16_t cycles)
+{
+	isr_cycles = cycles;
+}
+
+
+void sim_twi_fault(uint32_t byte, uint8_t status)
+{
+	twi_fault_byte = byte;
+	twi_fault_status = status;
+}
+
+
+void sim_twi_hang(uint32_t byte)
+{
+	twi_hang_byte = byte;
+}
+
+
+bool sim_twi_int(void)
+{
+	sim_reg(SIM_TWCR);
+	return twi_irq_pending;
+}
+
+
+void sim_spi_wiring(enum sim_regid cs_port, enum sim_regid dc_port, uint8_t dc_bit)
+{
+	spi_cs_port = cs_port;
+	spi_dc_port = dc_port;
+	spi_dc_bit = dc_bit;
+	spi_cs_last = 0xFF;
+}
+
+
+struct sim_ssd1306 *sim_ssd1306_attach(uint8_t addr)
+{
+	if (num_devices >= SIM_MAX_DEVICES)
+		return NULL;
+	struct sim_ssd1306 *dev = &devices[num_devices++];
+	memset(dev, 0, sizeof *dev);
+	dev->addr = addr;
+	dev->addr_mode = 2;
+	dev->col_end = 127;
+	dev->page_end = 7;
+	dev->contrast = 0x7F;
+	dev->mux = 63;
+	dev->com_pins = 0x12;
+	return dev;
+}
+
+
+void sim_reset(void)
+{
+	memset(regs, 0, sizeof regs);
+	memset(regs16, 0, sizeof regs16);
+	regs[SIM_PRR] = 0xFF;
+	sim_cycles = 0;
+	timer1_synced = 0;
+	in_isr = false;
+	twi_irq_pending = false;
+	bus = BUS_FREE;
+	target = NULL;
+	num_devices = 0;
+	sim_spi_wiring(SIM_PORTB, SIM_PORTB, 1);
+	spdr_written = false;
+	spi_irq_pending = false;
+	udr_written = false;
+	udr_full = false;
+	usart_shifting = false;
+	usart_txc = false;
+	timer1_match = false;
+	twi_fault_byte = 0;
+	twi_hang_byte = 0;
+	twi_hung = false;
+	sim_stats_reset();
+}
+
+
+uint16_t sim_ssd1306_compare(const struct sim_ssd1306 *dev, const uint8_t *fb,
+			     uint8_t width, uint8_t num_pages)
+{
+	/* Reversed segments take the panel from the other end of GDDRAM */
+	uint8_t offset = dev->seg_remap ? 128 - width - dev->col_offset : dev->col_offset;
+	uint16_t mismatches = 0;
+	for (uint8_t page = 0; page < num_pages; page++) {
+		for (uint8_t x = 0; x < width; x++) {
+			if (dev->gddram[page][(offset + x) & 0x7F] != fb[page * (uint16_t)width + x])
+				mismatches++;
+		}
+	}
+	return mismatches;
+}
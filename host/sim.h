@@ -0,0 +1,177 @@
+/* Host-side stand-in for the AVR peripherals used by the OLED library.
+ *
+ * Registers are modelled as plain bytes reached through sim_reg(). Every
+ * access made outside of an interrupt gives the simulator a chance to advance
+ * the bus (TWI, SPI or USART in master SPI mode) by one event and to run its
+ * ISR, so the busy loops of the library (spinlocks, tx_shed retries) make
+ * progress exactly like they do on hardware where the bus runs in parallel
+ * with the CPU.
+ *
+ * (!) Notice: TWINT bit in TWCR is modelled as a "go" request. It reads as 1
+ *     only after software wrote it and before the simulator consumed it. Lib
+ *     code never polls TWINT, it relies on TWI_vect and TWSR instead.
+ * (!) Notice: writes can't be told from reads, so any access to SPDR or UDR0
+ *     counts as a write of the byte to be sent, and TXC0 written to UCSR0A
+ *     clears the flag (the flag itself is not visible). The same goes for
+ *     OCF1A in TIFR1. Lib code only uses them this way.
+ */
+#ifndef OLED_HOST_SIM_H
+#define OLED_HOST_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum sim_regid {
+	SIM_SREG = 0,
+	SIM_TWBR,
+	SIM_TWSR,
+	SIM_TWAR,
+	SIM_TWDR,
+	SIM_TWCR,
+	SIM_PRR,
+	SIM_TCCR1A,
+	SIM_TCCR1B,
+	SIM_TIMSK1,
+	SIM_TIFR1,
+	SIM_SPCR,
+	SIM_SPSR,
+	SIM_SPDR,
+	SIM_UCSR0A,
+	SIM_UCSR0B,
+	SIM_UCSR0C,
+	SIM_UDR0,
+	SIM_PORTB,
+	SIM_DDRB,
+	SIM_PORTC,
+	SIM_DDRC,
+	SIM_PINC,
+	SIM_PORTD,
+	SIM_DDRD,
+	SIM_NUM_REGS
+};
+
+enum sim_reg16id {
+	SIM_TCNT1 = 0,
+	SIM_UBRR0,
+	SIM_OCR1A,
+	SIM_NUM_REGS16
+};
+
+volatile uint8_t *sim_reg(enum sim_regid reg);
+volatile uint16_t *sim_reg16(enum sim_reg16id reg);
+
+/* Crude CPU clock. Every register access takes a cycle, bus events take as
+ * many cycles as they last on the bus. Timer1 counts it with prescaler 1,
+ * compare match A is checked whenever bus is stepped
+ */
+extern uint64_t sim_cycles;
+
+/* CPU cycles of interrupt response, ISR prologue, body and epilogue. SPI bus
+ * idles for as long after each byte, USART transmitter sends next byte while
+ * ISR runs, unless D/C or CS has to be changed. TWI ISR tells its own time
+ */
+#define SIM_ISR_CYCLES 48
+
+/* Called by ISR being run to tell how many CPU cycles it takes on AVR from
+ * its interrupt till TWINT is cleared. TWI holds SCL low for as long, so bus
+ * waits after each byte like it does on hardware. No wait if not called
+ */
+void sim_isr_cycles(uint16_t cycles);
+
+/* Cumulative bus counters. Reset with sim_stats_reset(), along with
+ * data_ns of displays
+ */
+struct sim_stats {
+	uint32_t bytes;		/* Bytes on the wire, including addresses */
+	uint32_t data_bytes;	/* Bytes written to GDDRAM of any display */
+	uint32_t cmd_bytes;	/* Command bytes decoded by any display */
+	uint32_t starts;	/* START and repeated START conditions, CS falls */
+	uint32_t stops;		/* STOP conditions, CS rises */
+	uint32_t isr_calls;	/* Number of ISR invocations */
+	uint64_t bus_ns;	/* Simulated bus time, nanoseconds */
+};
+
+extern struct sim_stats sim_stats;
+
+void sim_stats_reset(void);
+
+/* Advances the bus by one event or runs pending Timer1 compare interrupt.
+ * Returns false if there is nothing to do
+ */
+bool sim_bus_step(void);
+
+/* Runs the bus until no transfer is requested and no interrupt is pending */
+void sim_bus_drain(void);
+
+/* Busy wait of _delay_us. Runs the bus and timer (and ISRs, if enabled)
+ * for cycles
+ */
+void sim_delay(uint64_t cycles);
+
+/* TWI faults. Byte number byte on the wire (counted by sim_stats.bytes,
+ * from 1) is not delivered and gets TWSR status instead, once. Arbitration
+ * lost (0x38) and bus error (0x00) also release the bus
+ */
+void sim_twi_fault(uint32_t byte, uint8_t status);
+
+/* Slave holds SDA low from byte number byte on: bus stops with no further
+ * interrupts, PINC4 (SDA) reads 0. Released when SCL (DDRC5) is driven low
+ * with TWI disabled
+ */
+void sim_twi_hang(uint32_t byte);
+
+/* TWINT flag as polled driver reads it from TWCR. TWCR itself only keeps
+ * TWINT written by software, which clears the flag. Steps the bus like any
+ * register access
+ */
+bool sim_twi_int(void);
+
+/* Simulated SSD1306 controller attached to the bus */
+struct sim_ssd1306 {
+	uint8_t addr;		/* 7-bit address. On SPI, number of CS pin */
+	uint8_t gddram[8][128];	/* [page][column] */
+	uint8_t addr_mode;	/* 0 - horizontal, 1 - vertical, 2 - page */
+	uint8_t col, page;	/* Current GDDRAM pointer */
+	uint8_t col_start, col_end;
+	uint8_t page_start, page_end;
+	uint8_t contrast;
+	uint8_t start_line;
+	uint8_t mux;		/* Multiplex ratio: rows of panel - 1 */
+	uint8_t com_pins;	/* COM pins configuration */
+	uint8_t col_offset;	/* Wiring: GDDRAM column of panel left edge */
+	bool display_on;
+	bool inverted;
+	bool seg_remap;		/* Column 127 drives the leftmost segment */
+	bool com_reverse;	/* Rows are scanned bottom to top */
+	bool charge_pump;
+	bool scrolling;
+	uint8_t scroll[7];	/* Last scroll setup command with arguments */
+	uint64_t data_ns;	/* sim_stats.bus_ns at the last GDDRAM write */
+	/* Decoder state */
+	bool in_txn;
+	bool expect_ctrl;	/* Next byte is a control byte */
+	bool single;		/* Co was set: one byte, then control again */
+	bool is_data;		/* D/C# of the current byte(s) */
+	uint8_t cmd[8];		/* Multi-byte command being collected */
+	uint8_t cmd_len, cmd_need;
+};
+
+/* Attaches a display at 7-bit address. Returns NULL if none is left */
+struct sim_ssd1306 *sim_ssd1306_attach(uint8_t addr);
+
+/* Sets ports of SPI displays: CS pins (display addr is pin number) and D/C
+ * pin. PORTB, PORTB and 1 by default
+ */
+void sim_spi_wiring(enum sim_regid cs_port, enum sim_regid dc_port, uint8_t dc_bit);
+
+/* Detaches all displays, resets registers and counters */
+void sim_reset(void);
+
+/* Compares display GDDRAM, from column col_offset on, against a
+ * page-organized frame buffer. With seg_remap panel is at the other end of
+ * GDDRAM, 128 - width - col_offset. Returns number of mismatching bytes
+ */
+uint16_t sim_ssd1306_compare(const struct sim_ssd1306 *dev, const uint8_t *fb,
+			     uint8_t width, uint8_t num_pages);
+
+#endif /* OLED_HOST_SIM_H */
@@ -0,0 +1,23 @@
+/* Host stand-in for <util/atomic.h>. See host/sim.h */
+#ifndef OLED_HOST_UTIL_ATOMIC_H
+#define OLED_HOST_UTIL_ATOMIC_H
+
+#include <stdint.h>
+#include "../avr/interrupt.h"
+
+static inline uint8_t __iCliRetVal(void)
+{
+	cli();
+	return 1;
+}
+
+static inline void __iRestore(const uint8_t *__s)
+{
+	SREG = *__s;
+}
+
+#define ATOMIC_BLOCK(type) for (type, __ToDo = __iCliRetVal(); __ToDo; __ToDo = 0)
+#define ATOMIC_RESTORESTATE uint8_t sreg_save __attribute__((__cleanup__(__iRestore))) = SREG
+#define ATOMIC_FORCEON uint8_t sreg_save __attribute__((__cleanup__(__iRestore))) = _BV(SREG_I)
+
+#endif /* OLED_HOST_UTIL_ATOMIC_H */
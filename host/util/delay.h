@@ -0,0 +1,11 @@
+/* Host stand-in for <util/delay.h>. See host/sim.h */
+#ifndef OLED_HOST_UTIL_DELAY_H
+#define OLED_HOST_UTIL_DELAY_H
+
+#include <stdint.h>
+#include "../sim.h"
+
+#define _delay_us(us) sim_delay((uint64_t)((us) * (F_CPU / 1000000.0)))
+#define _delay_ms(ms) sim_delay((uint64_t)((ms) * (F_CPU / 1000.0)))
+
+#endif /* OLED_HOST_UTIL_DELAY_H */
@@ -26,41 +26,155 @@
 #include <avr/interrupt.h>
 #include <avr/power.h>
 #include <util/atomic.h>
+#include <util/crc16.h>
+#include <util/delay.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <string.h>
+
+/* Quarter turn of drawing, see OLED_set_rotation. Drawing is as high as */
+/* frame buffer is wide then, and vice versa				 */
+#define OLED_is_turned_(oled) (((oled)->rotation & 0x01) != 0)
+#define OLED_draw_width_(oled) (OLED_is_turned_(oled) ? OLED_HEIGHT_(oled) : OLED_WIDTH_(oled))
+#define OLED_draw_height_(oled) (OLED_is_turned_(oled) ? OLED_WIDTH_(oled) : OLED_HEIGHT_(oled))
+
+/* Panel profiles. SSD1306 drives 128 columns and 64 rows, smaller glass is
+ * wired to a part of them: columns from col_offset on and rows 0..height-1
+ * in the order COM pins configuration gives
+ */
+struct OLED_panel_ {
+	uint8_t width;
+	uint8_t height;
+	uint8_t col_offset;	/* GDDRAM column of the left edge */
+	uint8_t com_pins;	/* Argument of 0xDA command	  */
+};
+
+static const struct OLED_panel_ _oled_panels[] PROGMEM = {
+	{128, 64, 0, 0x12},
+	{128, 32, 0, 0x02},
+	{96, 16, 0, 0x02},
+	{72, 40, 28, 0x12},
+	{64, 48, 32, 0x12},
+	{64, 32, 32, 0x12}
+};
 
 #if !defined(OLED_NO_I2C)
 /***** I2C-related logic *****/
-uint8_t OLED_cmdbuffer[OLED_CMDBUFFER_LEN];
+OLED_i2c_txn OLED_cmdbuffer[OLED_CMDBUFFER_LEN];
 
+/* Command templates are shared by all displays and never modified. The ones */
+/* with arguments are copied to OLED cmd buffers and filled there	     */
 static uint8_t _i2c_cmd_init[] = {
 	0x80, 0x8D, 0x80, 0x14	/* Enable charge pump	 */
 	,0x80, 0xAF		/* Display on	      	 */
 	,0x80, 0x81, 0x80, 0xFF /* Set brightness to 255 */
 	,0x80, 0xA7		/* Enable inversion 	 */
+	,0x80, 0xA0, 0x80, 0xC0	/* Not turned, see below */
+};
+
+/* Sent right after _i2c_cmd_init, in the same transaction, followed by */
+/* addressing mode. Multiplex ratio and COM pins come from panel profile */
+static uint8_t _i2c_cmd_geometry[] = {
+	0x80, 0xA8, 0x80, 0x3F,		/* Multiplex ratio: rows - 1 */
+	0x80, 0xDA, 0x80, 0x12		/* COM pins configuration    */
 };
+static uint8_t _i2c_cmd_pageaddr[] = {0x80, 0x20, 0x80, 0x02};
+static uint8_t _i2c_cmd_horizaddr[] = {0x80, 0x20, 0x80, 0x00};
 
 static uint8_t _i2c_cmd_setpage[] = {
 	0x80, 0x00, 0x80, 0x10, /* Set column cursor to 0 */
 	0x80, 0xB0 /* Last nibble in 0xB0 defines page (0xB0..0xB7) */
 };
 
+/* Used in horizontal addressing mode. Data is sent in the same transaction */
+static uint8_t _i2c_cmd_setwindow[] = {
+	0x80, 0x21, 0x80, 0x00, 0x80, 0x7F,	/* Column window start, end */
+	0x80, 0x22, 0x80, 0x00, 0x80, 0x07,	/* Page window start, end   */
+	0x40					/* Data bytes follow	    */
+};
+
 static uint8_t _i2c_cmd_setbrightness[] = {
 	0x80, 0x81, 0x80, 0xFF  /* Last byte is brightness level (0..255) */
 };
 
 static uint8_t _i2c_cmd_dataprefix[] = {0x40};
 
+/* Scroll setup goes as one command stream (control byte 0x00). Scrolling is */
+/* deactivated first, as SSD1306 requires, and activated in the end	     */
+static uint8_t _i2c_cmd_scrollh[] = {
+	0x00, 0x2E,
+	0x26, 0x00, 0x00, 0x00, 0x07, 0x00, 0xFF, /* Right, pages, interval */
+	0x2F
+};
+static uint8_t _i2c_cmd_scrolldiag[] = {
+	0x00, 0x2E,
+	0xA3, 0x00, 0x40,			  /* Vertical scroll area    */
+	0x29, 0x00, 0x00, 0x00, 0x07, 0x01,	  /* Right, pages, interval, */
+	0x2F					  /* vertical offset	     */
+};
+static uint8_t _i2c_cmd_scrollstop[] = {0x80, 0x2E};
+
+static uint8_t _i2c_cmd_startline[] = {
+	0x80, 0x40	/* Last 6 bits are start line (0..63) */
+};
+
+static uint8_t _i2c_cmd_orient[] = {
+	0x80, 0xA0,	/* Segment remap, 0xA1 reverses columns	  */
+	0x80, 0xC0	/* COM scan direction, 0xC8 reverses rows */
+};
+
+_Static_assert(OLED_ARR_SIZE(_i2c_cmd_setwindow) <= OLED_CMD_LEN,
+	       "OLED: OLED_CMD_LEN is too small for window commands");
+_Static_assert(OLED_ARR_SIZE(_i2c_cmd_geometry) + OLED_ARR_SIZE(_i2c_cmd_pageaddr) <= OLED_INIT_CMD_LEN,
+	       "OLED: OLED_INIT_CMD_LEN is too small for init commands");
+
+_Static_assert(OLED_ARR_SIZE(_i2c_cmd_setbrightness) <= OLED_ARR_SIZE(((OLED *)0)->cmd_brightness),
+	       "OLED: cmd_brightness is too small");
+_Static_assert((OLED_ARR_SIZE(_i2c_cmd_scrollh) <= OLED_ARR_SIZE(((OLED *)0)->cmd_scroll)) &&
+	       (OLED_ARR_SIZE(_i2c_cmd_scrolldiag) <= OLED_ARR_SIZE(((OLED *)0)->cmd_scroll)),
+	       "OLED: cmd_scroll is too small");
+
+/* Ring queue of pending transactions in OLED_cmdbuffer */
+static uint8_t i2c_queue_head;		/* Index of the oldest transaction	*/
+static uint8_t i2c_queue_len;		/* Number of queued transactions	*/
+static bool i2c_is_cbk;			/* Set while ISR runs end callback	*/
+
+/* Transaction on the bus. Loaded from queue when START is issued */
+static OLED_i2c_txn i2c_txn;		/* Its descriptor, to send it again	*/
+static uint8_t i2c_retries;		/* Times it has been sent again		*/
+/* Bit of each slave address (0..127) which had a transaction given up on */
+/* since its display took dirty spans last time				  */
+static volatile uint8_t i2c_dropped[16];
 static uint8_t i2c_devaddr;
 static uint8_t *i2c_prefix_ptr;
-static uint8_t *i2c_prefix_count;
+static uint8_t i2c_prefix_count;
 static uint8_t *i2c_data_ptr;
+static uint8_t (*i2c_data_gen)(void *);	/* Produces data, if not NULL	*/
 static uint16_t i2c_data_count;
-static bool i2c_is_fastfail;
+static uint16_t i2c_data_rowlen;	/* Data is sent as rows of rowlen bytes */
+static uint8_t i2c_data_rows;		/* Rows left, including current one	*/
+static uint8_t i2c_data_skip;		/* Bytes skipped between rows		*/
 static void (*i2c_callback)(void *); /* called after transaction finish */
 static void *i2c_callback_args;
 
+#if defined(OLED_TWI_FASTISR) && !defined(OLED_SPI)
+/* Data bytes left to fast path of TWI ISR, which takes them from	*/
+/* i2c_data_ptr. Already subtracted from i2c_data_count			*/
+static volatile uint8_t i2c_fast_len;
+#define OLED_FASTISRWRAP(BLOCK) BLOCK
+#else
+#define OLED_FASTISRWRAP(BLOCK)
+#endif
+
+#if defined(OLED_PACER)
+/* Bus is lent to other users, see OLED_pacer_bus_take. Nothing is started */
+static volatile bool i2c_is_taken;
+#define I2C_is_taken_() (i2c_is_taken)
+#else
+#define I2C_is_taken_() (false)
+#endif
+
 /* States used in ISR FSM */
 enum I2C_State_e {
 	I2C_STATE_IDLE = 0,
@@ -71,10 +185,230 @@ enum I2C_State_e {
 };
 static enum I2C_State_e i2c_state = I2C_STATE_IDLE;
 
+OLED_STATSWRAP(
+	static uint32_t stat_bytes;
+	static uint32_t stat_txns;
+	static uint32_t stat_shed_fails;
+	static uint32_t stat_isr_cycles;
+	static uint16_t stat_isr_cycles_max;
+	static uint32_t stat_clock;	/* OLED_STATS_TCNT extended to 32 bits */
+	static uint16_t stat_clock_last;
+)
+
+
+#if defined(OLED_STATS)
+/* Returns time, extending 16-bit timer. Must be called at least once per */
+/* timer overflow to be correct and must not be called concurrently	  */
+static uint32_t OLED_stats_clock_(void)
+{
+	uint16_t now = OLED_STATS_TCNT;
+	stat_clock += (uint16_t)(now - stat_clock_last);
+	stat_clock_last = now;
+	return stat_clock;
+}
+#endif
+
+
+/* (Re)starts sending transaction described by i2c_txn from its beginning */
+static void I2C_txn_begin(void)
+{
+	const OLED_i2c_txn *txn = &i2c_txn;
+	i2c_devaddr = (txn->addr << 1);
+	i2c_prefix_ptr = txn->prefix;
+	i2c_prefix_count = txn->prefix_len;
+	i2c_data_ptr = txn->data;
+	i2c_data_gen = txn->data_gen;
+	i2c_data_count = txn->data_len;
+	i2c_data_rowlen = txn->data_len;
+	i2c_data_rows = txn->rows;
+	i2c_data_skip = txn->skip;
+	i2c_callback = txn->end_cbk;
+	i2c_callback_args = txn->cbk_args;
+	i2c_state = I2C_STATE_SLAVEADDR;
+	OLED_FASTISRWRAP(i2c_fast_len = 0;)
+}
+
+
+/* Moves the oldest queued transaction to the bus. Queue must not be empty */
+/* and must not be accessed concurrently				     */
+static void I2C_txn_load(void)
+{
+	i2c_txn = OLED_cmdbuffer[i2c_queue_head];
+	if (++i2c_queue_head >= OLED_CMDBUFFER_LEN)
+		i2c_queue_head = 0;
+	i2c_queue_len--;
+	i2c_retries = 0;
+	I2C_txn_begin();
+}
+
+
+/* Starts transaction just loaded when bus is idle. See transports below */
+static void OLED_bus_start_(void);
+
+
+/* Copies transaction to the queue tail. Queue must not be full and must */
+/* not be accessed concurrently						    */
+static void I2C_txn_put(const OLED_i2c_txn *new_txn)
+{
+	uint8_t tail = i2c_queue_head + i2c_queue_len;
+	if (tail >= OLED_CMDBUFFER_LEN)
+		tail -= OLED_CMDBUFFER_LEN;
+	OLED_cmdbuffer[tail] = *new_txn;
+	i2c_queue_len++;
+}
+
+
+/* Copies transaction to the queue tail. Starts it at once if bus is idle.
+ * Never waits, returns false if queue is full
+ */
+static bool I2C_txn_queue(const OLED_i2c_txn *new_txn)
+{
+	bool ret = false;
+	/* No interrupts can occur while this block is executed */
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		/* Last slots are left for end callbacks, which chain next */
+		/* transaction from ISR and can not wait for a free slot   */
+		uint8_t limit = i2c_is_cbk ? OLED_CMDBUFFER_LEN : OLED_CMDBUFFER_LEN - OLED_CMDBUFFER_RESERVE;
+		if (i2c_queue_len < limit) {
+			I2C_txn_put(new_txn);
+			if ((i2c_state == I2C_STATE_IDLE) && !I2C_is_taken_()) {
+				I2C_txn_load();
+				OLED_bus_start_();
+			}
+			ret = true;
+		} else {
+			OLED_STATSWRAP(stat_shed_fails++;)
+		}
+	}
+	/* Queue does not move if the bus is stuck */
+	if (!ret && !i2c_is_cbk)
+		OLED_WATCHDOG_();
+	return ret;
+}
+
+
+/* Queues transaction, which data is a window of rows, each of bytes_len
+ * bytes, spaced by stride bytes in memory. Allows to send a rectangular part
+ * of frame buffer without per-row transactions
+ */
+static bool I2C_tx_shed_rows(uint8_t addr, uint8_t *prefix, uint8_t prefix_len, uint8_t *bytes, uint16_t bytes_len,
+			     uint8_t rows, uint16_t stride, void (*end_cbk)(void *), void *cbk_args, bool fastfail)
+{
+	OLED_i2c_txn txn = {
+		.prefix = prefix,
+		.data = bytes,
+		.data_gen = NULL,
+		.data_len = bytes_len,
+		.rows = rows,
+		.skip = stride - bytes_len,
+		.prefix_len = prefix_len,
+		.addr = addr,
+		.is_fastfail = fastfail,
+		.end_cbk = end_cbk,
+		.cbk_args = cbk_args
+	};
+	return I2C_txn_queue(&txn);
+}
+
+
+/* Queues transaction, which bytes_len data bytes are produced by data_gen,
+ * called from ISR with cbk_args for each byte
+ */
+static bool I2C_tx_shed_gen(uint8_t addr, uint8_t *prefix, uint8_t prefix_len, uint8_t (*data_gen)(void *),
+			    uint16_t bytes_len, void (*end_cbk)(void *), void *cbk_args, bool fastfail)
+{
+	OLED_i2c_txn txn = {
+		.prefix = prefix,
+		.data = NULL,
+		.data_gen = data_gen,
+		.data_len = bytes_len,
+		.rows = 1,
+		.skip = 0,
+		.prefix_len = prefix_len,
+		.addr = addr,
+		.is_fastfail = fastfail,
+		.end_cbk = end_cbk,
+		.cbk_args = cbk_args
+	};
+	return I2C_txn_queue(&txn);
+}
+
+
+/* Called from ISR between data rows. If the next queued transaction is for
+ * another display, puts the rows left to the queue tail and returns true, so
+ * that displays sharing the bus take turns page by page instead of waiting
+ * for a whole window. Display keeps its GDDRAM cursor, so the rest of rows
+ * only needs data prefix. End callback goes with them
+ */
+static bool I2C_txn_yield(void)
+{
+	if (!i2c_queue_len || (i2c_queue_len >= OLED_CMDBUFFER_LEN) ||
+	    (OLED_cmdbuffer[i2c_queue_head].addr == (i2c_devaddr >> 1)))
+		return false;
+	OLED_i2c_txn txn = {
+		.prefix = _i2c_cmd_dataprefix,
+		.data = i2c_data_ptr,
+		.data_gen = NULL,
+		.data_len = i2c_data_rowlen,
+		.rows = i2c_data_rows,
+		.skip = i2c_data_skip,
+		.prefix_len = OLED_ARR_SIZE(_i2c_cmd_dataprefix),
+		.addr = i2c_devaddr >> 1,
+		.is_fastfail = i2c_txn.is_fastfail,
+		.end_cbk = i2c_callback,
+		.cbk_args = i2c_callback_args
+	};
+	I2C_txn_put(&txn);
+	/* What is left of the transaction ends with this row */
+	i2c_txn.rows -= i2c_data_rows;
+	i2c_txn.end_cbk = NULL;
+	i2c_callback = NULL;
+	return true;
+}
+
+
+bool OLED_i2c_tx_shed(uint8_t addr, uint8_t *prefix, uint8_t prefix_len, uint8_t *bytes, uint16_t bytes_len, 
+		      void (*end_cbk)(void *), void *cbk_args, bool fastfail)
+{
+	return I2C_tx_shed_rows(addr, prefix, prefix_len, bytes, bytes_len, 1, bytes_len,
+				end_cbk, cbk_args, fastfail);
+}
+
+
+/***** Transports. They take transactions from the queue one by one *****/
+#if defined(OLED_STATS)
+/* Start and end of ISR, which cycles are counted */
+static inline ALWAYSINLINE uint16_t I2C_isr_enter(void)
+{
+	uint16_t start = OLED_STATS_TCNT;
+	OLED_stats_clock_();
+	return start;
+}
+
 
-static void I2C_init(uint32_t hz_freq)
+static inline ALWAYSINLINE void I2C_isr_leave(uint16_t start)
 {
+	uint16_t cycles = OLED_STATS_TCNT - start;
+	stat_isr_cycles += cycles;
+	if (cycles > stat_isr_cycles_max)
+		stat_isr_cycles_max = cycles;
+}
+#endif
+
+
+#if !defined(OLED_SPI)
+/* TWI. Address is the 7-bit slave address */
+/* Bus is shared by all displays, so it is only set up by the first OLED_init.
+ * Resetting it later would drop transactions of displays already running
+ */
+static void OLED_bus_init_(uint32_t hz_freq, uint8_t addr)
+{
+	(void)addr;	/* Only SPI selects display by it */
+	if (TWCR & (1 << TWEN))
+		return;
 	i2c_state = I2C_STATE_IDLE;
+	i2c_queue_head = 0;
+	i2c_queue_len = 0;
 	/* Enable the Two Wire Interface module */
 	power_twi_enable();
 
@@ -96,47 +430,224 @@ static void I2C_init(uint32_t hz_freq)
 }
 
 
-bool OLED_i2c_tx_shed(uint8_t addr, uint8_t *prefix, uint8_t prefix_len, uint8_t *bytes, uint16_t bytes_len, 
-		      void (*end_cbk)(void *), void *cbk_args, bool fastfail)
+static void OLED_bus_start_(void)
 {
-	bool ret = false;
-	/* No interrupts can occur while this block is executed */
+	/* Send START signal and initiating new transaction */
+	TWCR |= (1 << TWSTA) | (1 << TWINT);
+}
+
+
+/* TWSR status codes of master transmitter */
+#define I2C_ST_START		0x08
+#define I2C_ST_RESTART		0x10
+#define I2C_ST_SLA_ACK		0x18
+#define I2C_ST_SLA_NACK		0x20
+#define I2C_ST_DATA_ACK		0x28
+#define I2C_ST_DATA_NACK	0x30
+#define I2C_ST_ARB_LOST		0x38
+
+static OLED_i2c_errors i2c_errors;
+static volatile uint16_t i2c_watchdog;	/* Spins since the last TWI interrupt */
+static volatile bool i2c_is_recovering;	/* Watchdog is clocking the bus out  */
+OLED_FASTISRWRAP(
+	static uint8_t i2c_watchdog_len;	/* i2c_fast_len seen by watchdog */
+)
+
+/* CPU cycles from TWINT set till ISR clears it, while SCL is held low. Fast
+ * path is counted from its listing below. C path is an estimate for -Os:
+ * prologue saving 15 registers for calls through pointers and the body up
+ * to TWCR write. It is 18 cycles longer behind fast path check. Host build
+ * reports them to simulator, which stretches the bus as much
+ */
+#define I2C_ISR_CYCLES_FAST	39
+#define I2C_ISR_CYCLES_SLOW	90
+#if defined(__AVR__)
+#define I2C_isr_cycles_(cycles)
+#else
+#define I2C_isr_cycles_(cycles) sim_isr_cycles(cycles)
+#endif
+
+
+/* Transaction can be sent again from the start. Generated data can't be
+ * produced again, and data with no commands in front of it would go to
+ * wherever GDDRAM pointer was left
+ */
+static inline ALWAYSINLINE bool I2C_txn_is_repeatable(void)
+{
+	return !i2c_txn.is_fastfail && (NULL == i2c_txn.data_gen)
+	       && ((NULL == i2c_txn.prefix) || !(i2c_txn.prefix[0] & 0x40));
+}
+
+
+/* Gives up on transaction on the bus. Its end callback is still called, so
+ * refresh goes on and releases lock in the end. Next transaction is started
+ * with twcr, which must have TWEN, TWIE and TWINT set
+ */
+static void I2C_txn_drop(uint8_t twcr)
+{
+	i2c_errors.drops++;
+	i2c_dropped[i2c_txn.addr / 8] |= 1 << (i2c_txn.addr % 8);
+	/* Generator keeps its place in data, which the next transaction */
+	/* goes on from. So bytes left unsent are produced and thrown away */
+	if (NULL != i2c_data_gen) {
+		for (; i2c_data_count; i2c_data_count--)
+			(*i2c_data_gen)(i2c_callback_args);
+	}
+	if (NULL != i2c_callback) {
+		i2c_is_cbk = true;
+		(*i2c_callback)(i2c_callback_args);
+		i2c_is_cbk = false;
+	}
+	if (i2c_queue_len) {
+		I2C_txn_load();
+		twcr |= (1 << TWSTA);
+	} else {
+		i2c_state = I2C_STATE_IDLE;
+	}
+	TWCR = twcr;
+}
+
+
+/* Transaction on the bus got unexpected status. It is sent again from the
+ * start, at most OLED_I2C_RETRIES times, or dropped
+ */
+static void I2C_txn_fail(uint8_t status)
+{
+	if ((I2C_ST_SLA_NACK == status) || (I2C_ST_DATA_NACK == status))
+		i2c_errors.nacks++;
+	else if (I2C_ST_ARB_LOST == status)
+		i2c_errors.arb_lost++;
+	else
+		i2c_errors.bus_errors++;
+	/* Bus is released when arbitration is lost, START is sent as soon */
+	/* as it gets free. Otherwise it is released with STOP first	    */
+	uint8_t twcr = (1 << TWEN) | (1 << TWIE) | (1 << TWINT);
+	if (I2C_ST_ARB_LOST != status)
+		twcr |= (1 << TWSTO);
+	if (!I2C_txn_is_repeatable() || (i2c_retries >= OLED_I2C_RETRIES)) {
+		I2C_txn_drop(twcr);
+		return;
+	}
+	i2c_retries++;
+	i2c_errors.retries++;
+	I2C_txn_begin();
+	TWCR = twcr | (1 << TWSTA);
+}
+
+
+/* Frees SDA held low by a slave stuck in the middle of a byte: clocks SCL
+ * till the slave lets SDA go (9 times at most), then makes STOP. Pins are
+ * driven as open drain, low by setting DDR bit, and their pull-ups are put
+ * back afterwards. TWI must be disabled and is left so
+ */
+static void I2C_bus_recover(void)
+{
+	uint8_t scl = (1 << OLED_TWI_SCL_BIT);
+	uint8_t sda = (1 << OLED_TWI_SDA_BIT);
+	uint8_t pullups = OLED_TWI_PORT & (scl | sda);
+	OLED_TWI_PORT &= ~(scl | sda);
+	for (uint8_t i = 0; (i < 9) && !(OLED_TWI_PIN & sda); i++) {
+		OLED_TWI_DDR |= scl;
+		_delay_us(5);
+		OLED_TWI_DDR &= ~scl;
+		_delay_us(5);
+	}
+	/* STOP: SDA rises while SCL is high */
+	OLED_TWI_DDR |= sda;
+	_delay_us(5);
+	OLED_TWI_DDR &= ~sda;
+	_delay_us(5);
+	OLED_TWI_PORT |= pullups;
+}
+
+
+void OLED_i2c_watchdog(void)
+{
+	bool is_hung = false;
 	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-		if (i2c_state == I2C_STATE_IDLE) {
-			i2c_prefix_ptr = prefix;
-			i2c_prefix_count = prefix_len;
-			i2c_data_ptr = bytes;
-			i2c_data_count = bytes_len;
-			i2c_is_fastfail = fastfail;
-			i2c_callback = end_cbk;
-			i2c_callback_args = cbk_args;
-			/* Send START signal and initiating new transaction */
-			i2c_state = I2C_STATE_SLAVEADDR;
-			i2c_devaddr = (addr << 1);
-			TWCR |= (1 << TWSTA) | (1 << TWINT);
-			ret = true;
+#if defined(OLED_TWI_FASTISR)
+		/* Fast path of ISR does not reset watchdog, but moves the run */
+		if (i2c_fast_len != i2c_watchdog_len) {
+			i2c_watchdog_len = i2c_fast_len;
+			i2c_watchdog = 0;
+		}
+#endif
+		if (!i2c_is_recovering && (I2C_STATE_IDLE != i2c_state)
+		    && (++i2c_watchdog >= OLED_I2C_WATCHDOG_SPINS)) {
+			i2c_watchdog = 0;
+			i2c_errors.timeouts++;
+			/* Disabled TWI makes no interrupts, and transaction stays */
+			/* on the bus till it is dropped, so nothing else starts   */
+			TWCR = 0;
+			i2c_is_recovering = true;
+			is_hung = true;
 		}
 	}
-	return ret;
+	if (!is_hung)
+		return;
+	/* About 100 us of clocking is done with interrupts as caller has them */
+	I2C_bus_recover();
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		I2C_txn_drop((1 << TWEN) | (1 << TWIE) | (1 << TWINT));
+		i2c_is_recovering = false;
+	}
 }
 
 
-ISR(TWI_vect, ISR_BLOCK)
+void OLED_i2c_errors_snapshot(OLED_i2c_errors *errors, bool reset)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		*errors = i2c_errors;
+		if (reset)
+			memset(&i2c_errors, 0, sizeof i2c_errors);
+	}
+}
+
+
+static inline ALWAYSINLINE void I2C_isr_body(void)
 {
+	i2c_watchdog = 0;
+	if (I2C_STATE_IDLE != i2c_state) {
+		/* START is expected before address, ACK of previous byte after */
+		uint8_t status = TWSR & 0xF8;
+		bool is_ok;
+		if (I2C_STATE_SLAVEADDR == i2c_state)
+			is_ok = (I2C_ST_START == status) || (I2C_ST_RESTART == status);
+		else
+			is_ok = (I2C_ST_SLA_ACK == status) || (I2C_ST_DATA_ACK == status);
+		if (!is_ok) {
+			I2C_txn_fail(status);
+			return;
+		}
+	}
+
 	switch(i2c_state) {
 	case(I2C_STATE_IDLE):
 	case(I2C_STATE_STOP):
-		/* transfer stop and go to IDLE*/
-		/* signal with callback that transaction is over */
-		TWCR |= (1 << TWSTO) | (1 << TWINT);
-		i2c_state = I2C_STATE_IDLE;
-		(*i2c_callback)(i2c_callback_args);
+		/* signal with callback that transaction is over. It is done */
+		/* before releasing the bus, so callback could chain the next */
+		OLED_STATSWRAP(stat_txns++;)
+		if (NULL != i2c_callback) {
+			i2c_is_cbk = true;
+			(*i2c_callback)(i2c_callback_args);
+			i2c_is_cbk = false;
+		}
+		if (i2c_queue_len) {
+			/* Go straight to the next transaction with repeated START */
+			I2C_txn_load();
+			TWCR = (TWCR & ~(1 << TWSTO)) | (1 << TWSTA) | (1 << TWINT);
+		} else {
+			/* transfer stop and go to IDLE*/
+			TWCR |= (1 << TWSTO) | (1 << TWINT);
+			i2c_state = I2C_STATE_IDLE;
+		}
 		break;
 	case(I2C_STATE_SLAVEADDR):
 		// load value
 		TWDR = i2c_devaddr;
+		OLED_STATSWRAP(stat_bytes++;)
 		TWCR = (TWCR & ~(1 << TWSTA)) | (1 << TWINT);
-		if ((NULL == i2c_prefix_ptr) && (NULL == i2c_data_ptr)) {
+		if ((NULL == i2c_prefix_ptr) && (NULL == i2c_data_ptr) && (NULL == i2c_data_gen)) {
 			i2c_state = I2C_STATE_STOP;
 		} else if (NULL == i2c_prefix_ptr) {
 			i2c_state = I2C_STATE_WRITEBYTE;
@@ -147,189 +658,2939 @@ ISR(TWI_vect, ISR_BLOCK)
 	case(I2C_STATE_WRITEPREFIX):
 		// load next byte of prefix
 		TWDR = *i2c_prefix_ptr++;
+		OLED_STATSWRAP(stat_bytes++;)
 		i2c_prefix_count--;
 		TWCR |= (1 << TWINT);
 		if (!i2c_prefix_count) {
-			i2c_state = (NULL == i2c_data_ptr) ? I2C_STATE_STOP : I2C_STATE_WRITEBYTE;
+			bool is_data = (NULL != i2c_data_ptr) || (NULL != i2c_data_gen);
+			i2c_state = is_data ? I2C_STATE_WRITEBYTE : I2C_STATE_STOP;
 		}
 		break;
 	case(I2C_STATE_WRITEBYTE):
-		// load next byte
-		TWDR = *i2c_data_ptr++;
+		// load next byte, from generator if there is one
+		if (NULL != i2c_data_gen)
+			TWDR = (*i2c_data_gen)(i2c_callback_args);
+		else
+			TWDR = *i2c_data_ptr++;
+		OLED_STATSWRAP(stat_bytes++;)
 		i2c_data_count--;
 		TWCR |= (1 << TWINT);
-		if (!i2c_data_count)
-			i2c_state = I2C_STATE_STOP;
+#if defined(OLED_TWI_FASTISR)
+		/* Bytes of row but the last are left to fast path */
+		if ((NULL == i2c_data_gen) && (i2c_data_count > 1)) {
+			uint8_t run = (i2c_data_count > 256) ? 255 : i2c_data_count - 1;
+			i2c_fast_len = run;
+			i2c_data_count -= run;
+			OLED_STATSWRAP(stat_bytes += run;)
+		}
+#endif
+		if (!i2c_data_count) {
+			if (--i2c_data_rows) {
+				/* Jump to the next row of window */
+				i2c_data_ptr += i2c_data_skip;
+				i2c_data_count = i2c_data_rowlen;
+				if (I2C_txn_yield())
+					i2c_state = I2C_STATE_STOP;
+			} else {
+				i2c_state = I2C_STATE_STOP;
+			}
+		}
 		break;
 	}
 }
 
 
-/* Callback which essentially does nothing */
-static void OLED_cbk_empty(void *args)
+#if !defined(OLED_TWI_FASTISR)
+ISR(TWI_vect, ISR_BLOCK)
 {
-	// empty callback
+	I2C_isr_cycles_(I2C_ISR_CYCLES_SLOW);
+	OLED_STATSWRAP(uint16_t start = I2C_isr_enter();)
+	I2C_isr_body();
+	OLED_STATSWRAP(I2C_isr_leave(start);)
+}
+#else
+/* Fast path streams data bytes of a row, while the rest is done by C ISR.
+ * It saves 3 registers instead of 15 and keeps run length in 8 bits. Status
+ * is checked as usual, anything but data ACK goes to C ISR. Since the same
+ * SCL stretch is 39 cycles instead of about 90, 1 MHz TWI moves a byte per
+ * 144 + 39 cycles at 16 MHz. Statistics only count time of C ISR
+ */
+#if defined(__AVR__)
+/* C ISR is a handler with no vector, fast path jumps to it. Name must start */
+/* with __vector for gcc to accept it as signal handler			     */
+void __vector_OLED_twi_slow(void) __attribute__((signal, used, externally_visible));
+void __vector_OLED_twi_slow(void)
+{
+	OLED_STATSWRAP(uint16_t start = I2C_isr_enter();)
+	I2C_isr_body();
+	OLED_STATSWRAP(I2C_isr_leave(start);)
 }
 
 
-/* A dummy callback which simply unlocks the oled lock */
-static void OLED_cbk_unlock(void *args)
+/* Cycles, counting 7 of interrupt response and vector jump, are on the right.
+ * SCL is released by TWCR write at 39, reti is done at 56
+ */
+ISR(TWI_vect, ISR_NAKED)
 {
-	OLED *oled = args;
-	OLED_unlock(oled);
+	asm volatile(
+		"push r30			\n\t"	/*  9 */
+		"in r30, __SREG__		\n\t"	/* 10 */
+		"push r30			\n\t"	/* 12 */
+		"lds r30, %[len]		\n\t"	/* 14 */
+		"subi r30, 1			\n\t"	/* 15 carry if run is over */
+		"brcs 1f			\n\t"	/* 16 */
+		"push r31			\n\t"	/* 18 */
+		"lds r31, %[twsr]		\n\t"	/* 20 */
+		"andi r31, 0xF8			\n\t"	/* 21 */
+		"cpi r31, %[ack]		\n\t"	/* 22 */
+		"brne 2f			\n\t"	/* 23 */
+		"sts %[len], r30		\n\t"	/* 25 */
+		"push r0			\n\t"	/* 27 */
+		"lds r30, %[ptr]		\n\t"	/* 29 */
+		"lds r31, %[ptr]+1		\n\t"	/* 31 */
+		"ld r0, Z+			\n\t"	/* 33 */
+		"sts %[twdr], r0		\n\t"	/* 35 */
+		"lds r0, %[twcr]		\n\t"	/* 37 TWINT reads as 1 */
+		"sts %[twcr], r0		\n\t"	/* 39 and clears itself */
+		"sts %[ptr], r30		\n\t"	/* 41 */
+		"sts %[ptr]+1, r31		\n\t"	/* 43 */
+		"pop r0				\n\t"	/* 45 */
+		"pop r31			\n\t"	/* 47 */
+		"pop r30			\n\t"	/* 49 */
+		"out __SREG__, r30		\n\t"	/* 50 */
+		"pop r30			\n\t"	/* 52 */
+		"reti				\n\t"	/* 56 */
+	"2:	 pop r31			\n\t"
+	"1:	 pop r30			\n\t"
+		"out __SREG__, r30		\n\t"
+		"pop r30			\n\t"
+		"%~jmp __vector_OLED_twi_slow	\n\t" ::
+		[len] "i" (&i2c_fast_len),
+		[ptr] "i" (&i2c_data_ptr),
+		[twsr] "n" (_SFR_MEM_ADDR(TWSR)),
+		[twdr] "n" (_SFR_MEM_ADDR(TWDR)),
+		[twcr] "n" (_SFR_MEM_ADDR(TWCR)),
+		[ack] "M" (I2C_ST_DATA_ACK)
+	);
+}
+#else
+/* Host build runs the same fast path written in C */
+ISR(TWI_vect, ISR_NAKED)
+{
+	if (i2c_fast_len && (I2C_ST_DATA_ACK == (TWSR & 0xF8))) {
+		I2C_isr_cycles_(I2C_ISR_CYCLES_FAST);
+		i2c_fast_len--;
+		TWDR = *i2c_data_ptr++;
+		TWCR |= (1 << TWINT);
+		return;
+	}
+	I2C_isr_cycles_(I2C_ISR_CYCLES_SLOW + 18);
+	I2C_isr_body();
 }
+#endif
+#endif
+#else
+/* SPI. Address is the number of display CS pin in OLED_SPI_CS_PORT.
+ * Transactions are the same as for TWI, so their prefixes hold I2C control
+ * bytes. Those are not sent: like SSD1306 does on I2C, they are decoded to
+ * D/C level of the byte following (Co set) or of all the rest (Co clear)
+ */
+static bool spi_is_ctrl;	/* Next byte of transaction is control byte   */
+static bool spi_is_single;	/* Control byte applies to a single byte      */
+static bool spi_is_data;	/* D/C level of bytes being decoded	      */
+static bool spi_dc;		/* D/C pin level			      */
+#if defined(OLED_SPI_USART)
+static bool spi_is_pending;	/* spi_pending waits for D/C to be switched   */
+static uint8_t spi_pending;
+#endif
 
 
-/* Callbacks which are used to write each page */
-static void OLED_cbk_writepage(void *args);
-static void OLED_cbk_setwritepage(void *args);
-/* Writes page. This is called after OLED_cbk_setwritepage */
-static void OLED_cbk_writepage(void *args)
+static void OLED_bus_init_(uint32_t hz_freq, uint8_t addr)
 {
-	OLED *oled = args;
-	if (oled->cur_page >= oled->num_pages) {
-		OLED_unlock(oled);
+	/* Display is not selected until its transaction */
+	OLED_SPI_CS_PORT |= (1 << addr);
+	OLED_SPI_CS_DDR |= (1 << addr);
+#if defined(OLED_SPI_USART)
+	if (UCSR0B & (1 << TXEN0))
 		return;
-	}
-	uint8_t *lineptr = &oled->frame_buffer[oled->cur_page * (uint16_t)oled->width];
-	oled->cur_page++;
-	while(!OLED_i2c_tx_shed(oled->i2c_addr, _i2c_cmd_dataprefix, OLED_ARR_SIZE(_i2c_cmd_dataprefix), 
-				lineptr, oled->width,
-				&OLED_cbk_setwritepage, oled, true)) {
-		// nop
-	}
+#else
+	if (SPCR & (1 << SPE))
+		return;
+#endif
+	i2c_state = I2C_STATE_IDLE;
+	i2c_queue_head = 0;
+	i2c_queue_len = 0;
+	OLED_SPI_DC_DDR |= (1 << OLED_SPI_DC_BIT);
+
+#if defined(OLED_SPI_USART)
+	/* Master SPI mode 0, MSB first. Baud rate is F_CPU / (2 * (UBRR0 + 1)) */
+	/* and must be set after transmitter is enabled			     */
+	power_usart0_enable();
+	UBRR0 = 0;
+	DDRD |= (1 << DDD4) | (1 << DDD1);	/* XCK0 and TXD0 */
+	UCSR0C = (1 << UMSEL01) | (1 << UMSEL00);
+	UCSR0B = (1 << TXEN0);
+	UBRR0 = (hz_freq >= F_CPU / 2) ? 0 : (F_CPU / 2 + hz_freq - 1) / hz_freq - 1;
+#else
+	/* Divider is a power of 2, the smallest one giving at most hz_freq. */
+	/* SPR selects 4, 16, 64 or 128 and SPI2X halves first three, not  */
+	/* the last one, which is the only choice for 128		      */
+	power_spi_enable();
+	uint8_t div_log = 1;
+	while ((div_log < 7) && ((F_CPU >> div_log) > hz_freq))
+		div_log++;
+	uint8_t spr = (div_log == 7) ? 3 : (div_log - 1) / 2;
+	/* SS must be output, otherwise SPI may fall back to slave mode */
+	DDRB |= (1 << DDB2) | (1 << DDB3) | (1 << DDB5);	/* SS, MOSI, SCK */
+	SPCR = (1 << SPIE) | (1 << SPE) | (1 << MSTR) | spr;
+	SPSR = ((div_log & 1) && (div_log < 7)) ? (1 << SPI2X) : 0;
+#endif
 }
 
-/* Sets page index and calls OLED_cbk_writepage via callback */
-static void OLED_cbk_setwritepage(void *args)
+
+/* Returns next byte of transaction as it is, false after the last one */
+static inline ALWAYSINLINE bool SPI_next_raw(uint8_t *byte)
 {
-	OLED *oled = args;
-	_i2c_cmd_setpage[OLED_ARR_SIZE(_i2c_cmd_setpage) - 1] = 0xB0 | oled->cur_page;
-	while(!OLED_i2c_tx_shed(oled->i2c_addr, _i2c_cmd_setpage, 
-                                OLED_ARR_SIZE(_i2c_cmd_setpage), NULL, 0,
-				&OLED_cbk_writepage, oled, true)) {
-		// nop
+	switch(i2c_state) {
+	case(I2C_STATE_WRITEPREFIX):
+		*byte = *i2c_prefix_ptr++;
+		if (!--i2c_prefix_count) {
+			bool is_data = (NULL != i2c_data_ptr) || (NULL != i2c_data_gen);
+			i2c_state = is_data ? I2C_STATE_WRITEBYTE : I2C_STATE_STOP;
+		}
+		return true;
+	case(I2C_STATE_WRITEBYTE):
+		if (NULL != i2c_data_gen)
+			*byte = (*i2c_data_gen)(i2c_callback_args);
+		else
+			*byte = *i2c_data_ptr++;
+		if (!--i2c_data_count) {
+			if (--i2c_data_rows) {
+				i2c_data_ptr += i2c_data_skip;
+				i2c_data_count = i2c_data_rowlen;
+				if (I2C_txn_yield())
+					i2c_state = I2C_STATE_STOP;
+			} else {
+				i2c_state = I2C_STATE_STOP;
+			}
+		}
+		return true;
+	default:
+		return false;
 	}
 }
 
 
+/* Returns next byte to be sent, skipping control bytes. spi_is_data is its
+ * D/C level then. Returns false after the last one
+ */
+static bool SPI_next_byte(uint8_t *byte)
+{
+	while (SPI_next_raw(byte)) {
+		if (!spi_is_ctrl) {
+			spi_is_ctrl = spi_is_single;
+			return true;
+		}
+		spi_is_single = (*byte & 0x80) != 0;
+		spi_is_data = (*byte & 0x40) != 0;
+		spi_is_ctrl = false;
+	}
+	return false;
+}
+
 
-void OLED_cmd_setbrightness(OLED *oled, uint8_t level)
+/* Sends byte, shift register must be empty */
+static inline ALWAYSINLINE void SPI_send(uint8_t byte)
 {
-	_i2c_cmd_setbrightness[OLED_ARR_SIZE(_i2c_cmd_setbrightness) - 1] = level;
-	OLED_spinlock(oled);
-	while(!OLED_i2c_tx_shed(oled->i2c_addr, _i2c_cmd_setbrightness, 
-                                OLED_ARR_SIZE(_i2c_cmd_setbrightness), NULL, 0,
-				&OLED_cbk_unlock, oled, true)) {
-		// nop
+	if (spi_is_data != spi_dc) {
+		spi_dc = spi_is_data;
+		if (spi_dc)
+			OLED_SPI_DC_PORT |= (1 << OLED_SPI_DC_BIT);
+		else
+			OLED_SPI_DC_PORT &= ~(1 << OLED_SPI_DC_BIT);
 	}
+	OLED_STATSWRAP(stat_bytes++;)
+#if defined(OLED_SPI_USART)
+	UDR0 = byte;
+	/* TXC is set when this one is out and none follows. Cleared by 1 */
+	UCSR0A |= (1 << TXC0);
+	UCSR0B = (UCSR0B & ~(1 << TXCIE0)) | (1 << UDRIE0);
+#else
+	SPDR = byte;
+#endif
 }
 
 
-void OLED_refresh(OLED *oled)
+/* Called when nothing is being shifted out. Sends the next byte, switching
+ * D/C as needed, or ends transaction and begins the next one
+ */
+static void SPI_isr_idle(void)
 {
-	OLED_spinlock(oled);
-	/* Code below is executed under lock */
-	oled->cur_page = 0;
-	OLED_cbk_setwritepage(oled);
-	/* Lock is unlocked after series of callbacks, in the last one */
+#if defined(OLED_SPI_USART)
+	if (spi_is_pending) {
+		spi_is_pending = false;
+		SPI_send(spi_pending);
+		return;
+	}
+#endif
+	uint8_t byte;
+	for (;;) {
+		switch(i2c_state) {
+		case(I2C_STATE_IDLE):
+			return;
+		case(I2C_STATE_STOP):
+			OLED_SPI_CS_PORT |= (1 << (i2c_devaddr >> 1));
+			OLED_STATSWRAP(stat_txns++;)
+			if (NULL != i2c_callback) {
+				i2c_is_cbk = true;
+				(*i2c_callback)(i2c_callback_args);
+				i2c_is_cbk = false;
+			}
+			if (i2c_queue_len) {
+				I2C_txn_load();
+			} else {
+				i2c_state = I2C_STATE_IDLE;
+#if defined(OLED_SPI_USART)
+				UCSR0B &= ~((1 << TXCIE0) | (1 << UDRIE0));
+#endif
+				return;
+			}
+			break;
+		case(I2C_STATE_SLAVEADDR):
+			OLED_SPI_CS_PORT &= ~(1 << (i2c_devaddr >> 1));
+			spi_is_ctrl = true;
+			if (NULL != i2c_prefix_ptr)
+				i2c_state = I2C_STATE_WRITEPREFIX;
+			else if ((NULL != i2c_data_ptr) || (NULL != i2c_data_gen))
+				i2c_state = I2C_STATE_WRITEBYTE;
+			else
+				i2c_state = I2C_STATE_STOP;
+			break;
+		default:
+			/* Turns to STOP when no bytes left */
+			if (SPI_next_byte(&byte)) {
+				SPI_send(byte);
+				return;
+			}
+			break;
+		}
+	}
 }
-#endif // OLED_NO_I2C
 
 
-/***** Display-related logic *****/
-OLED_err __OLED_init(OLED *oled, uint8_t width, uint8_t height, uint8_t *frame_buffer, uint32_t i2c_freq_hz, uint8_t i2c_addr)
+static void OLED_bus_start_(void)
 {
-	oled->width = width;
-	oled->height = height;
-	oled->frame_buffer = frame_buffer;
-	oled->busy_lock = 1;	/* Initially: 1 - unlocked */
+	SPI_isr_idle();
+}
 
-	OLED_I2CWRAP(
-		oled->i2c_addr = i2c_addr;
-		oled->cur_page = 0;
-		oled->num_pages = 8;
 
-		I2C_init(i2c_freq_hz);
-		
-		if (!OLED_i2c_tx_shed(oled->i2c_addr, _i2c_cmd_init, OLED_ARR_SIZE(_i2c_cmd_init),
-				      NULL, 0, OLED_cbk_empty, NULL, true)) {
-			return OLED_EBUSY;
+#if defined(OLED_SPI_USART)
+/* Transmit buffer is empty, while the previous byte may still be shifted
+ * out. D/C, CS and the end of transaction have to wait till it is, so only
+ * bytes of the same D/C level are sent from here
+ */
+static void SPI_isr_udre(void)
+{
+	uint8_t byte;
+	if (((I2C_STATE_WRITEPREFIX == i2c_state) || (I2C_STATE_WRITEBYTE == i2c_state)) &&
+	    SPI_next_byte(&byte)) {
+		if (spi_is_data == spi_dc) {
+			OLED_STATSWRAP(stat_bytes++;)
+			UDR0 = byte;
+			UCSR0A |= (1 << TXC0);
+			return;
 		}
-	) // OLED_I2CWRAP
+		spi_pending = byte;
+		spi_is_pending = true;
+	}
+	UCSR0B = (UCSR0B & ~(1 << UDRIE0)) | (1 << TXCIE0);
+}
 
-	return OLED_EOK;
+
+ISR(USART_UDRE_vect, ISR_BLOCK)
+{
+	OLED_STATSWRAP(uint16_t start = I2C_isr_enter();)
+	SPI_isr_udre();
+	OLED_STATSWRAP(I2C_isr_leave(start);)
 }
 
 
-OLED_err OLED_put_pixel(OLED *oled, uint8_t x, uint8_t y, bool pixel_state)
+ISR(USART_TX_vect, ISR_BLOCK)
 {
-	if ((x >= oled->width) || (y >= oled->height))
-		return OLED_EBOUNDS;
-	OLED_put_pixel_(oled, x, y, pixel_state);	/* Use inline */
-	return OLED_EOK;
+	OLED_STATSWRAP(uint16_t start = I2C_isr_enter();)
+	SPI_isr_idle();
+	OLED_STATSWRAP(I2C_isr_leave(start);)
+}
+#else
+ISR(SPI_STC_vect, ISR_BLOCK)
+{
+	OLED_STATSWRAP(uint16_t start = I2C_isr_enter();)
+	SPI_isr_idle();
+	OLED_STATSWRAP(I2C_isr_leave(start);)
 }
+#endif
+#endif // OLED_SPI
 
 
-OLED_err OLED_put_rectangle(OLED *oled, uint8_t x_from, uint8_t y_from, uint8_t x_to, uint8_t y_to, enum OLED_params params)
+/* Callback which essentially does nothing */
+static void OLED_cbk_empty(void *args)
 {
-	if (params > (OLED_BLACK | OLED_FILL))
-		return OLED_EPARAMS;
-	bool pixel_color = (OLED_BLACK & params) != 0;
-	bool is_fill = (OLED_FILL & params) != 0;
+	(void)args;	// empty callback
+}
 
-	/* Limit coordinates to display bounds */
-	uint8_t size_errors = 0;
-	uint8_t w_max = oled->width - 1;
-	uint8_t h_max = oled->height - 1;
-	if (x_from > w_max) {
-		x_from = w_max;
-		size_errors++;
-	}
-	if (x_to > w_max) {
-		x_to = w_max;
-		size_errors++;
-	}
-	if (y_from > h_max) {
-		y_from = h_max;
-		size_errors++;
+
+/* Buffer the refresh is sent from. Double buffered OLED sends front buffer */
+static inline uint8_t *OLED_txbuf_(OLED *oled)
+{
+	return (NULL != oled->front_buffer) ? oled->front_buffer : oled->frame_buffer;
+}
+
+
+/* Takes spans [from..to] of each page to be sent by refresh, leaving them
+ * clean, and starts counting it
+ */
+static void OLED_take_spans_(OLED *oled, uint8_t *from, uint8_t *to)
+{
+	for (uint8_t page = 0; page < oled->num_pages; page++) {
+		oled->tx_from[page] = from[page];
+		oled->tx_to[page] = to[page];
+		from[page] = 0xFF;
+		to[page] = 0;
 	}
-	if (y_to > h_max) {
+	oled->cur_page = 0;
+	oled->refresh_bytes = 0;
+	oled->refresh_cbk = NULL;
+	OLED_STATSWRAP(
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			oled->stat_refresh_start = OLED_stats_clock_();
+		}
+	)
+}
+
+
+static void OLED_refresh_send_(OLED *oled);
+
+/* Takes spans which OLED_refresh_async left pending while display was
+ * locked, with their callback. Must be called under lock
+ */
+static void OLED_take_pending_(OLED *oled)
+{
+	oled->is_refresh_pending = false;
+	/* Pending spans go without checksums, which are then stale */
+	for (uint8_t page = 0; page < oled->num_pages; page++) {
+		if (oled->pending_from[page] <= oled->pending_to[page])
+			oled->sum_stale |= 1 << page;
+	}
+	OLED_take_spans_(oled, oled->pending_from, oled->pending_to);
+	oled->refresh_cbk = oled->pending_cbk;
+	oled->refresh_cbk_args = oled->pending_cbk_args;
+}
+
+
+/* Called in the end of refresh. Single buffered OLED holds busy lock during
+ * the whole refresh, double buffered holds only tx_lock. Refresh requested
+ * by OLED_refresh_async while this one was on the bus starts right here,
+ * under the same lock
+ */
+static void OLED_refresh_done_(OLED *oled)
+{
+	OLED_STATSWRAP(
+		oled->stat_frames++;
+		/* Refresh with nothing to send ends outside of ISR */
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			oled->stat_refresh_cycles = OLED_stats_clock_() - oled->stat_refresh_start;
+		}
+	)
+	void (*cbk)(void *) = oled->refresh_cbk;
+	void *cbk_args = oled->refresh_cbk_args;
+	if (oled->is_refresh_pending) {
+		OLED_take_pending_(oled);
+		if (NULL != cbk)
+			(*cbk)(cbk_args);
+		OLED_refresh_send_(oled);
+		return;
+	}
+	if (NULL != oled->front_buffer)
+		oled->tx_lock = 1;
+	else
+		OLED_unlock(oled);
+	if (NULL != cbk)
+		(*cbk)(cbk_args);
+}
+
+
+static void OLED_cbk_refresh_done(void *args)
+{
+	OLED_refresh_done_(args);
+}
+
+
+/* Fills cmd with commands setting cursor to column col of page */
+static void OLED_setpage_(OLED *oled, uint8_t *cmd, uint8_t col, uint8_t page)
+{
+	col += oled->col_offset;
+	memcpy(cmd, _i2c_cmd_setpage, OLED_ARR_SIZE(_i2c_cmd_setpage));
+	cmd[1] = 0x00 | (col & 0x0F);
+	cmd[3] = 0x10 | (col >> 4);
+	cmd[5] = 0xB0 | page;
+}
+
+
+/* Bus bytes spent on each window besides data: START, address, window  */
+/* commands with data prefix and STOP					 */
+#define OLED_WINDOW_OVERHEAD (3 + OLED_ARR_SIZE(_i2c_cmd_setwindow))
+
+/* Fills cmd with window commands for columns [col_from..col_to], pages */
+/* [page_from..page_to], followed by data prefix			 */
+static void OLED_setwindow_(OLED *oled, uint8_t *cmd, uint8_t col_from, uint8_t col_to,
+			    uint8_t page_from, uint8_t page_to)
+{
+	memcpy(cmd, _i2c_cmd_setwindow, OLED_ARR_SIZE(_i2c_cmd_setwindow));
+	cmd[3] = col_from + oled->col_offset;
+	cmd[5] = col_to + oled->col_offset;
+	cmd[9] = page_from;
+	cmd[11] = page_to;
+}
+
+
+/* Fills prefix with commands which make data of the same transaction go to
+ * ncols columns of page, starting at col. Returns prefix length
+ */
+static uint8_t OLED_setspan_(OLED *oled, uint8_t *prefix, uint8_t col, uint8_t ncols, uint8_t page)
+{
+	if (oled->opts & OLED_OPT_HORIZADDR) {
+		OLED_setwindow_(oled, prefix, col, col + ncols - 1, page, page);
+		return OLED_ARR_SIZE(_i2c_cmd_setwindow);
+	}
+	/* Page cursor commands, then data in the same transaction */
+	OLED_setpage_(oled, prefix, col, page);
+	prefix[OLED_ARR_SIZE(_i2c_cmd_setpage)] = 0x40;
+	return OLED_ARR_SIZE(_i2c_cmd_setpage) + 1;
+}
+
+
+/* Page addressing mode. Finds next page to be sent and sends its span, with
+ * cursor commands in front of data, so the page goes in one transaction
+ * which may be repeated as a whole. Calls itself via callback until no
+ * pages left
+ */
+static void OLED_cbk_setwritepage(void *args)
+{
+	OLED *oled = args;
+	uint8_t page = oled->cur_page;
+	while ((page < oled->num_pages) && (oled->tx_from[page] > oled->tx_to[page]))
+		page++;
+	if (page >= oled->num_pages) {
+		OLED_refresh_done_(oled);
+		return;
+	}
+
+	uint8_t col = oled->tx_from[page];
+	uint8_t ncols = oled->tx_to[page] - col + 1;
+	oled->cur_page = page + 1;
+	oled->refresh_bytes += ncols;
+
+	uint8_t prefix_len = OLED_setspan_(oled, oled->cmd, col, ncols, page);
+	while(!OLED_i2c_tx_shed(oled->i2c_addr, oled->cmd, prefix_len,
+				&OLED_txbuf_(oled)[page * (uint16_t)OLED_WIDTH_(oled) + col], ncols,
+				&OLED_cbk_setwritepage, oled, false)) {
+		// nop
+	}
+}
+
+
+/* Horizontal addressing mode. Takes span of next page to be sent and sends
+ * it as a window of one page, commands and data in one transaction. Calls
+ * itself via callback until no pages left
+ */
+static void OLED_cbk_writewindow(void *args)
+{
+	OLED *oled = args;
+	uint8_t page = oled->cur_page;
+	while ((page < oled->num_pages) && (oled->tx_from[page] > oled->tx_to[page]))
+		page++;
+	if (page >= oled->num_pages) {
+		OLED_refresh_done_(oled);
+		return;
+	}
+
+	uint8_t col = oled->tx_from[page];
+	uint8_t ncols = oled->tx_to[page] - col + 1;
+	oled->cur_page = page + 1;
+	oled->refresh_bytes += ncols;
+
+	OLED_setwindow_(oled, oled->cmd, col, col + ncols - 1, page, page);
+	while(!OLED_i2c_tx_shed(oled->i2c_addr, oled->cmd, OLED_ARR_SIZE(_i2c_cmd_setwindow),
+				&OLED_txbuf_(oled)[page * (uint16_t)OLED_WIDTH_(oled) + col], ncols,
+				&OLED_cbk_writewindow, oled, false)) {
+		// nop
+	}
+}
+
+
+/* Horizontal addressing mode. Sends all spans at once as their bounding
+ * window if it is cheaper than a window per page
+ */
+static void OLED_refresh_window_(OLED *oled)
+{
+	uint8_t page_from = 0xFF, page_to = 0;
+	uint8_t col_from = 0xFF, col_to = 0;
+	uint16_t perpage_cost = 0;
+	for (uint8_t page = 0; page < oled->num_pages; page++) {
+		if (oled->tx_from[page] > oled->tx_to[page])
+			continue;
+		if (page < page_from)
+			page_from = page;
+		page_to = page;
+		if (oled->tx_from[page] < col_from)
+			col_from = oled->tx_from[page];
+		if (oled->tx_to[page] > col_to)
+			col_to = oled->tx_to[page];
+		perpage_cost += OLED_WINDOW_OVERHEAD + oled->tx_to[page] - oled->tx_from[page] + 1;
+	}
+	if (page_from > page_to) {
+		OLED_refresh_done_(oled);
+		return;
+	}
+
+	uint8_t ncols = col_to - col_from + 1;
+	uint8_t npages = page_to - page_from + 1;
+	uint16_t window_bytes = ncols * (uint16_t)npages;
+	if (OLED_WINDOW_OVERHEAD + window_bytes > perpage_cost) {
+		OLED_cbk_writewindow(oled);
+		return;
+	}
+	oled->refresh_bytes = window_bytes;
+
+	OLED_setwindow_(oled, oled->cmd, col_from, col_to, page_from, page_to);
+	uint8_t *start = &OLED_txbuf_(oled)[page_from * (uint16_t)OLED_WIDTH_(oled) + col_from];
+	/* Sent as a row per page, so other displays on the bus may go in between */
+	while(!I2C_tx_shed_rows(oled->i2c_addr, oled->cmd, OLED_ARR_SIZE(_i2c_cmd_setwindow),
+				start, ncols, npages, OLED_WIDTH_(oled),
+				&OLED_cbk_refresh_done, oled, false)) {
+		// nop
+	}
+}
+
+
+/* Banded rendering, see the end of file. Never used with static geometry */
+#if defined(OLED_STATIC_WIDTH)
+#define OLED_is_banded_(oled) (false)
+#else
+#define OLED_is_banded_(oled) (NULL != (oled)->dl)
+#endif
+enum OLED_dl_op_ {
+	OLED_DL_PIXEL_ = 1,	/* struct OLED_dl_rect_, x_from and y_from only */
+	OLED_DL_RECT_,		/* struct OLED_dl_rect_, ordered and clamped	*/
+	OLED_DL_TEXT_,		/* struct OLED_dl_text_, then len characters	*/
+	OLED_DL_TEXT_P_,	/* struct OLED_dl_text_, str is in flash	*/
+	OLED_DL_BLIT_,		/* struct OLED_dl_blit_				*/
+	OLED_DL_BLIT_P_,	/* struct OLED_dl_blit_, bitmaps are in flash	*/
+	OLED_DL_LINE_,		/* struct OLED_dl_line_				*/
+	OLED_DL_CIRCLE_,	/* struct OLED_dl_circle_			*/
+	OLED_DL_POLY_		/* Number of vertices, then OLED_point of each	*/
+};
+
+static void OLED_refresh_banded_(OLED *oled);
+static OLED_err OLED_dl_rect_(OLED *oled, uint8_t op, uint8_t x_from, uint8_t y_from,
+			      uint8_t x_to, uint8_t y_to, uint8_t params);
+static OLED_err OLED_dl_text_(OLED *oled, const OLED_font *font, const OLED_font *f, uint8_t x, uint8_t y,
+			      const char *str, uint8_t len, bool is_pgm, uint8_t params);
+static OLED_err OLED_dl_blit_(OLED *oled, int16_t x, int16_t y, uint8_t w, uint8_t h, const uint8_t *bitmap,
+			      const uint8_t *mask, bool is_pgm, enum OLED_blit_mode mode);
+static OLED_err OLED_dl_line_(OLED *oled, int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t params);
+static OLED_err OLED_dl_circle_(OLED *oled, int16_t x, int16_t y, uint8_t r, uint8_t params);
+static OLED_err OLED_dl_poly_(OLED *oled, const OLED_point *pts, uint8_t n, uint8_t params);
+
+
+/* Marks all columns of all pages as dirty. Page checksums no longer tell
+ * what GDDRAM holds, so the whole frame is sent even with OLED_OPT_CHECKSUM
+ */
+static void OLED_mark_dirty_all(OLED *oled)
+{
+	for (uint8_t page = 0; page < oled->num_pages; page++) {
+		oled->dirty_from[page] = 0;
+		oled->dirty_to[page] = OLED_WIDTH_(oled) - 1;
+	}
+	oled->sum_stale = 0xFF;
+}
+
+
+/* OLED_OPT_CHECKSUM. Replaces dirty spans with whole pages whose CRC differs
+ * from the one of the last time they were sent (or are stale), other pages
+ * are left clean whatever was drawn on them
+ */
+static void OLED_check_sums_(OLED *oled)
+{
+	const uint8_t *row = OLED_txbuf_(oled);
+	for (uint8_t page = 0; page < oled->num_pages; page++) {
+		uint16_t sum = 0xFFFF;
+		for (uint8_t i = 0; i < OLED_WIDTH_(oled); i++)
+			sum = _crc_ccitt_update(sum, row[i]);
+		row += OLED_WIDTH_(oled);
+
+		if ((oled->sum_stale & (1 << page)) || (sum != oled->page_sum[page])) {
+			oled->page_sum[page] = sum;
+			oled->dirty_from[page] = 0;
+			oled->dirty_to[page] = OLED_WIDTH_(oled) - 1;
+		} else {
+			oled->dirty_from[page] = 0xFF;
+			oled->dirty_to[page] = 0;
+		}
+	}
+	oled->sum_stale = 0;
+}
+
+
+/* Drop flag of display, see i2c_dropped. Returns whether it was set */
+static bool OLED_take_dropped_(OLED *oled)
+{
+	uint8_t bit = 1 << (oled->i2c_addr % 8);
+	bool is_dropped;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		is_dropped = (i2c_dropped[oled->i2c_addr / 8] & bit) != 0;
+		i2c_dropped[oled->i2c_addr / 8] &= ~bit;
+	}
+	return is_dropped;
+}
+
+
+/* Takes dirty spans to be sent by refresh and starts counting it. If some
+ * transaction to display was dropped on the bus since the last refresh,
+ * GDDRAM may be missing any part of frame, so the whole frame is taken
+ */
+static void OLED_take_dirty_(OLED *oled)
+{
+	if (OLED_take_dropped_(oled))
+		OLED_mark_dirty_all(oled);
+	if ((oled->opts & OLED_OPT_CHECKSUM) && !OLED_is_banded_(oled))
+		OLED_check_sums_(oled);
+	OLED_take_spans_(oled, oled->dirty_from, oled->dirty_to);
+}
+
+
+/* Sends spans taken by refresh */
+static void OLED_refresh_send_(OLED *oled)
+{
+	if (oled->opts & OLED_OPT_HORIZADDR)
+		OLED_refresh_window_(oled);
+	else
+		OLED_cbk_setwritepage(oled);
+	/* Lock is unlocked after series of callbacks, in the last one */
+}
+
+
+/* Takes dirty spans for sending and starts refresh. Drawing done from now
+ * on marks spans for the next refresh. Must be called under lock
+ */
+static void OLED_refresh_start_(OLED *oled)
+{
+	OLED_take_dirty_(oled);
+	OLED_refresh_send_(oled);
+}
+
+
+void OLED_mark_dirty(OLED *oled, uint8_t x_from, uint8_t y_from, uint8_t x_to, uint8_t y_to)
+{
+	uint8_t w_max = OLED_WIDTH_(oled) - 1;
+	uint8_t h_max = OLED_HEIGHT_(oled) - 1;
+	if (x_from > x_to) {
+		uint8_t tmp = x_from;
+		x_from = x_to;
+		x_to = tmp;
+	}
+	if (y_from > y_to) {
+		uint8_t tmp = y_from;
+		y_from = y_to;
+		y_to = tmp;
+	}
+	if ((x_from > w_max) || (y_from > h_max))
+		return;
+	if (x_to > w_max)
+		x_to = w_max;
+	if (y_to > h_max)
 		y_to = h_max;
-		size_errors++;
+
+	for (uint8_t page = y_from / 8; page <= y_to / 8; page++)
+		OLED_mark_dirty_(oled, page, x_from, x_to);
+}
+
+
+void OLED_cmd_setbrightness(OLED *oled, uint8_t level)
+{
+	memcpy(oled->cmd_brightness, _i2c_cmd_setbrightness, OLED_ARR_SIZE(_i2c_cmd_setbrightness));
+	oled->cmd_brightness[OLED_ARR_SIZE(_i2c_cmd_setbrightness) - 1] = level;
+	/* Goes in between transactions of refresh in process, if any */
+	while(!OLED_i2c_tx_shed(oled->i2c_addr, oled->cmd_brightness,
+                                OLED_ARR_SIZE(_i2c_cmd_setbrightness), NULL, 0,
+				&OLED_cbk_empty, NULL, false)) {
+		// nop
 	}
-	/* If all coordinates are out of bounds */
-	if (size_errors >= 4)
-		return OLED_EBOUNDS;
+}
 
-	//OLED_WITH_SPINLOCK(oled) {
-		/* Normalize coordinates */
-		/* start_@ indicates coordinates of upper left corner  */
-		/* stop_@ indicates coordinates of bottom right corner */
-		uint8_t start_x = x_to < x_from ? x_to : x_from; /* x min */
-		uint8_t start_y = y_to < y_from ? y_to : y_from; /* y min */
-		uint8_t stop_x = x_to > x_from ? x_to : x_from;  /* x max */
-		uint8_t stop_y = y_to > y_from ? y_to : y_from;  /* y max */
 
-		if (is_fill) {
-			/* Fill whole area */
-			for (uint8_t x = start_x; x <= stop_x; x++) {
-				for (uint8_t y = start_y; y <= stop_y; y++) {
-					OLED_put_pixel_(oled, x, y, pixel_color);
-				}
+/* Called from ISR after scroll setup has been sent */
+static void OLED_cbk_scroll_sent(void *args)
+{
+	OLED *oled = args;
+	oled->scroll_lock = 1;
+}
+
+
+OLED_err OLED_cmd_scroll(OLED *oled, bool left, uint8_t page_from, uint8_t page_to,
+			 enum OLED_scroll_interval interval, uint8_t voffset)
+{
+	if ((page_from > page_to) || (page_to >= oled->num_pages) || (voffset >= OLED_HEIGHT_(oled))
+	    || (interval > OLED_SCROLL_2_FRAMES))
+		return OLED_EPARAMS;
+	/* Previous setup may still be queued, buffer is only reused after it */
+	while (!OLED_lock_try_(&oled->scroll_lock)) {
+		OLED_STATSWRAP(oled->stat_spin_waits++;)
+		OLED_WATCHDOG_();
+	}
+
+	uint8_t *cmd = oled->cmd_scroll;
+	uint8_t len;
+	if (voffset) {
+		len = OLED_ARR_SIZE(_i2c_cmd_scrolldiag);
+		memcpy(cmd, _i2c_cmd_scrolldiag, len);
+		cmd[4] = OLED_HEIGHT_(oled);
+		cmd[5] += left;		/* 0x29 - right, 0x2A - left */
+		cmd[7] = page_from;
+		cmd[8] = interval;
+		cmd[9] = page_to;
+		cmd[10] = voffset;
+	} else {
+		len = OLED_ARR_SIZE(_i2c_cmd_scrollh);
+		memcpy(cmd, _i2c_cmd_scrollh, len);
+		cmd[2] += left;		/* 0x26 - right, 0x27 - left */
+		cmd[4] = page_from;
+		cmd[5] = interval;
+		cmd[6] = page_to;
+	}
+	while(!OLED_i2c_tx_shed(oled->i2c_addr, cmd, len, NULL, 0,
+				&OLED_cbk_scroll_sent, oled, false)) {
+		// nop
+	}
+	return OLED_EOK;
+}
+
+
+void OLED_cmd_scroll_stop(OLED *oled)
+{
+	while(!OLED_i2c_tx_shed(oled->i2c_addr, _i2c_cmd_scrollstop, OLED_ARR_SIZE(_i2c_cmd_scrollstop),
+				NULL, 0, &OLED_cbk_empty, NULL, false)) {
+		// nop
+	}
+	/* GDDRAM has been moved by scrolling, so it has to be sent again */
+	OLED_mark_dirty_all(oled);
+}
+
+
+void OLED_cmd_startline(OLED *oled, uint8_t line)
+{
+	memcpy(oled->cmd_startline, _i2c_cmd_startline, OLED_ARR_SIZE(_i2c_cmd_startline));
+	oled->cmd_startline[1] |= line & 0x3F;
+	while(!OLED_i2c_tx_shed(oled->i2c_addr, oled->cmd_startline,
+				OLED_ARR_SIZE(_i2c_cmd_startline), NULL, 0,
+				&OLED_cbk_empty, NULL, false)) {
+		// nop
+	}
+}
+
+
+OLED_err OLED_set_rotation(OLED *oled, enum OLED_rotation rotation)
+{
+	if ((rotation > OLED_ROTATE_270) || ((rotation & 0x01) && OLED_is_banded_(oled)))
+		return OLED_EPARAMS;
+	bool is_half = rotation >= OLED_ROTATE_180;
+	OLED_WITH_SPINLOCK(oled) {
+		/* Panel narrower than GDDRAM (128 columns) is in the middle */
+		/* of it or at its left end, which reversed is the right one */
+		if (is_half != (oled->rotation >= OLED_ROTATE_180))
+			oled->col_offset = 128 - OLED_WIDTH_(oled) - oled->col_offset;
+		oled->rotation = rotation;
+		memcpy(oled->cmd_orient, _i2c_cmd_orient, OLED_ARR_SIZE(_i2c_cmd_orient));
+		if (is_half) {
+			oled->cmd_orient[1] |= 0x01;
+			oled->cmd_orient[3] |= 0x08;
+		}
+		while(!OLED_i2c_tx_shed(oled->i2c_addr, oled->cmd_orient,
+					OLED_ARR_SIZE(_i2c_cmd_orient), NULL, 0,
+					&OLED_cbk_empty, NULL, false)) {
+			// nop
+		}
+		/* Segment remap applies to data written after it */
+		OLED_mark_dirty_all(oled);
+	}
+	return OLED_EOK;
+}
+
+
+void OLED_refresh(OLED *oled)
+{
+	if (OLED_is_banded_(oled)) {
+		OLED_spinlock(oled);
+		OLED_mark_dirty_all(oled);
+		OLED_refresh_banded_(oled);
+		return;
+	}
+	if (NULL != oled->front_buffer) {
+		OLED_WITH_SPINLOCK(oled) {
+			OLED_mark_dirty_all(oled);
+		}
+		OLED_swap(oled, true);
+		return;
+	}
+	OLED_spinlock(oled);
+	/* Code below is executed under lock */
+	OLED_mark_dirty_all(oled);
+	OLED_refresh_start_(oled);
+}
+
+
+void OLED_refresh_dirty(OLED *oled)
+{
+	if (OLED_is_banded_(oled)) {
+		OLED_spinlock(oled);
+		OLED_refresh_banded_(oled);
+		return;
+	}
+	if (NULL != oled->front_buffer) {
+		OLED_swap(oled, true);
+		return;
+	}
+	OLED_spinlock(oled);
+	OLED_refresh_start_(oled);
+}
+
+
+OLED_err OLED_refresh_async(OLED *oled, void (*cbk)(void *), void *cbk_args)
+{
+	if (OLED_is_banded_(oled) || (NULL != oled->front_buffer))
+		return OLED_EPARAMS;
+	OLED_err err = OLED_EOK;
+	bool is_busy = false;
+	bool is_coalesced = (oled->opts & OLED_OPT_COALESCE) != 0;
+	/* Refresh in process can't finish between the check and taking spans */
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		is_busy = !oled->busy_lock;
+		if (is_busy && !is_coalesced) {
+			err = OLED_EBUSY;
+		} else if (is_busy) {
+			/* Dirty spans are only touched outside of ISR, so they */
+			/* are moved to pending ones, which ISR takes then	 */
+			for (uint8_t page = 0; page < oled->num_pages; page++) {
+				if (oled->dirty_from[page] < oled->pending_from[page])
+					oled->pending_from[page] = oled->dirty_from[page];
+				if (oled->dirty_to[page] > oled->pending_to[page])
+					oled->pending_to[page] = oled->dirty_to[page];
+				oled->dirty_from[page] = 0xFF;
+				oled->dirty_to[page] = 0;
 			}
+			oled->pending_cbk = cbk;
+			oled->pending_cbk_args = cbk_args;
+			oled->is_refresh_pending = true;
+		} else if (i2c_queue_len >= OLED_CMDBUFFER_LEN - OLED_CMDBUFFER_RESERVE) {
+			/* Refresh starts by queuing a transaction, which would */
+			/* wait for a free slot, with interrupts off in ISR	 */
+			is_busy = true;
+			err = OLED_EBUSY;
 		} else {
-			/* Draw outer frame */
-			for (uint8_t x = start_x; x <= stop_x; x++) {
-				OLED_put_pixel_(oled, x, start_y, pixel_color);
-				OLED_put_pixel_(oled, x, stop_y, pixel_color);
-			}
-			for (uint8_t y = start_y; y <= stop_y; y++) {
-				OLED_put_pixel_(oled, start_x, y, pixel_color);
-				OLED_put_pixel_(oled, stop_x, y, pixel_color);
-			}
+			OLED_trylock(oled);
 		}
-	//}
+	}
+	if (is_busy)
+		return err;
+
+	OLED_take_dirty_(oled);
+	oled->refresh_cbk = cbk;
+	oled->refresh_cbk_args = cbk_args;
+	OLED_refresh_send_(oled);
+	return OLED_EOK;
+}
+
+
+void OLED_refresh_pending_(OLED *oled)
+{
+	bool is_taken = false;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		is_taken = oled->is_refresh_pending && OLED_trylock(oled);
+	}
+	if (is_taken) {
+		OLED_take_pending_(oled);
+		OLED_refresh_send_(oled);
+	}
+}
+
 
+OLED_err OLED_wait_idle(OLED *oled, uint16_t timeout_ms)
+{
+	uint32_t polls = timeout_ms * (uint32_t)(1000 / OLED_WAIT_POLL_US);
+	while (!OLED_is_idle(oled)) {
+		if (!polls--)
+			return OLED_EBUSY;
+		_delay_us(OLED_WAIT_POLL_US);
+		OLED_WATCHDOG_();
+	}
 	return OLED_EOK;
-}
\ No newline at end of file
+}
+
+
+void OLED_swap(OLED *oled, bool copy_forward)
+{
+	OLED_spinlock(oled);
+	/* Previous frame may still be on the bus. That is the only wait here */
+	while (!OLED_lock_try_(&oled->tx_lock)) {
+		OLED_STATSWRAP(oled->stat_spin_waits++;)
+		OLED_WATCHDOG_();
+	}
+
+	uint8_t *front = oled->frame_buffer;
+	oled->frame_buffer = oled->front_buffer;
+	oled->front_buffer = front;
+
+	/* Display shows what previous front buffer held. If back buffer did */
+	/* not start with the same contents, dirty spans do not describe the */
+	/* difference and the whole frame has to be sent			 */
+	if (!oled->is_back_synced)
+		OLED_mark_dirty_all(oled);
+	if (copy_forward) {
+		for (uint8_t page = 0; page < oled->num_pages; page++) {
+			if (oled->dirty_from[page] > oled->dirty_to[page])
+				continue;
+			uint16_t offset = page * (uint16_t)OLED_WIDTH_(oled) + oled->dirty_from[page];
+			memcpy(&oled->frame_buffer[offset], &front[offset],
+			       oled->dirty_to[page] - oled->dirty_from[page] + 1);
+		}
+	}
+	oled->is_back_synced = copy_forward;
+
+	OLED_refresh_start_(oled);
+	OLED_unlock(oled);
+}
+
+
+/* Animation playback. Spans of frame are sent one after another, each one
+ * as a window: a single transaction in horizontal addressing mode, or page
+ * by page in page mode. Data bytes are decoded from program memory by ISR
+ */
+static void OLED_cbk_anim_span(void *args);
+static void OLED_cbk_anim_setpage(void *args);
+
+/* RLE decoder, called by ISR for each data byte */
+static uint8_t OLED_anim_byte_(void *args)
+{
+	OLED_anim *anim = args;
+	if (!anim->run_left) {
+		uint8_t code = pgm_read_byte(anim->pos++);
+		anim->is_repeat = (code & 0x80) != 0;
+		anim->run_left = (code & 0x7F) + 1;
+		if (anim->is_repeat)
+			anim->run_byte = pgm_read_byte(anim->pos++);
+	}
+	anim->run_left--;
+	return anim->is_repeat ? anim->run_byte : pgm_read_byte(anim->pos++);
+}
+
+
+/* Page mode. Sends one page of span window, then goes on with the next one */
+static void OLED_cbk_anim_page(void *args)
+{
+	OLED_anim *anim = args;
+	bool is_last = (anim->page == anim->page_to);
+	anim->page++;
+	while(!I2C_tx_shed_gen(anim->oled->i2c_addr, _i2c_cmd_dataprefix, OLED_ARR_SIZE(_i2c_cmd_dataprefix),
+			       &OLED_anim_byte_, anim->ncols,
+			       is_last ? &OLED_cbk_anim_span : &OLED_cbk_anim_setpage, anim, false)) {
+		// nop
+	}
+}
+
+
+/* Page mode. Sets cursor to the span start on current page */
+static void OLED_cbk_anim_setpage(void *args)
+{
+	OLED_anim *anim = args;
+	OLED_setpage_(anim->oled, anim->oled->cmd, anim->col, anim->page);
+	while(!OLED_i2c_tx_shed(anim->oled->i2c_addr, anim->oled->cmd, OLED_ARR_SIZE(_i2c_cmd_setpage),
+				NULL, 0, &OLED_cbk_anim_page, anim, false)) {
+		// nop
+	}
+}
+
+
+/* Reads header of the next span and sends it. Finishes frame at its end */
+static void OLED_cbk_anim_span(void *args)
+{
+	OLED_anim *anim = args;
+	OLED *oled = anim->oled;
+	uint8_t pages = pgm_read_byte(anim->pos++);
+	if (OLED_ANIM_END_OF_FRAME == pages) {
+		OLED_refresh_done_(oled);
+		return;
+	}
+
+	anim->page = pages >> 4;
+	anim->page_to = pages & 0x0F;
+	anim->col = pgm_read_byte(anim->pos++);
+	anim->ncols = pgm_read_byte(anim->pos++);
+	anim->run_left = 0;
+	oled->refresh_bytes += anim->ncols * (anim->page_to - anim->page + 1);
+
+	if (oled->opts & OLED_OPT_HORIZADDR) {
+		OLED_setwindow_(oled, oled->cmd, anim->col, anim->col + anim->ncols - 1, anim->page, anim->page_to);
+		while(!I2C_tx_shed_gen(oled->i2c_addr, oled->cmd, OLED_ARR_SIZE(_i2c_cmd_setwindow),
+				       &OLED_anim_byte_, anim->ncols * (anim->page_to - anim->page + 1),
+				       &OLED_cbk_anim_span, anim, false)) {
+			// nop
+		}
+	} else {
+		OLED_cbk_anim_setpage(anim);
+	}
+}
+
+
+OLED_err OLED_anim_init(OLED *oled, OLED_anim *anim, const uint8_t *data)
+{
+	uint8_t width = pgm_read_byte(&data[2]);
+	uint8_t num_pages = pgm_read_byte(&data[3]);
+	if ((width > OLED_WIDTH_(oled)) || (num_pages > oled->num_pages))
+		return OLED_EPARAMS;
+	anim->data = data;
+	anim->num_frames = pgm_read_word(&data[0]);
+	OLED_anim_rewind(anim);
+	return OLED_EOK;
+}
+
+
+void OLED_anim_rewind(OLED_anim *anim)
+{
+	anim->pos = anim->data + OLED_ANIM_HEADER_LEN;
+	anim->frame = 0;
+}
+
+
+bool OLED_anim_frame(OLED *oled, OLED_anim *anim)
+{
+	if (anim->frame >= anim->num_frames)
+		return false;
+	anim->frame++;
+
+	OLED_spinlock(oled);
+	bool is_double = (NULL != oled->front_buffer);
+	if (is_double) {
+		/* Only transfer is locked, as it is done by OLED_swap */
+		while (!OLED_lock_try_(&oled->tx_lock)) {
+			OLED_STATSWRAP(oled->stat_spin_waits++;)
+			OLED_WATCHDOG_();
+		}
+	}
+	/* Display no longer shows frame buffer, next refresh sends it whole */
+	OLED_mark_dirty_all(oled);
+	oled->is_back_synced = false;
+
+	anim->oled = oled;
+	oled->refresh_bytes = 0;
+	oled->refresh_cbk = NULL;
+	OLED_STATSWRAP(
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			oled->stat_refresh_start = OLED_stats_clock_();
+		}
+	)
+	OLED_cbk_anim_span(anim);
+	if (is_double)
+		OLED_unlock(oled);
+	return true;
+}
+
+
+#if defined(OLED_STATS)
+void OLED_stats_snapshot(OLED *oled, OLED_stats *stats, bool reset)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		stats->frames = oled->stat_frames;
+		stats->spin_waits = oled->stat_spin_waits;
+		stats->last_refresh_cycles = oled->stat_refresh_cycles;
+		stats->bytes = stat_bytes;
+		stats->txns = stat_txns;
+		stats->shed_fails = stat_shed_fails;
+		stats->isr_cycles = stat_isr_cycles;
+		stats->isr_cycles_max = stat_isr_cycles_max;
+		if (reset) {
+			oled->stat_frames = 0;
+			oled->stat_spin_waits = 0;
+			oled->stat_refresh_cycles = 0;
+			stat_bytes = 0;
+			stat_txns = 0;
+			stat_shed_fails = 0;
+			stat_isr_cycles = 0;
+			stat_isr_cycles_max = 0;
+		}
+	}
+}
+#endif
+
+
+#if defined(OLED_PACER)
+/***** Frame pacer *****/
+/* Timer1 runs free with no prescaling, OCR1A is moved forward by at most	*/
+/* OLED_PACER_STEP_ cycles at a time till the deadline. Step is not shorter	*/
+/* than OLED_PACER_MIN_STEP_, otherwise ISR re-arming it could be late and	*/
+/* match would come only after the wrap of Timer1				*/
+#define OLED_PACER_STEP_ 0x8000
+#define OLED_PACER_MIN_STEP_ 0x400
+
+static OLED *pacer_oled;
+static uint32_t pacer_period;		/* CPU cycles between deadlines	     */
+static uint32_t pacer_left;		/* Cycles from OCR1A to the deadline */
+static volatile bool pacer_is_busy;	/* Frame started by pacer is on bus  */
+static bool pacer_is_deferred;		/* OLED was locked at deadline	     */
+static OLED_pacer_stats pacer_stats;
+static OLED_gray *pacer_gray;		/* Planes are sent instead of dirty  */
+static uint8_t pacer_plane;		/* Plane to be sent at the deadline  */
+
+
+/* Sets next compare match on the way to deadline in cycles from the last. */
+/* Short remainder is joined to the last step, which still fits 16 bits	   */
+static void OLED_pacer_arm_(uint32_t cycles)
+{
+	uint16_t step = (cycles > OLED_PACER_STEP_ + OLED_PACER_MIN_STEP_) ? OLED_PACER_STEP_ : cycles;
+	pacer_left = cycles - step;
+	OCR1A += step;
+}
+
+
+static void OLED_cbk_pacer_frame(void *args)
+{
+	(void)args;
+	pacer_is_busy = false;
+}
+
+
+/* Cycles till the deadline after the one being armed. Plane of level bit 1
+ * stays on display twice as long, unless contrast does the weighting
+ */
+static uint32_t OLED_pacer_period_(void)
+{
+	if ((NULL != pacer_gray) && !pacer_gray->contrast && pacer_plane)
+		return 2 * pacer_period;
+	return pacer_period;
+}
+
+
+/* Sends the next grayscale plane as a whole frame, after its contrast */
+static bool OLED_gray_frame_(OLED *oled)
+{
+	OLED_gray *gray = pacer_gray;
+	/* Lock and queue are checked first: nothing is queued if refresh */
+	/* can't start, so plane is never shown with contrast of the other */
+	if (!OLED_is_idle(oled))
+		return false;
+	uint8_t slots = gray->contrast ? 2 : 1;
+	if (i2c_queue_len + slots > OLED_CMDBUFFER_LEN - OLED_CMDBUFFER_RESERVE)
+		return false;
+	oled->frame_buffer = &gray->planes[pacer_plane * (oled->num_pages * (uint16_t)OLED_WIDTH_(oled))];
+	OLED_mark_dirty_all(oled);
+	if (gray->contrast && !OLED_i2c_tx_shed(oled->i2c_addr, gray->cmd_contrast[pacer_plane],
+						OLED_ARR_SIZE(gray->cmd_contrast[0]), NULL, 0, NULL, NULL, true))
+		return false;
+	pacer_is_busy = true;
+	if (OLED_EOK != OLED_refresh_async(oled, &OLED_cbk_pacer_frame, NULL)) {
+		pacer_is_busy = false;
+		return false;
+	}
+	pacer_plane ^= 1;
+	pacer_stats.frames++;
+	return true;
+}
+
+
+/* Starts refresh if frame is dirty. Returns false if OLED is locked */
+static bool OLED_pacer_frame_(void)
+{
+	OLED *oled = pacer_oled;
+	if (NULL != pacer_gray)
+		return OLED_gray_frame_(oled);
+	bool is_dirty = false;
+	for (uint8_t page = 0; page < oled->num_pages; page++)
+		is_dirty |= oled->dirty_from[page] <= oled->dirty_to[page];
+	if (!is_dirty) {
+		pacer_stats.clean++;
+		return true;
+	}
+	pacer_is_busy = true;
+	if (OLED_EOK != OLED_refresh_async(oled, &OLED_cbk_pacer_frame, NULL)) {
+		pacer_is_busy = false;
+		return false;
+	}
+	pacer_stats.frames++;
+	return true;
+}
+
+
+ISR(TIMER1_COMPA_vect)
+{
+	if (pacer_left) {
+		OLED_pacer_arm_(pacer_left);
+		/* Drawing held the lock at deadline, it is retried on each step */
+		if (pacer_is_deferred)
+			pacer_is_deferred = !OLED_pacer_frame_();
+		return;
+	}
+	OLED_pacer_arm_(OLED_pacer_period_());
+	if (pacer_is_busy || pacer_is_deferred || i2c_is_taken) {
+		pacer_stats.missed++;
+		return;
+	}
+	pacer_is_deferred = !OLED_pacer_frame_();
+	if (pacer_is_deferred)
+		pacer_stats.deferred++;
+}
+
+
+/* Starts pacing oled with deadlines period cycles apart. Sends planes of */
+/* gray instead of dirty spans if it is not NULL			  */
+static void OLED_pacer_start_(OLED *oled, uint32_t period, OLED_gray *gray)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		pacer_oled = oled;
+		pacer_period = period;
+		pacer_gray = gray;
+		pacer_plane = 1;
+		pacer_is_busy = false;
+		pacer_is_deferred = false;
+		if (!(TCCR1B & ((1 << CS12) | (1 << CS11) | (1 << CS10)))) {
+			TCCR1A = 0;
+			TCCR1B = (1 << CS10);	/* Normal mode, clk/1 */
+		}
+		OCR1A = TCNT1;
+		OLED_pacer_arm_(pacer_period);
+		TIFR1 = (1 << OCF1A);	/* Clears stale match */
+		TIMSK1 |= (1 << OCIE1A);
+	}
+}
+
+
+OLED_err OLED_pacer_start(OLED *oled, uint8_t fps)
+{
+	if (!fps || OLED_is_banded_(oled) || (NULL != oled->front_buffer))
+		return OLED_EPARAMS;
+	OLED_pacer_start_(oled, F_CPU / fps, NULL);
+	return OLED_EOK;
+}
+
+
+void OLED_pacer_stop(void)
+{
+	TIMSK1 &= ~(1 << OCIE1A);
+}
+
+
+bool OLED_pacer_bus_take(uint16_t us)
+{
+	bool is_taken = false;
+	uint32_t cycles = us * (F_CPU / 1000000UL);
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		bool is_paced = (TIMSK1 & (1 << OCIE1A)) != 0;
+		uint32_t left = pacer_left + (uint16_t)(OCR1A - TCNT1);
+		if ((I2C_STATE_IDLE == i2c_state) && !i2c_is_taken && (!is_paced || (left >= cycles))) {
+			i2c_is_taken = true;
+			is_taken = true;
+		}
+	}
+	return is_taken;
+}
+
+
+void OLED_pacer_bus_give(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		i2c_is_taken = false;
+#if !defined(OLED_SPI)
+		/* Polled driver may have cleared TWIE, i.e. with its STOP */
+		TWCR = (1 << TWEN) | (1 << TWIE);
+#endif
+		/* Transactions queued meanwhile start now */
+		if ((I2C_STATE_IDLE == i2c_state) && i2c_queue_len) {
+			I2C_txn_load();
+			OLED_bus_start_();
+		}
+	}
+}
+
+
+void OLED_pacer_stats_snapshot(OLED_pacer_stats *stats, bool reset)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		*stats = pacer_stats;
+		if (reset)
+			memset(&pacer_stats, 0, sizeof pacer_stats);
+	}
+}
+
+
+/***** Grayscale *****/
+OLED_err OLED_gray_init(OLED *oled, OLED_gray *gray, uint8_t *planes)
+{
+	if (OLED_is_banded_(oled) || (NULL != oled->front_buffer) || OLED_is_turned_(oled))
+		return OLED_EPARAMS;
+	uint16_t size = oled->num_pages * (uint16_t)OLED_WIDTH_(oled);
+	memset(planes, 0, 2 * size);
+	gray->oled = oled;
+	gray->planes = planes;
+	gray->contrast = 0;
+	oled->frame_buffer = planes;
+	return OLED_EOK;
+}
+
+
+OLED_err OLED_gray_start(OLED_gray *gray, uint16_t plane_hz, uint8_t contrast)
+{
+	if (!plane_hz)
+		return OLED_EPARAMS;
+	gray->contrast = contrast;
+	for (uint8_t plane = 0; plane < 2; plane++) {
+		memcpy(gray->cmd_contrast[plane], _i2c_cmd_setbrightness, sizeof _i2c_cmd_setbrightness);
+		gray->cmd_contrast[plane][3] = plane ? contrast : contrast / 2;
+	}
+	OLED_pacer_start_(gray->oled, F_CPU / plane_hz, gray);
+	return OLED_EOK;
+}
+
+
+/* Makes OLED drawing on plane of gray, to draw with routines for 1 bit */
+static void OLED_gray_plane_(OLED_gray *gray, uint8_t plane, OLED *p)
+{
+	OLED *oled = gray->oled;
+	*p = (OLED){
+		.width = OLED_WIDTH_(oled),
+		.height = OLED_HEIGHT_(oled),
+		.frame_buffer = &gray->planes[plane * (oled->num_pages * (uint16_t)OLED_WIDTH_(oled))]
+	};
+}
+
+
+OLED_err OLED_gray_put_pixel(OLED_gray *gray, uint8_t x, uint8_t y, uint8_t level)
+{
+	OLED *oled = gray->oled;
+	if (level >= OLED_GRAY_LEVELS)
+		return OLED_EPARAMS;
+	if ((x >= OLED_WIDTH_(oled)) || (y >= OLED_HEIGHT_(oled)))
+		return OLED_EBOUNDS;
+	uint16_t byte_num = (y / 8) * (uint16_t)OLED_WIDTH_(oled) + x;
+	uint8_t *bit0 = &gray->planes[byte_num];
+	uint8_t *bit1 = bit0 + oled->num_pages * (uint16_t)OLED_WIDTH_(oled);
+	uint8_t mask = 1 << (y % 8);
+	*bit0 = (level & 0x01) ? (*bit0 | mask) : (*bit0 & ~mask);
+	*bit1 = (level & 0x02) ? (*bit1 | mask) : (*bit1 & ~mask);
+	return OLED_EOK;
+}
+
+
+OLED_err OLED_gray_put_rectangle(OLED_gray *gray, uint8_t x_from, uint8_t y_from, uint8_t x_to, uint8_t y_to,
+				 uint8_t level, enum OLED_params params)
+{
+	if ((level >= OLED_GRAY_LEVELS) || (params & ~OLED_FILL))
+		return OLED_EPARAMS;
+	OLED_err err = OLED_EOK;
+	for (uint8_t plane = 0; plane < 2; plane++) {
+		OLED p;
+		OLED_gray_plane_(gray, plane, &p);
+		err = OLED_put_rectangle(&p, x_from, y_from, x_to, y_to,
+					 params | ((level >> plane) & 0x01 ? OLED_BLACK : OLED_WHITE));
+	}
+	return err;
+}
+
+
+OLED_err OLED_gray_put_string(OLED_gray *gray, const OLED_font *font, uint8_t x, uint8_t y, const char *str,
+			      uint8_t level, enum OLED_params params)
+{
+	if ((level >= OLED_GRAY_LEVELS) || (params & ~OLED_FILL))
+		return OLED_EPARAMS;
+	OLED_err err = OLED_EOK;
+	for (uint8_t plane = 0; plane < 2; plane++) {
+		OLED p;
+		OLED_gray_plane_(gray, plane, &p);
+		err = OLED_put_string(&p, font, x, y, str,
+				      params | ((level >> plane) & 0x01 ? OLED_BLACK : OLED_WHITE));
+	}
+	return err;
+}
+#endif // OLED_PACER
+#endif // OLED_NO_I2C
+
+
+/***** Display-related logic *****/
+OLED_err __OLED_init(OLED *oled, uint8_t width, uint8_t height, uint8_t *frame_buffer, uint32_t i2c_freq_hz, uint8_t i2c_addr, uint8_t opts)
+{
+#if defined(OLED_STATIC_WIDTH)
+	if ((width != OLED_STATIC_WIDTH) || (height != OLED_STATIC_HEIGHT))
+		return OLED_EPARAMS;
+#endif
+#if defined(OLED_SPI)
+	/* CS pin is a bit of 8-bit port */
+	if (i2c_addr > 7)
+		return OLED_EPARAMS;
+#endif
+	struct OLED_panel_ panel;
+	uint8_t n = 0;
+	do {
+		if (n >= OLED_ARR_SIZE(_oled_panels))
+			return OLED_EPARAMS;
+		memcpy_P(&panel, &_oled_panels[n++], sizeof panel);
+	} while ((panel.width != width) || (panel.height != height));
+
+	oled->width = width;
+	oled->height = height;
+	oled->frame_buffer = frame_buffer;
+	oled->rotation = OLED_ROTATE_0;
+	oled->busy_lock = 1;	/* Initially: 1 - unlocked */
+#if defined(OLED_NO_I2C)
+	(void)i2c_freq_hz; (void)i2c_addr; (void)opts;
+#endif
+#if defined(OLED_STATS_TIMER1_INIT)
+	/* Stats clock runs before the first transaction is queued */
+	TCCR1A = 0;
+	TCCR1B = (1 << CS10);	/* Normal mode, clk/1 */
+#endif
+
+	OLED_I2CWRAP(
+		oled->i2c_addr = i2c_addr;
+		oled->opts = opts;
+		oled->front_buffer = NULL;
+		oled->dl = NULL;
+		oled->tx_lock = 1;
+		oled->scroll_lock = 1;
+		oled->is_back_synced = false;
+		oled->refresh_cbk = NULL;
+		oled->is_refresh_pending = false;
+		for (uint8_t page = 0; page < OLED_MAX_PAGES; page++) {
+			oled->pending_from[page] = 0xFF;
+			oled->pending_to[page] = 0;
+		}
+		OLED_STATSWRAP(
+			oled->stat_frames = 0;
+			oled->stat_spin_waits = 0;
+			oled->stat_refresh_cycles = 0;
+		)
+		oled->cur_page = 0;
+		oled->num_pages = height / 8;
+		oled->col_offset = panel.col_offset;
+		OLED_take_dropped_(oled);
+		/* Display contents are unknown, so whole frame is dirty */
+		OLED_mark_dirty_all(oled);
+
+		OLED_bus_init_(i2c_freq_hz, i2c_addr);
+
+		/* Geometry and addressing mode commands are built in cmd_init, */
+		/* as refresh may rewrite cmd before they are sent. They simply  */
+		/* follow the rest as data					 */
+		uint8_t *addrmode = (opts & OLED_OPT_HORIZADDR) ? _i2c_cmd_horizaddr : _i2c_cmd_pageaddr;
+		uint8_t len = OLED_ARR_SIZE(_i2c_cmd_geometry);
+		memcpy(oled->cmd_init, _i2c_cmd_geometry, len);
+		oled->cmd_init[3] = height - 1;
+		oled->cmd_init[7] = panel.com_pins;
+		memcpy(&oled->cmd_init[len], addrmode, OLED_ARR_SIZE(_i2c_cmd_pageaddr));
+		len += OLED_ARR_SIZE(_i2c_cmd_pageaddr);
+		if (!OLED_i2c_tx_shed(oled->i2c_addr, _i2c_cmd_init, OLED_ARR_SIZE(_i2c_cmd_init),
+				      oled->cmd_init, len, OLED_cbk_empty, NULL, false)) {
+			return OLED_EBUSY;
+		}
+	) // OLED_I2CWRAP
+
+	return OLED_EOK;
+}
+
+
+OLED_err OLED_put_pixel(OLED *oled, uint8_t x, uint8_t y, uint8_t pixel_state)
+{
+	/* Other bits would overwrite opcode of display list record */
+	if (pixel_state & ~(OLED_BLACK | OLED_XOR))
+		return OLED_EPARAMS;
+	if ((x >= OLED_draw_width_(oled)) || (y >= OLED_draw_height_(oled)))
+		return OLED_EBOUNDS;
+	if (OLED_is_turned_(oled)) {
+		uint8_t col = OLED_WIDTH_(oled) - 1 - y;
+		y = x;
+		x = col;
+	}
+	OLED_I2CWRAP(
+		if (OLED_is_banded_(oled))
+			return OLED_dl_rect_(oled, OLED_DL_PIXEL_, x, y, x, y, pixel_state);
+	)
+	OLED_put_pixel_(oled, x, y, pixel_state);	/* Use inline */
+	return OLED_EOK;
+}
+
+
+/* Fills area with color (OLED_BLACK bit of params) or inverts it (OLED_XOR),
+ * working on whole page bytes instead of pixels. Partial top and bottom pages
+ * get their bit masks applied with OR/AND/XOR, full pages in between are
+ * simply memset unless inverted. Marks area dirty.
+ * Coordinates must be ordered (from <= to) and lie within display bounds
+ */
+static void OLED_fill_area_(OLED *oled, uint8_t x_from, uint8_t y_from, uint8_t x_to, uint8_t y_to, uint8_t params)
+{
+	bool color = (OLED_BLACK & params) != 0;
+	uint8_t page_from = y_from / 8;
+	uint8_t page_to = y_to / 8;
+	uint8_t mask_top = (uint8_t)(0xFF << (y_from % 8));
+	uint8_t mask_bottom = 0xFF >> (7 - y_to % 8);
+	uint8_t ncols = x_to - x_from + 1;
+	uint8_t *row = &oled->frame_buffer[page_from * (uint16_t)OLED_WIDTH_(oled) + x_from];
+
+	for (uint8_t page = page_from; page <= page_to; page++) {
+		uint8_t mask = 0xFF;
+		if (page == page_from)
+			mask &= mask_top;
+		if (page == page_to)
+			mask &= mask_bottom;
+
+		if (OLED_XOR & params) {
+			for (uint8_t i = 0; i < ncols; i++)
+				row[i] ^= mask;
+		} else if (0xFF == mask) {
+			memset(row, color ? 0xFF : 0x00, ncols);
+		} else if (color) {
+			for (uint8_t i = 0; i < ncols; i++)
+				row[i] |= mask;
+		} else {
+			mask = ~mask;
+			for (uint8_t i = 0; i < ncols; i++)
+				row[i] &= mask;
+		}
+		OLED_mark_dirty_(oled, page, x_from, x_to);
+		row += OLED_WIDTH_(oled);
+	}
+}
+
+
+/* OLED_fill_area_ with coordinates of drawing, which may be turned */
+static void OLED_fill_turned_(OLED *oled, uint8_t x_from, uint8_t y_from, uint8_t x_to, uint8_t y_to,
+			      uint8_t params)
+{
+	if (OLED_is_turned_(oled))
+		OLED_fill_area_(oled, OLED_WIDTH_(oled) - 1 - y_to, x_from, OLED_WIDTH_(oled) - 1 - y_from, x_to, params);
+	else
+		OLED_fill_area_(oled, x_from, y_from, x_to, y_to, params);
+}
+
+
+OLED_err OLED_put_rectangle(OLED *oled, uint8_t x_from, uint8_t y_from, uint8_t x_to, uint8_t y_to, enum OLED_params params)
+{
+	if (params & ~(OLED_BLACK | OLED_FILL | OLED_XOR))
+		return OLED_EPARAMS;
+	bool is_fill = (OLED_FILL & params) != 0;
+
+	/* Limit coordinates to display bounds */
+	uint8_t size_errors = 0;
+	uint8_t w_max = OLED_draw_width_(oled) - 1;
+	uint8_t h_max = OLED_draw_height_(oled) - 1;
+	if (x_from > w_max) {
+		x_from = w_max;
+		size_errors++;
+	}
+	if (x_to > w_max) {
+		x_to = w_max;
+		size_errors++;
+	}
+	if (y_from > h_max) {
+		y_from = h_max;
+		size_errors++;
+	}
+	if (y_to > h_max) {
+		y_to = h_max;
+		size_errors++;
+	}
+	/* If all coordinates are out of bounds */
+	if (size_errors >= 4)
+		return OLED_EBOUNDS;
+
+	//OLED_WITH_SPINLOCK(oled) {
+		/* Normalize coordinates */
+		/* start_@ indicates coordinates of upper left corner  */
+		/* stop_@ indicates coordinates of bottom right corner */
+		uint8_t start_x = x_to < x_from ? x_to : x_from; /* x min */
+		uint8_t start_y = y_to < y_from ? y_to : y_from; /* y min */
+		uint8_t stop_x = x_to > x_from ? x_to : x_from;  /* x max */
+		uint8_t stop_y = y_to > y_from ? y_to : y_from;  /* y max */
+
+		OLED_I2CWRAP(
+			if (OLED_is_banded_(oled))
+				return OLED_dl_rect_(oled, OLED_DL_RECT_, start_x, start_y, stop_x, stop_y, params);
+		)
+
+		if (is_fill) {
+			/* Fill whole area */
+			OLED_fill_turned_(oled, start_x, start_y, stop_x, stop_y, params);
+		} else {
+			/* Draw outer frame: horizontal edges, then vertical ones
+			 * between them. No pixel is drawn twice, as XOR would
+			 * undo it
+			 */
+			OLED_fill_turned_(oled, start_x, start_y, stop_x, start_y, params);
+			if (stop_y != start_y)
+				OLED_fill_turned_(oled, start_x, stop_y, stop_x, stop_y, params);
+			if (stop_y - start_y >= 2) {
+				OLED_fill_turned_(oled, start_x, start_y + 1, start_x, stop_y - 1, params);
+				if (stop_x != start_x)
+					OLED_fill_turned_(oled, stop_x, start_y + 1, stop_x, stop_y - 1, params);
+			}
+		}
+	//}
+
+	return OLED_EOK;
+}
+
+
+/***** Lines, circles and polygons *****/
+/* Floor of a / b for b > 0. C division rounds toward zero instead, which
+ * would make pixels of shape depend on band it is rasterized on
+ */
+static inline int32_t OLED_floordiv_(int32_t a, int32_t b)
+{
+	return (a >= 0) ? a / b : -((b - 1 - a) / b);
+}
+
+
+static inline bool OLED_coord_ok_(int16_t c)
+{
+	return (c >= -OLED_COORD_LIMIT) && (c <= OLED_COORD_LIMIT);
+}
+
+
+/* Applies raster operation of params to bits of mask in byte */
+static inline ALWAYSINLINE void OLED_rop_(uint8_t *byte, uint8_t mask, uint8_t params)
+{
+	if (OLED_XOR & params)
+		*byte ^= mask;
+	else if (OLED_BLACK & params)
+		*byte |= mask;
+	else
+		*byte &= ~mask;
+}
+
+
+/* Offsets [*lo..*hi] from a0 in direction s which stay within [0..lim] */
+static inline void OLED_axis_range_(int16_t a0, int8_t s, int16_t lim, int32_t *lo, int32_t *hi)
+{
+	*lo = (s > 0) ? -a0 : a0 - lim;
+	*hi = (s > 0) ? lim - a0 : a0;
+}
+
+
+/* Fills column x from y_from to y_to, clipped by display bounds */
+static void OLED_vspan_(OLED *oled, int16_t x, int16_t y_from, int16_t y_to, uint8_t params)
+{
+	if ((x < 0) || (x >= OLED_WIDTH_(oled)))
+		return;
+	if (y_from < 0)
+		y_from = 0;
+	if (y_to >= OLED_HEIGHT_(oled))
+		y_to = OLED_HEIGHT_(oled) - 1;
+	if (y_from <= y_to)
+		OLED_fill_area_(oled, x, y_from, x, y_to, params);
+}
+
+
+/* Draws line from (x0, y0) to (x1, y1), without the last point if skip_last.
+ * At step k of the longer axis, the shorter one is shifted by
+ * floor((2 * k * d_short + d_long) / (2 * d_long)). That is inverted to find
+ * steps which are on display, so clipping changes no pixel and skips steps
+ * off display at once
+ */
+static void OLED_line_(OLED *oled, int16_t x0, int16_t y0, int16_t x1, int16_t y1, bool skip_last, uint8_t params)
+{
+	int16_t dx = x1 - x0, dy = y1 - y0;
+	int8_t sx = (dx < 0) ? -1 : 1;
+	int8_t sy = (dy < 0) ? -1 : 1;
+	dx *= sx;
+	dy *= sy;
+	bool is_steep = dy > dx;
+	int16_t d_long = is_steep ? dy : dx;
+	int16_t d_short = is_steep ? dx : dy;
+
+	int32_t k_from = 0, k_to = d_long - skip_last;
+	int32_t lo, hi, s_lo, s_hi;
+	if (is_steep) {
+		OLED_axis_range_(y0, sy, OLED_HEIGHT_(oled) - 1, &lo, &hi);
+		OLED_axis_range_(x0, sx, OLED_WIDTH_(oled) - 1, &s_lo, &s_hi);
+	} else {
+		OLED_axis_range_(x0, sx, OLED_WIDTH_(oled) - 1, &lo, &hi);
+		OLED_axis_range_(y0, sy, OLED_HEIGHT_(oled) - 1, &s_lo, &s_hi);
+	}
+	if (lo > k_from)
+		k_from = lo;
+	if (hi < k_to)
+		k_to = hi;
+	if (s_lo < 0)
+		s_lo = 0;
+	if (s_hi > d_short)
+		s_hi = d_short;
+	if ((k_from > k_to) || (s_lo > s_hi))
+		return;
+
+	/* Horizontal and vertical lines are byte fills */
+	if (!d_short) {
+		int16_t from = (is_steep ? y0 : x0) + (is_steep ? sy : sx) * k_from;
+		int16_t to = (is_steep ? y0 : x0) + (is_steep ? sy : sx) * k_to;
+		if (from > to) {
+			int16_t tmp = from;
+			from = to;
+			to = tmp;
+		}
+		if (is_steep)
+			OLED_fill_area_(oled, x0, from, x0, to, params);
+		else
+			OLED_fill_area_(oled, from, y0, to, y0, params);
+		return;
+	}
+	/* Steps of the first and the last shorter axis offset on display */
+	int32_t d2 = 2 * (int32_t)d_short;
+	if (s_lo > 0) {
+		int32_t k = ((2 * s_lo - 1) * d_long + d2 - 1) / d2;
+		if (k > k_from)
+			k_from = k;
+	}
+	if (s_hi < d_short) {
+		int32_t k = ((2 * s_hi + 1) * d_long + d2 - 1) / d2 - 1;
+		if (k < k_to)
+			k_to = k;
+	}
+	if (k_from > k_to)
+		return;
+
+	int32_t err = 2 * k_from * d_short + d_long;
+	int16_t m = err / (2 * d_long);
+	err %= 2 * d_long;
+	int16_t x = x0 + sx * (is_steep ? m : k_from);
+	int16_t y = y0 + sy * (is_steep ? k_from : m);
+
+	/* Pixels are gathered into mask while they are in the same byte */
+	uint8_t *byte = NULL;
+	uint8_t mask = 0;
+	for (int32_t k = k_from; k <= k_to; k++) {
+		uint8_t *cur = &oled->frame_buffer[(y / 8) * (uint16_t)OLED_WIDTH_(oled) + x];
+		if (cur != byte) {
+			if (NULL != byte)
+				OLED_rop_(byte, mask, params);
+			byte = cur;
+			mask = 0;
+			OLED_mark_dirty_(oled, y / 8, x, x);
+		}
+		mask |= 1 << (y % 8);
+
+		err += 2 * d_short;
+		bool is_shifted = err >= 2 * d_long;
+		if (is_shifted)
+			err -= 2 * d_long;
+		if (is_steep) {
+			y += sy;
+			if (is_shifted)
+				x += sx;
+		} else {
+			x += sx;
+			if (is_shifted)
+				y += sy;
+		}
+	}
+	OLED_rop_(byte, mask, params);
+}
+
+
+/* Plots point of shape, checking bounds unless shape is known to be inside */
+static inline ALWAYSINLINE void OLED_plot_(OLED *oled, int16_t x, int16_t y, bool is_inside, uint8_t params)
+{
+	if (is_inside || ((x >= 0) && (x < OLED_WIDTH_(oled)) && (y >= 0) && (y < OLED_HEIGHT_(oled))))
+		OLED_put_pixel_(oled, x, y, params);
+}
+
+
+/* Midpoint circle. Point (x, y) of the first octant stands for up to 8
+ * points, those which coincide on axes and diagonals are plotted once.
+ * Filled circle is a vertical span per column: columns +-x of the first
+ * octant, then columns +-y of the second one, as y is about to change
+ */
+static void OLED_circle_(OLED *oled, int16_t xc, int16_t yc, uint8_t r, uint8_t params)
+{
+	if ((xc + r < 0) || (xc - r >= OLED_WIDTH_(oled)) || (yc + r < 0) || (yc - r >= OLED_HEIGHT_(oled)))
+		return;
+	bool is_inside = (xc - r >= 0) && (xc + r < OLED_WIDTH_(oled))
+			 && (yc - r >= 0) && (yc + r < OLED_HEIGHT_(oled));
+	bool is_fill = (OLED_FILL & params) != 0;
+	int16_t x = 0, y = r;
+	int16_t d = 1 - r;
+	while (x <= y) {
+		if (is_fill) {
+			OLED_vspan_(oled, xc + x, yc - y, yc + y, params);
+			if (x)
+				OLED_vspan_(oled, xc - x, yc - y, yc + y, params);
+		} else {
+			OLED_plot_(oled, xc + x, yc + y, is_inside, params);
+			if (y)
+				OLED_plot_(oled, xc + x, yc - y, is_inside, params);
+			if (x)
+				OLED_plot_(oled, xc - x, yc + y, is_inside, params);
+			if (x && y)
+				OLED_plot_(oled, xc - x, yc - y, is_inside, params);
+			if (x != y) {
+				OLED_plot_(oled, xc + y, yc + x, is_inside, params);
+				OLED_plot_(oled, xc - y, yc + x, is_inside, params);
+				if (x) {
+					OLED_plot_(oled, xc + y, yc - x, is_inside, params);
+					OLED_plot_(oled, xc - y, yc - x, is_inside, params);
+				}
+			}
+		}
+
+		if (d < 0) {
+			d += 2 * x + 3;
+		} else {
+			if (is_fill && (y > x)) {
+				OLED_vspan_(oled, xc + y, yc - x, yc + x, params);
+				OLED_vspan_(oled, xc - y, yc - x, yc + x, params);
+			}
+			d += 2 * (x - y) + 5;
+			y--;
+		}
+		x++;
+	}
+}
+
+
+/* Polygon outline is lines without their last points, so each vertex is
+ * drawn once. Fill goes column by column: edge crosses column x if it spans
+ * [x..x+1) and crossing at pixel center x+0.5 is rounded up to the next row
+ * center. Sorted crossings pair into spans [c0..c1-1], [c2..c3-1] ...
+ */
+static void OLED_polygon_(OLED *oled, const OLED_point *pts, uint8_t n, uint8_t params)
+{
+	if (!(OLED_FILL & params)) {
+		for (uint8_t i = 0; i < n; i++) {
+			const OLED_point *b = &pts[(i + 1 < n) ? i + 1 : 0];
+			OLED_line_(oled, pts[i].x, pts[i].y, b->x, b->y, true, params);
+		}
+		return;
+	}
+
+	int16_t x_from = pts[0].x, x_to = pts[0].x;
+	for (uint8_t i = 1; i < n; i++) {
+		if (pts[i].x < x_from)
+			x_from = pts[i].x;
+		if (pts[i].x > x_to)
+			x_to = pts[i].x;
+	}
+	if (x_from < 0)
+		x_from = 0;
+	if (x_to > OLED_WIDTH_(oled))
+		x_to = OLED_WIDTH_(oled);
+
+	int16_t cross[OLED_POLY_MAX];
+	for (int16_t x = x_from; x < x_to; x++) {
+		uint8_t nc = 0;
+		for (uint8_t i = 0; i < n; i++) {
+			const OLED_point *a = &pts[i];
+			const OLED_point *b = &pts[(i + 1 < n) ? i + 1 : 0];
+			if (a->x > b->x) {
+				const OLED_point *tmp = a;
+				a = b;
+				b = tmp;
+			}
+			if ((x < a->x) || (x >= b->x))
+				continue;
+			/* Crossing at x+0.5 is num / den */
+			int32_t den = 2 * (int32_t)(b->x - a->x);
+			int32_t num = a->y * den + (int32_t)(2 * (x - a->x) + 1) * (b->y - a->y);
+			int16_t c = OLED_floordiv_(2 * num + den - 1, 2 * den);
+			uint8_t j = nc++;
+			for (; j && (cross[j - 1] > c); j--)
+				cross[j] = cross[j - 1];
+			cross[j] = c;
+		}
+		for (uint8_t i = 0; i + 1 < nc; i += 2)
+			OLED_vspan_(oled, x, cross[i], cross[i + 1] - 1, params);
+	}
+}
+
+
+OLED_err OLED_put_line(OLED *oled, int16_t x0, int16_t y0, int16_t x1, int16_t y1, enum OLED_params params)
+{
+	if ((params & ~(OLED_BLACK | OLED_XOR)) || !OLED_coord_ok_(x0) || !OLED_coord_ok_(y0)
+	    || !OLED_coord_ok_(x1) || !OLED_coord_ok_(y1))
+		return OLED_EPARAMS;
+	OLED_I2CWRAP(
+		if (OLED_is_banded_(oled))
+			return OLED_dl_line_(oled, x0, y0, x1, y1, params);
+	)
+	if (OLED_is_turned_(oled))
+		OLED_line_(oled, OLED_WIDTH_(oled) - 1 - y0, x0, OLED_WIDTH_(oled) - 1 - y1, x1, false, params);
+	else
+		OLED_line_(oled, x0, y0, x1, y1, false, params);
+	return OLED_EOK;
+}
+
+
+OLED_err OLED_put_circle(OLED *oled, int16_t x, int16_t y, uint8_t r, enum OLED_params params)
+{
+	if ((params & ~(OLED_BLACK | OLED_FILL | OLED_XOR)) || !OLED_coord_ok_(x) || !OLED_coord_ok_(y))
+		return OLED_EPARAMS;
+	OLED_I2CWRAP(
+		if (OLED_is_banded_(oled))
+			return OLED_dl_circle_(oled, x, y, r, params);
+	)
+	if (OLED_is_turned_(oled))
+		OLED_circle_(oled, OLED_WIDTH_(oled) - 1 - y, x, r, params);
+	else
+		OLED_circle_(oled, x, y, r, params);
+	return OLED_EOK;
+}
+
+
+OLED_err OLED_put_polygon(OLED *oled, const OLED_point *pts, uint8_t n, enum OLED_params params)
+{
+	if ((params & ~(OLED_BLACK | OLED_FILL | OLED_XOR)) || (n < 3) || (n > OLED_POLY_MAX))
+		return OLED_EPARAMS;
+	for (uint8_t i = 0; i < n; i++) {
+		if (!OLED_coord_ok_(pts[i].x) || !OLED_coord_ok_(pts[i].y))
+			return OLED_EPARAMS;
+	}
+	OLED_I2CWRAP(
+		if (OLED_is_banded_(oled))
+			return OLED_dl_poly_(oled, pts, n, params);
+	)
+	if (OLED_is_turned_(oled)) {
+		/* Fill takes vertices as corners of pixels, outline as pixels */
+		OLED_point turned[OLED_POLY_MAX];
+		int16_t right = OLED_WIDTH_(oled) - !(OLED_FILL & params);
+		for (uint8_t i = 0; i < n; i++) {
+			turned[i].x = right - pts[i].y;
+			turned[i].y = pts[i].x;
+		}
+		OLED_polygon_(oled, turned, n, params);
+	} else {
+		OLED_polygon_(oled, pts, n, params);
+	}
+	return OLED_EOK;
+}
+
+
+OLED_err OLED_put_triangle(OLED *oled, int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+			   int16_t x2, int16_t y2, enum OLED_params params)
+{
+	OLED_point pts[3] = {{x0, y0}, {x1, y1}, {x2, y2}};
+	return OLED_put_polygon(oled, pts, 3, params);
+}
+
+
+/***** Strip chart *****/
+OLED_err OLED_chart_init(OLED *oled, OLED_chart *chart, uint8_t x_from, uint8_t page_from,
+			 uint8_t x_to, uint8_t page_to, enum OLED_params params)
+{
+	if ((NULL == oled->frame_buffer) || OLED_is_turned_(oled) || (x_from >= x_to) || (x_to >= OLED_WIDTH_(oled))
+	    || (page_from > page_to) || (page_to >= OLED_HEIGHT_(oled) / 8) || (params & ~OLED_BLACK))
+		return OLED_EPARAMS;
+	chart->oled = oled;
+	chart->x_from = x_from;
+	chart->x_to = x_to;
+	chart->page_from = page_from;
+	chart->page_to = page_to;
+	chart->last = 0xFF;
+	chart->params = params;
+	OLED_fill_area_(oled, x_from, page_from * 8, x_to, page_to * 8 + 7, params ^ OLED_BLACK);
+	return OLED_EOK;
+}
+
+
+void OLED_chart_push(OLED_chart *chart, uint8_t value)
+{
+	OLED *oled = chart->oled;
+	uint8_t rows = (chart->page_to - chart->page_from + 1) * 8;
+	if (value >= rows)
+		value = rows - 1;
+
+	/* Whole area goes a column left, the new one gets background */
+	uint8_t ncols = chart->x_to - chart->x_from;
+	uint8_t bg = (OLED_BLACK & chart->params) ? 0x00 : 0xFF;
+	uint8_t *row = &oled->frame_buffer[chart->page_from * (uint16_t)OLED_WIDTH_(oled) + chart->x_from];
+	for (uint8_t page = chart->page_from; page <= chart->page_to; page++) {
+		memmove(row, row + 1, ncols);
+		row[ncols] = bg;
+		OLED_mark_dirty_(oled, page, chart->x_from, chart->x_to);
+		row += OLED_WIDTH_(oled);
+	}
+
+	/* Span from the previous value joins trace */
+	uint8_t from = value, to = value;
+	if (chart->last != 0xFF) {
+		if (chart->last < value)
+			from = chart->last;
+		else
+			to = chart->last;
+	}
+	uint8_t bottom = chart->page_to * 8 + 7;
+	OLED_fill_area_(oled, chart->x_to, bottom - to, chart->x_to, bottom - from, chart->params);
+	chart->last = value;
+}
+
+
+/***** Page blitter and text *****/
+static inline ALWAYSINLINE uint8_t OLED_src_byte_(const uint8_t *src, bool is_pgm)
+{
+	return is_pgm ? pgm_read_byte(src) : *src;
+}
+
+
+/* Positive shift moves bits to the bottom of page, negative one to the top */
+static inline ALWAYSINLINE uint8_t OLED_shift_(uint8_t byte, int8_t shift)
+{
+	return (shift >= 0) ? (uint8_t)(byte << shift) : (byte >> -shift);
+}
+
+
+/* Applies mode to ncols bytes of one destination page row. Only bits set in
+ * region (and in mask, if any) are changed. Inlined with constant mode by
+ * OLED_blit_row_, so the choice of operation is not made for each byte
+ */
+static inline ALWAYSINLINE void OLED_blit_row_op_(uint8_t *dst, const uint8_t *src, const uint8_t *mask,
+						  uint8_t ncols, bool is_pgm, enum OLED_blit_mode mode,
+						  uint8_t region, int8_t shift)
+{
+	uint8_t inv = (OLED_BLIT_COPYINV == mode) ? 0xFF : 0x00;
+	for (uint8_t i = 0; i < ncols; i++) {
+		uint8_t m = region;
+		if (NULL != mask)
+			m &= OLED_shift_(OLED_src_byte_(&mask[i], is_pgm), shift);
+		uint8_t s = OLED_shift_(OLED_src_byte_(&src[i], is_pgm) ^ inv, shift) & m;
+		switch (mode) {
+		case OLED_BLIT_COPY:
+		case OLED_BLIT_COPYINV:
+			dst[i] = (dst[i] & ~m) | s;
+			break;
+		case OLED_BLIT_OR:
+			dst[i] |= s;
+			break;
+		case OLED_BLIT_ANDNOT:
+			dst[i] &= ~s;
+			break;
+		case OLED_BLIT_XOR:
+			dst[i] ^= s;
+			break;
+		}
+	}
+}
+
+
+static void OLED_blit_row_(uint8_t *dst, const uint8_t *src, const uint8_t *mask, uint8_t ncols,
+			   bool is_pgm, enum OLED_blit_mode mode, uint8_t region, int8_t shift)
+{
+	switch (mode) {
+	case OLED_BLIT_COPY:
+		OLED_blit_row_op_(dst, src, mask, ncols, is_pgm, OLED_BLIT_COPY, region, shift);
+		break;
+	case OLED_BLIT_OR:
+		OLED_blit_row_op_(dst, src, mask, ncols, is_pgm, OLED_BLIT_OR, region, shift);
+		break;
+	case OLED_BLIT_ANDNOT:
+		OLED_blit_row_op_(dst, src, mask, ncols, is_pgm, OLED_BLIT_ANDNOT, region, shift);
+		break;
+	case OLED_BLIT_XOR:
+		OLED_blit_row_op_(dst, src, mask, ncols, is_pgm, OLED_BLIT_XOR, region, shift);
+		break;
+	case OLED_BLIT_COPYINV:
+		OLED_blit_row_op_(dst, src, mask, ncols, is_pgm, OLED_BLIT_COPYINV, region, shift);
+		break;
+	}
+}
+
+
+/* Common part of OLED_blit and OLED_blit_P, without checks of mode.
+ * Returns false if bitmap is entirely out of display bounds.
+ * When y is page-aligned, each source page maps to a single destination page,
+ * and unmasked full pages are copied with memcpy(_P). Otherwise each source
+ * page is shifted across two destination pages
+ */
+static bool OLED_blit_(OLED *oled, int16_t x, int16_t y, uint8_t w, uint8_t h, const uint8_t *src,
+		       const uint8_t *mask, bool is_pgm, enum OLED_blit_mode mode)
+{
+	if ((x >= OLED_WIDTH_(oled)) || (y >= OLED_HEIGHT_(oled)) || (x + w <= 0) || (y + h <= 0))
+		return false;
+
+	/* Columns left of display are skipped in source */
+	uint8_t col_skip = (x < 0) ? -x : 0;
+	uint8_t x_from = x + col_skip;
+	uint8_t ncols = w - col_skip;
+	if (ncols > OLED_WIDTH_(oled) - x_from)
+		ncols = OLED_WIDTH_(oled) - x_from;
+	uint8_t x_to = x_from + ncols - 1;
+	src += col_skip;
+	if (NULL != mask)
+		mask += col_skip;
+
+	/* y > -256 here, so floor division is done on positive numbers */
+	int8_t page = (y + 256) / 8 - 32;
+	uint8_t shift = (y + 256) % 8;
+	uint8_t num_src_pages = (h + 7) / 8;
+	int8_t num_dst_pages = OLED_HEIGHT_(oled) / 8;
+
+	for (uint8_t sp = 0; (sp < num_src_pages) && (page < num_dst_pages); sp++, page++) {
+		uint8_t region = 0xFF;
+		if ((sp == num_src_pages - 1) && (h % 8))
+			region = 0xFF >> (8 - h % 8);
+		uint8_t *row = &oled->frame_buffer[page * (int16_t)OLED_WIDTH_(oled) + x_from];
+
+		if (!shift && (page >= 0)) {
+			if ((0xFF == region) && (NULL == mask) && (OLED_BLIT_COPY == mode)) {
+				if (is_pgm)
+					memcpy_P(row, src, ncols);
+				else
+					memcpy(row, src, ncols);
+			} else {
+				OLED_blit_row_(row, src, mask, ncols, is_pgm, mode, region, 0);
+			}
+			OLED_mark_dirty_(oled, page, x_from, x_to);
+		} else if (shift) {
+			/* Upper part of source page goes to the bottom of this page, */
+			/* its lower part to the top of the next one. Pages above the */
+			/* display (y < 0) gets nothing				      */
+			if (page >= 0) {
+				OLED_blit_row_(row, src, mask, ncols, is_pgm, mode, (uint8_t)(region << shift), shift);
+				OLED_mark_dirty_(oled, page, x_from, x_to);
+			}
+			uint8_t region_next = region >> (8 - shift);
+			if (region_next && (page + 1 >= 0) && (page + 1 < num_dst_pages)) {
+				OLED_blit_row_(row + OLED_WIDTH_(oled), src, mask, ncols, is_pgm, mode, region_next, shift - 8);
+				OLED_mark_dirty_(oled, page + 1, x_from, x_to);
+			}
+		}
+		src += w;
+		if (NULL != mask)
+			mask += w;
+	}
+	return true;
+}
+
+
+/* 8x8 bit matrix transpose (Hacker's Delight, 7-3) of page bytes: bit i of
+ * out[j] is bit 7 - j of in[i]. A block of drawing turned by a quarter is
+ * then a block of frame buffer, with columns of drawing made its rows
+ */
+static void OLED_transpose8_(const uint8_t *in, uint8_t *out)
+{
+	uint32_t hi = ((uint32_t)in[7] << 24) | ((uint32_t)in[6] << 16) | ((uint16_t)in[5] << 8) | in[4];
+	uint32_t lo = ((uint32_t)in[3] << 24) | ((uint32_t)in[2] << 16) | ((uint16_t)in[1] << 8) | in[0];
+	uint32_t t;
+	/* Swap 1x1, then 2x2 bit blocks within 4x4 halves, then 4x4 blocks */
+	t = (hi ^ (hi >> 7)) & 0x00AA00AA;
+	hi ^= t ^ (t << 7);
+	t = (lo ^ (lo >> 7)) & 0x00AA00AA;
+	lo ^= t ^ (t << 7);
+	t = (hi ^ (hi >> 14)) & 0x0000CCCC;
+	hi ^= t ^ (t << 14);
+	t = (lo ^ (lo >> 14)) & 0x0000CCCC;
+	lo ^= t ^ (t << 14);
+	t = (hi & 0xF0F0F0F0) | ((lo >> 4) & 0x0F0F0F0F);
+	lo = ((hi << 4) & 0xF0F0F0F0) | (lo & 0x0F0F0F0F);
+	out[0] = t >> 24;
+	out[1] = t >> 16;
+	out[2] = t >> 8;
+	out[3] = t;
+	out[4] = lo >> 24;
+	out[5] = lo >> 16;
+	out[6] = lo >> 8;
+	out[7] = lo;
+}
+
+
+/* OLED_blit_ on drawing turned by a quarter. Bitmap is cut into 8x8 blocks,
+ * block at (u, v) of drawing is transposed into one at column
+ * width - 8 - v, row u of frame buffer and blitted there. Blocks on the
+ * right and bottom edges of bitmap are padded, with padding masked out
+ */
+static bool OLED_blit_turned_(OLED *oled, int16_t x, int16_t y, uint8_t w, uint8_t h, const uint8_t *src,
+			      const uint8_t *mask, bool is_pgm, enum OLED_blit_mode mode)
+{
+	if ((x >= OLED_draw_width_(oled)) || (y >= OLED_draw_height_(oled)) || (x + w <= 0) || (y + h <= 0))
+		return false;
+
+	uint8_t num_src_pages = (h + 7) / 8;
+	for (uint8_t sp = 0; sp < num_src_pages; sp++) {
+		int16_t v = y + 8 * sp;
+		if (v + 8 <= 0)
+			continue;
+		if (v >= OLED_draw_height_(oled))
+			break;
+		/* Rows of source page are columns 7..0 of block */
+		uint8_t nrows = ((sp == num_src_pages - 1) && (h % 8)) ? h % 8 : 8;
+		for (uint16_t bx = 0; bx < w; bx += 8) {
+			int16_t u = x + bx;
+			if (u + 8 <= 0)
+				continue;
+			if (u >= OLED_draw_width_(oled))
+				break;
+			uint8_t ncols = (w - bx < 8) ? w - bx : 8;
+			uint16_t offset = sp * (uint16_t)w + bx;
+			uint8_t in[8], out[8], out_mask[8];
+			for (uint8_t i = 0; i < 8; i++)
+				in[i] = (i < ncols) ? OLED_src_byte_(&src[offset + i], is_pgm) : 0x00;
+			OLED_transpose8_(in, out);
+
+			bool is_masked = (NULL != mask) || (ncols < 8) || (nrows < 8);
+			if (NULL != mask) {
+				uint8_t region = 0xFF >> (8 - nrows);
+				for (uint8_t i = 0; i < 8; i++)
+					in[i] = (i < ncols) ? OLED_src_byte_(&mask[offset + i], is_pgm) & region : 0x00;
+				OLED_transpose8_(in, out_mask);
+			} else if (is_masked) {
+				/* Columns of block are rows of source, rows are columns */
+				for (uint8_t j = 0; j < 8; j++)
+					out_mask[j] = (j >= 8 - nrows) ? 0xFF >> (8 - ncols) : 0x00;
+			}
+			OLED_blit_(oled, OLED_WIDTH_(oled) - 8 - v, u, 8, 8, out, is_masked ? out_mask : NULL, false, mode);
+		}
+	}
+	return true;
+}
+
+
+OLED_err OLED_blit(OLED *oled, int16_t x, int16_t y, uint8_t w, uint8_t h, const uint8_t *bitmap,
+		   const uint8_t *mask, enum OLED_blit_mode mode)
+{
+	if (mode > OLED_BLIT_COPYINV)
+		return OLED_EPARAMS;
+	OLED_I2CWRAP(
+		if (OLED_is_banded_(oled)) {
+			if ((x >= OLED_WIDTH_(oled)) || (y >= OLED_HEIGHT_(oled)) || (x + w <= 0) || (y + h <= 0))
+				return OLED_EBOUNDS;
+			return OLED_dl_blit_(oled, x, y, w, h, bitmap, mask, false, mode);
+		}
+	)
+	if (OLED_is_turned_(oled)) {
+		if (!OLED_blit_turned_(oled, x, y, w, h, bitmap, mask, false, mode))
+			return OLED_EBOUNDS;
+	} else if (!OLED_blit_(oled, x, y, w, h, bitmap, mask, false, mode)) {
+		return OLED_EBOUNDS;
+	}
+	return OLED_EOK;
+}
+
+
+OLED_err OLED_blit_P(OLED *oled, int16_t x, int16_t y, uint8_t w, uint8_t h, const uint8_t *bitmap,
+		     const uint8_t *mask, enum OLED_blit_mode mode)
+{
+	if (mode > OLED_BLIT_COPYINV)
+		return OLED_EPARAMS;
+	OLED_I2CWRAP(
+		if (OLED_is_banded_(oled)) {
+			if ((x >= OLED_WIDTH_(oled)) || (y >= OLED_HEIGHT_(oled)) || (x + w <= 0) || (y + h <= 0))
+				return OLED_EBOUNDS;
+			return OLED_dl_blit_(oled, x, y, w, h, bitmap, mask, true, mode);
+		}
+	)
+	if (OLED_is_turned_(oled)) {
+		if (!OLED_blit_turned_(oled, x, y, w, h, bitmap, mask, true, mode))
+			return OLED_EBOUNDS;
+	} else if (!OLED_blit_(oled, x, y, w, h, bitmap, mask, true, mode)) {
+		return OLED_EBOUNDS;
+	}
+	return OLED_EOK;
+}
+
+
+/* Finds glyph of character in font. Font descriptor is a copy in RAM.
+ * Returns glyph width, or 0 if font has no such glyph
+ */
+static uint8_t OLED_font_glyph_(const OLED_font *font, uint8_t c, const uint8_t **bitmap)
+{
+	if ((c < font->first) || (c > font->last))
+		return 0;
+	uint8_t idx = c - font->first;
+	if (font->width) {
+		*bitmap = font->bitmaps + idx * (uint16_t)(font->width * ((font->height + 7) / 8));
+		return font->width;
+	}
+	*bitmap = font->bitmaps + pgm_read_word(&font->offsets[idx]);
+	return pgm_read_byte(&font->widths[idx]);
+}
+
+
+/* Draws glyph and spacing after it. x must lie within display bounds, y may
+ * be out of them (glyph is clipped). Returns x advance, or 0 if font has no
+ * such glyph
+ */
+static uint8_t OLED_put_glyph_(OLED *oled, const OLED_font *font, uint8_t x, int16_t y, uint8_t c,
+			       enum OLED_params params)
+{
+	const uint8_t *bitmap;
+	uint8_t w = OLED_font_glyph_(font, c, &bitmap);
+	if (!w)
+		return 0;
+
+	bool color = (OLED_BLACK & params) != 0;
+	enum OLED_blit_mode mode;
+	if (OLED_XOR & params) {
+		mode = OLED_BLIT_XOR;
+		params &= ~OLED_FILL;
+	} else if (OLED_FILL & params)
+		mode = color ? OLED_BLIT_COPY : OLED_BLIT_COPYINV;
+	else
+		mode = color ? OLED_BLIT_OR : OLED_BLIT_ANDNOT;
+	if (OLED_is_turned_(oled))
+		OLED_blit_turned_(oled, x, y, w, font->height, bitmap, NULL, true, mode);
+	else
+		OLED_blit_(oled, x, y, w, font->height, bitmap, NULL, true, mode);
+
+	/* Spacing is the background of glyph, so it is only drawn with fill */
+	uint8_t width = OLED_draw_width_(oled);
+	uint16_t sp_from = x + w;
+	int16_t y_from = (y > 0) ? y : 0;
+	int16_t y_to = y + font->height - 1;
+	if (y_to >= OLED_draw_height_(oled))
+		y_to = OLED_draw_height_(oled) - 1;
+	if ((OLED_FILL & params) && font->spacing && (sp_from < width) && (y_from <= y_to)) {
+		uint16_t sp_to = sp_from + font->spacing - 1;
+		OLED_fill_turned_(oled, sp_from, y_from, (sp_to < width) ? sp_to : width - 1,
+				  y_to, color ? OLED_WHITE : OLED_BLACK);
+	}
+	return w + font->spacing;
+}
+
+
+/* Draws at most len characters of string, stopping at its end or right edge
+ * of display. Font descriptor is a copy in RAM
+ */
+static void OLED_text_(OLED *oled, const OLED_font *font, uint8_t x, int16_t y, const char *str,
+		       uint8_t len, bool is_pgm, enum OLED_params params)
+{
+	uint16_t pos = x;
+	uint8_t c;
+	while (len-- && (pos < OLED_draw_width_(oled)) && (c = OLED_src_byte_((const uint8_t *)str++, is_pgm)))
+		pos += OLED_put_glyph_(oled, font, pos, y, c, params);
+}
+
+
+OLED_err OLED_put_char(OLED *oled, const OLED_font *font, uint8_t x, uint8_t y, char c, enum OLED_params params)
+{
+	if (params & ~(OLED_BLACK | OLED_FILL | OLED_XOR))
+		return OLED_EPARAMS;
+	if ((x >= OLED_draw_width_(oled)) || (y >= OLED_draw_height_(oled)))
+		return OLED_EBOUNDS;
+	OLED_font f;
+	memcpy_P(&f, font, sizeof f);
+	const uint8_t *bitmap;
+	if (!OLED_font_glyph_(&f, c, &bitmap))
+		return OLED_EPARAMS;
+	OLED_I2CWRAP(
+		if (OLED_is_banded_(oled))
+			return OLED_dl_text_(oled, font, &f, x, y, &c, 1, false, params);
+	)
+	OLED_put_glyph_(oled, &f, x, y, c, params);
+	return OLED_EOK;
+}
+
+
+/* Common part of OLED_put_string and OLED_put_string_P */
+static OLED_err OLED_put_string_(OLED *oled, const OLED_font *font, uint8_t x, uint8_t y, const char *str,
+				 bool is_pgm, enum OLED_params params)
+{
+	if (params & ~(OLED_BLACK | OLED_FILL | OLED_XOR))
+		return OLED_EPARAMS;
+	if ((x >= OLED_draw_width_(oled)) || (y >= OLED_draw_height_(oled)))
+		return OLED_EBOUNDS;
+	OLED_font f;
+	memcpy_P(&f, font, sizeof f);
+	OLED_I2CWRAP(
+		if (OLED_is_banded_(oled)) {
+			size_t len = is_pgm ? strlen_P(str) : strlen(str);
+			return OLED_dl_text_(oled, font, &f, x, y, str, (len < 0xFF) ? len : 0xFF, is_pgm, params);
+		}
+	)
+	OLED_text_(oled, &f, x, y, str, 0xFF, is_pgm, params);
+	return OLED_EOK;
+}
+
+
+OLED_err OLED_put_string(OLED *oled, const OLED_font *font, uint8_t x, uint8_t y, const char *str, enum OLED_params params)
+{
+	return OLED_put_string_(oled, font, x, y, str, false, params);
+}
+
+
+OLED_err OLED_put_string_P(OLED *oled, const OLED_font *font, uint8_t x, uint8_t y, PGM_P str, enum OLED_params params)
+{
+	return OLED_put_string_(oled, font, x, y, str, true, params);
+}
+
+
+uint16_t OLED_string_width(const OLED_font *font, const char *str)
+{
+	OLED_font f;
+	memcpy_P(&f, font, sizeof f);
+	uint16_t width = 0;
+	const uint8_t *bitmap;
+	for (; *str; str++) {
+		uint8_t w = OLED_font_glyph_(&f, *str, &bitmap);
+		if (w)
+			width += w + f.spacing;
+	}
+	/* Spacing after the last glyph is not a part of string */
+	return (width > f.spacing) ? width - f.spacing : 0;
+}
+
+
+
+#if !defined(OLED_NO_I2C)
+/***** Scroll console *****/
+/* Line is a page of GDDRAM. Display start line points to the page after the
+ * newest line, so it is shown at the bottom and the oldest one at the top
+ */
+static void OLED_cbk_unlock(void *args)
+{
+	OLED_unlock(args);
+}
+
+
+/* Called from ISR after line has been sent. Moves start line */
+static void OLED_cbk_console_line(void *args)
+{
+	OLED *oled = args;
+	while(!OLED_i2c_tx_shed(oled->i2c_addr, oled->cmd_startline, OLED_ARR_SIZE(_i2c_cmd_startline),
+				NULL, 0, &OLED_cbk_unlock, oled, false)) {
+		// nop
+	}
+}
+
+
+OLED_err OLED_console_init(OLED *oled, OLED_console *con, const OLED_font *font, enum OLED_params params)
+{
+	/* Start line wraps at GDDRAM row 64, so lines must fill all of it */
+	if ((NULL == oled->frame_buffer) || (NULL != oled->front_buffer) || (oled->num_pages != OLED_MAX_PAGES)
+	    || OLED_is_turned_(oled)
+	    || (pgm_read_byte(&font->height) > 8) || (params & ~OLED_BLACK))
+		return OLED_EPARAMS;
+	con->oled = oled;
+	con->font = font;
+	con->params = params;
+	con->top = 0;
+	OLED_WITH_SPINLOCK(oled) {
+		memset(oled->frame_buffer, (params & OLED_BLACK) ? 0x00 : 0xFF,
+		       oled->num_pages * (uint16_t)OLED_WIDTH_(oled));
+	}
+	OLED_cmd_startline(oled, 0);
+	OLED_refresh(oled);
+	return OLED_EOK;
+}
+
+
+/* Common part of OLED_console_puts and OLED_console_puts_P */
+static void OLED_console_puts_(OLED_console *con, const char *str, bool is_pgm)
+{
+	OLED *oled = con->oled;
+	OLED_font f;
+	memcpy_P(&f, con->font, sizeof f);
+	/* Waits for the previous line, as its commands are in oled buffers */
+	OLED_spinlock(oled);
+
+	uint8_t page = con->top;
+	uint8_t *line = &oled->frame_buffer[page * (uint16_t)OLED_WIDTH_(oled)];
+	memset(line, (con->params & OLED_BLACK) ? 0x00 : 0xFF, OLED_WIDTH_(oled));
+	OLED_text_(oled, &f, 0, page * 8, str, 0xFF, is_pgm, con->params);
+	/* Whole page is sent right now */
+	oled->dirty_from[page] = 0xFF;
+	oled->dirty_to[page] = 0;
+	if (++con->top >= oled->num_pages)
+		con->top = 0;
+
+	memcpy(oled->cmd_startline, _i2c_cmd_startline, OLED_ARR_SIZE(_i2c_cmd_startline));
+	oled->cmd_startline[1] |= (con->top * 8) & 0x3F;
+	oled->refresh_bytes = OLED_WIDTH_(oled);
+	uint8_t prefix_len = OLED_setspan_(oled, oled->cmd, 0, OLED_WIDTH_(oled), page);
+	while(!OLED_i2c_tx_shed(oled->i2c_addr, oled->cmd, prefix_len, line, OLED_WIDTH_(oled),
+				&OLED_cbk_console_line, oled, false)) {
+		// nop
+	}
+	/* Lock is released when start line has been moved */
+}
+
+
+void OLED_console_puts(OLED_console *con, const char *str)
+{
+	OLED_console_puts_(con, str, false);
+}
+
+
+void OLED_console_puts_P(OLED_console *con, PGM_P str)
+{
+	OLED_console_puts_(con, str, true);
+}
+#endif // OLED_NO_I2C
+
+
+
+#if !defined(OLED_NO_I2C)
+/***** Banded rendering *****/
+/* Display list is a sequence of records. Each one starts with a byte of
+ * (op << 4 | params), followed by op payload (see enum OLED_dl_op_). Pointers
+ * in payloads are kept as is, so they must stay valid while list is used
+ */
+struct OLED_dl_rect_ {
+	uint8_t x_from, y_from, x_to, y_to;
+};
+
+struct OLED_dl_text_ {
+	const OLED_font *font;
+	const char *str;	/* Only for OLED_DL_TEXT_P_	*/
+	uint8_t x, y;
+	uint8_t len;		/* Only for OLED_DL_TEXT_	*/
+};
+
+struct OLED_dl_blit_ {
+	const uint8_t *bitmap;
+	const uint8_t *mask;
+	int16_t x, y;
+	uint8_t w, h;
+};
+
+struct OLED_dl_line_ {
+	int16_t x0, y0, x1, y1;
+};
+
+struct OLED_dl_circle_ {
+	int16_t x, y;
+	uint8_t r;
+};
+
+
+/* Appends record to display list. Payload of text is followed by characters */
+static OLED_err OLED_dl_add_(OLED *oled, uint8_t op, uint8_t params, const void *payload, uint8_t len,
+			     const void *chars, uint8_t chars_len)
+{
+	if (oled->dl_size - oled->dl_len < 1 + len + chars_len)
+		return OLED_ENOMEM;
+	uint8_t *rec = &oled->dl[oled->dl_len];
+	rec[0] = (op << 4) | params;
+	memcpy(&rec[1], payload, len);
+	if (chars_len)
+		memcpy(&rec[1 + len], chars, chars_len);
+	oled->dl_len += 1 + len + chars_len;
+	return OLED_EOK;
+}
+
+
+static OLED_err OLED_dl_rect_(OLED *oled, uint8_t op, uint8_t x_from, uint8_t y_from,
+			      uint8_t x_to, uint8_t y_to, uint8_t params)
+{
+	struct OLED_dl_rect_ r = {x_from, y_from, x_to, y_to};
+	OLED_err err = OLED_dl_add_(oled, op, params, &r, (OLED_DL_PIXEL_ == op) ? 2 : sizeof r, NULL, 0);
+	if (OLED_EOK == err)
+		OLED_mark_dirty(oled, x_from, y_from, x_to, y_to);
+	return err;
+}
+
+
+static OLED_err OLED_dl_text_(OLED *oled, const OLED_font *font, const OLED_font *f, uint8_t x, uint8_t y,
+			      const char *str, uint8_t len, bool is_pgm, uint8_t params)
+{
+	struct OLED_dl_text_ t = {.font = font, .str = str, .x = x, .y = y, .len = len};
+	OLED_err err;
+	if (is_pgm)
+		err = OLED_dl_add_(oled, OLED_DL_TEXT_P_, params, &t, sizeof t, NULL, 0);
+	else
+		err = OLED_dl_add_(oled, OLED_DL_TEXT_, params, &t, sizeof t, str, len);
+	if (OLED_EOK != err)
+		return err;
+
+	/* Text is clipped by the right edge, so width stops growing there */
+	uint16_t x_to = x;
+	const uint8_t *bitmap;
+	for (uint8_t i = 0; (i < len) && (x_to < OLED_WIDTH_(oled)); i++) {
+		uint8_t w = OLED_font_glyph_(f, OLED_src_byte_((const uint8_t *)&str[i], is_pgm), &bitmap);
+		if (w)
+			x_to += w + f->spacing;
+	}
+	if (x_to > x)
+		OLED_mark_dirty(oled, x, y, (x_to < OLED_WIDTH_(oled)) ? x_to - 1 : OLED_WIDTH_(oled) - 1,
+				(y + f->height - 1 < OLED_HEIGHT_(oled)) ? y + f->height - 1 : OLED_HEIGHT_(oled) - 1);
+	return OLED_EOK;
+}
+
+
+static OLED_err OLED_dl_blit_(OLED *oled, int16_t x, int16_t y, uint8_t w, uint8_t h, const uint8_t *bitmap,
+			      const uint8_t *mask, bool is_pgm, enum OLED_blit_mode mode)
+{
+	struct OLED_dl_blit_ b = {bitmap, mask, x, y, w, h};
+	OLED_err err = OLED_dl_add_(oled, is_pgm ? OLED_DL_BLIT_P_ : OLED_DL_BLIT_, mode, &b, sizeof b, NULL, 0);
+	if (OLED_EOK == err)
+		OLED_mark_dirty(oled, (x > 0) ? x : 0, (y > 0) ? y : 0,
+				(x + w - 1 < OLED_WIDTH_(oled)) ? x + w - 1 : OLED_WIDTH_(oled) - 1,
+				(y + h - 1 < OLED_HEIGHT_(oled)) ? y + h - 1 : OLED_HEIGHT_(oled) - 1);
+	return err;
+}
+
+
+/* Marks bounding box of shape dirty, clipped by display bounds */
+static void OLED_mark_dirty_box_(OLED *oled, int16_t x_from, int16_t y_from, int16_t x_to, int16_t y_to)
+{
+	if ((x_to < 0) || (y_to < 0) || (x_from >= OLED_WIDTH_(oled)) || (y_from >= OLED_HEIGHT_(oled)))
+		return;
+	OLED_mark_dirty(oled, (x_from > 0) ? x_from : 0, (y_from > 0) ? y_from : 0,
+			(x_to < OLED_WIDTH_(oled)) ? x_to : OLED_WIDTH_(oled) - 1,
+			(y_to < OLED_HEIGHT_(oled)) ? y_to : OLED_HEIGHT_(oled) - 1);
+}
+
+
+static OLED_err OLED_dl_line_(OLED *oled, int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t params)
+{
+	struct OLED_dl_line_ l = {x0, y0, x1, y1};
+	OLED_err err = OLED_dl_add_(oled, OLED_DL_LINE_, params, &l, sizeof l, NULL, 0);
+	if (OLED_EOK == err)
+		OLED_mark_dirty_box_(oled, (x0 < x1) ? x0 : x1, (y0 < y1) ? y0 : y1,
+				     (x0 > x1) ? x0 : x1, (y0 > y1) ? y0 : y1);
+	return err;
+}
+
+
+static OLED_err OLED_dl_circle_(OLED *oled, int16_t x, int16_t y, uint8_t r, uint8_t params)
+{
+	struct OLED_dl_circle_ c = {x, y, r};
+	OLED_err err = OLED_dl_add_(oled, OLED_DL_CIRCLE_, params, &c, sizeof c, NULL, 0);
+	if (OLED_EOK == err)
+		OLED_mark_dirty_box_(oled, x - r, y - r, x + r, y + r);
+	return err;
+}
+
+
+/* Vertices are copied to the list, like characters of text */
+static OLED_err OLED_dl_poly_(OLED *oled, const OLED_point *pts, uint8_t n, uint8_t params)
+{
+	OLED_err err = OLED_dl_add_(oled, OLED_DL_POLY_, params, &n, 1, pts, n * sizeof *pts);
+	if (OLED_EOK != err)
+		return err;
+	int16_t x_from = pts[0].x, y_from = pts[0].y, x_to = pts[0].x, y_to = pts[0].y;
+	for (uint8_t i = 1; i < n; i++) {
+		if (pts[i].x < x_from)
+			x_from = pts[i].x;
+		if (pts[i].x > x_to)
+			x_to = pts[i].x;
+		if (pts[i].y < y_from)
+			y_from = pts[i].y;
+		if (pts[i].y > y_to)
+			y_to = pts[i].y;
+	}
+	OLED_mark_dirty_box_(oled, x_from, y_from, x_to, y_to);
+	return OLED_EOK;
+}
+
+
+/* Draws rectangle record on band, which holds rows [top..top+7] */
+static void OLED_raster_rect_(OLED *band, int16_t top, const struct OLED_dl_rect_ *r, uint8_t params)
+{
+	int16_t y_from = r->y_from - top;
+	int16_t y_to = r->y_to - top;
+	if ((y_to < 0) || (y_from > 7))
+		return;
+	uint8_t clip_from = (y_from > 0) ? y_from : 0;
+	uint8_t clip_to = (y_to < 7) ? y_to : 7;
+
+	if (OLED_FILL & params) {
+		OLED_fill_area_(band, r->x_from, clip_from, r->x_to, clip_to, params);
+		return;
+	}
+	/* Horizontal edges only if they are on band, vertical ones are clipped
+	 * and skip rows of horizontal ones, like OLED_put_rectangle does
+	 */
+	if (y_from >= 0)
+		OLED_fill_area_(band, r->x_from, y_from, r->x_to, y_from, params);
+	if ((y_to <= 7) && (y_to != y_from))
+		OLED_fill_area_(band, r->x_from, y_to, r->x_to, y_to, params);
+	int16_t v_from = (y_from + 1 > 0) ? y_from + 1 : 0;
+	int16_t v_to = (y_to - 1 < 7) ? y_to - 1 : 7;
+	if (v_from <= v_to) {
+		OLED_fill_area_(band, r->x_from, v_from, r->x_from, v_to, params);
+		if (r->x_to != r->x_from)
+			OLED_fill_area_(band, r->x_to, v_from, r->x_to, v_to, params);
+	}
+}
+
+
+/* Renders page of display list into band of width bytes */
+static void OLED_dl_raster_(OLED *oled, uint8_t page, uint8_t *band)
+{
+	/* Band is drawn on as on a display 8 rows high, records are shifted */
+	OLED b = {
+		.width = OLED_WIDTH_(oled),
+		.height = 8,
+		.frame_buffer = band
+	};
+	int16_t top = page * 8;
+	memset(band, 0, OLED_WIDTH_(oled));
+
+	uint16_t pos = 0;
+	while (pos < oled->dl_len) {
+		uint8_t op = oled->dl[pos] >> 4;
+		uint8_t params = oled->dl[pos] & 0x0F;
+		const uint8_t *payload = &oled->dl[pos + 1];
+		switch (op) {
+		case OLED_DL_PIXEL_: {
+			struct OLED_dl_rect_ r;
+			memcpy(&r, payload, 2);
+			pos += 1 + 2;
+			if (r.y_from / 8 == page)
+				OLED_put_pixel_(&b, r.x_from, r.y_from - top, params);
+			break;
+		}
+		case OLED_DL_RECT_: {
+			struct OLED_dl_rect_ r;
+			memcpy(&r, payload, sizeof r);
+			pos += 1 + sizeof r;
+			OLED_raster_rect_(&b, top, &r, params);
+			break;
+		}
+		case OLED_DL_TEXT_:
+		case OLED_DL_TEXT_P_: {
+			struct OLED_dl_text_ t;
+			memcpy(&t, payload, sizeof t);
+			pos += 1 + sizeof t;
+			const char *str = t.str;
+			if (OLED_DL_TEXT_ == op) {
+				str = (const char *)&oled->dl[pos];
+				pos += t.len;
+			}
+			OLED_font f;
+			memcpy_P(&f, t.font, sizeof f);
+			if ((t.y - top < 8) && (t.y + f.height > top))
+				OLED_text_(&b, &f, t.x, t.y - top, str, t.len, OLED_DL_TEXT_P_ == op, params);
+			break;
+		}
+		case OLED_DL_BLIT_:
+		case OLED_DL_BLIT_P_: {
+			struct OLED_dl_blit_ bl;
+			memcpy(&bl, payload, sizeof bl);
+			pos += 1 + sizeof bl;
+			OLED_blit_(&b, bl.x, bl.y - top, bl.w, bl.h, bl.bitmap, bl.mask, OLED_DL_BLIT_P_ == op, params);
+			break;
+		}
+		/* Shapes are clipped exactly, so their parts on bands match */
+		case OLED_DL_LINE_: {
+			struct OLED_dl_line_ l;
+			memcpy(&l, payload, sizeof l);
+			pos += 1 + sizeof l;
+			OLED_line_(&b, l.x0, l.y0 - top, l.x1, l.y1 - top, false, params);
+			break;
+		}
+		case OLED_DL_CIRCLE_: {
+			struct OLED_dl_circle_ c;
+			memcpy(&c, payload, sizeof c);
+			pos += 1 + sizeof c;
+			OLED_circle_(&b, c.x, c.y - top, c.r, params);
+			break;
+		}
+		case OLED_DL_POLY_: {
+			OLED_point pts[OLED_POLY_MAX];
+			uint8_t n = payload[0];
+			memcpy(pts, &payload[1], n * sizeof *pts);
+			pos += 2 + n * sizeof *pts;
+			for (uint8_t i = 0; i < n; i++)
+				pts[i].y -= top;
+			OLED_polygon_(&b, pts, n, params);
+			break;
+		}
+		default:
+			return;		/* Corrupted list */
+		}
+	}
+}
+
+
+/* Called from ISR after band has been sent */
+static void OLED_cbk_band_sent(void *args)
+{
+	OLED *oled = args;
+	oled->bands_busy--;
+}
+
+
+static void OLED_cbk_band_last(void *args)
+{
+	OLED *oled = args;
+	oled->bands_busy--;
+	OLED_refresh_done_(oled);
+}
+
+
+static bool OLED_band_free_(OLED *oled)
+{
+	bool is_free;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		is_free = oled->bands_busy < oled->num_bands;
+	}
+	return is_free;
+}
+
+
+/* Rasterizes dirty pages one by one and sends their spans. With two bands,
+ * the next page is rasterized while the previous one is on the bus. Returns
+ * when the last page is queued. Must be called under lock, which is
+ * released when the last page has been sent
+ */
+static void OLED_refresh_banded_(OLED *oled)
+{
+	OLED_take_dirty_(oled);
+	uint8_t last = oled->num_pages;
+	for (uint8_t page = 0; page < oled->num_pages; page++) {
+		if (oled->tx_from[page] <= oled->tx_to[page])
+			last = page;
+	}
+	if (last >= oled->num_pages) {
+		OLED_refresh_done_(oled);
+		return;
+	}
+
+	uint8_t n = 0;
+	for (uint8_t page = 0; page <= last; page++) {
+		if (oled->tx_from[page] > oled->tx_to[page])
+			continue;
+		uint8_t *band = &oled->bands[n * (uint16_t)OLED_WIDTH_(oled)];
+		uint8_t *prefix = n ? oled->band_cmd[n - 1] : oled->cmd;
+		if (++n >= oled->num_bands)
+			n = 0;
+		/* Band is free when the page sent num_bands pages ago is done */
+		while (!OLED_band_free_(oled)) {
+			OLED_STATSWRAP(oled->stat_spin_waits++;)
+			OLED_WATCHDOG_();
+		}
+		OLED_dl_raster_(oled, page, band);
+
+		uint8_t col = oled->tx_from[page];
+		uint8_t ncols = oled->tx_to[page] - col + 1;
+		uint8_t prefix_len = OLED_setspan_(oled, prefix, col, ncols, page);
+		oled->refresh_bytes += ncols;
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			oled->bands_busy++;
+		}
+		while(!OLED_i2c_tx_shed(oled->i2c_addr, prefix, prefix_len, &band[col], ncols,
+					(page == last) ? &OLED_cbk_band_last : &OLED_cbk_band_sent, oled, false)) {
+			// nop
+		}
+	}
+}
+
+
+void __OLED_init_banded(OLED *oled, uint8_t *bands, uint8_t num_bands, uint8_t *dl, uint16_t dl_size)
+{
+	oled->bands = bands;
+	oled->num_bands = (num_bands > OLED_MAX_BANDS) ? OLED_MAX_BANDS : num_bands;
+	oled->bands_busy = 0;
+	oled->dl = dl;
+	oled->dl_size = dl_size;
+	oled->dl_len = 0;
+}
+
+
+void OLED_dl_clear(OLED *oled)
+{
+	oled->dl_len = 0;
+	OLED_mark_dirty_all(oled);
+}
+#endif // OLED_NO_I2C
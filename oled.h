@@ -20,9 +20,12 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
  * THE SOFTWARE.
  */
+#ifndef OLED_H_
+#define OLED_H_
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <assert.h>
@@ -33,8 +36,49 @@
 #endif
 
 #if !defined(OLED_NO_I2C) && !defined(OLED_CMDBUFFER_LEN)
-	#define OLED_CMDBUFFER_LEN 30
-	#warning "OLED: OLED_CMDBUFFER_LEN not set. Using " ##OLED_CMDBUFFER_LEN " as fallback"
+	#define OLED_CMDBUFFER_LEN 8
+	#warning "OLED: OLED_CMDBUFFER_LEN not set. Using 8 as fallback"
+#endif
+
+/* Queue slots which could only be taken by transaction end callbacks. Must */
+/* be not less than the number of refreshes which may run simultaneously   */
+#if !defined(OLED_NO_I2C) && !defined(OLED_CMDBUFFER_RESERVE)
+	#define OLED_CMDBUFFER_RESERVE 2
+#endif
+
+/* TWI transactions which got NACK or lost arbitration are sent again from  */
+/* the start this many times before they are dropped. Bus is recovered when */
+/* no TWI interrupt comes for OLED_I2C_WATCHDOG_SPINS waits of the library  */
+#if !defined(OLED_NO_I2C) && !defined(OLED_I2C_RETRIES)
+	#define OLED_I2C_RETRIES 3
+#endif
+#if !defined(OLED_NO_I2C) && !defined(OLED_I2C_WATCHDOG_SPINS)
+	#define OLED_I2C_WATCHDOG_SPINS 10000
+#endif
+/* TWI pins, used to clock a stuck slave out. ATmega328P ones by default */
+#if !defined(OLED_NO_I2C) && !defined(OLED_SPI) && !defined(OLED_TWI_PORT)
+	#define OLED_TWI_PORT PORTC
+	#define OLED_TWI_DDR DDRC
+	#define OLED_TWI_PIN PINC
+	#define OLED_TWI_SCL_BIT 5
+	#define OLED_TWI_SDA_BIT 4
+#endif
+
+/* Transport is TWI (I2C) by default. With OLED_SPI displays are connected
+ * over 4-wire SPI: SPI peripheral, or USART0 in master SPI mode if
+ * OLED_SPI_USART is defined too. Its transmitter is double buffered, so
+ * bytes follow each other without gaps. Everything else works the same,
+ * i2c_addr of OLED is then the number of its CS pin in OLED_SPI_CS_PORT.
+ * D/C pin is shared by all displays
+ */
+#if defined(OLED_SPI) && !defined(OLED_SPI_CS_PORT)
+	#define OLED_SPI_CS_PORT PORTB
+	#define OLED_SPI_CS_DDR DDRB
+#endif
+#if defined(OLED_SPI) && !defined(OLED_SPI_DC_PORT)
+	#define OLED_SPI_DC_PORT PORTB
+	#define OLED_SPI_DC_DDR DDRB
+	#define OLED_SPI_DC_BIT 1
 #endif
 
 #if defined(OLED_NO_I2C)
@@ -44,10 +88,47 @@
 	#define OLED_I2CWRAP(BLOCK) BLOCK
 #endif
 
+/* Performance counters are opt-in. Without OLED_STATS they cost nothing */
+#if defined(OLED_STATS) && !defined(OLED_NO_I2C)
+	#define OLED_STATSWRAP(BLOCK) BLOCK
+	/* 16-bit timer counting CPU cycles, used to measure time. If not set, */
+	/* Timer1 is started in normal mode with no prescaling by OLED_init    */
+	#if !defined(OLED_STATS_TCNT)
+		#define OLED_STATS_TCNT TCNT1
+		#define OLED_STATS_TIMER1_INIT
+	#endif
+#else
+	#define OLED_STATSWRAP(BLOCK)
+#endif
+
 #if !(defined(TWBR) && defined(TWSR) && defined(TWAR) && defined(TWDR)) && !defined(OLED_NO_I2C)
 	#error "OLED: AVR target has no TWI peripheral. I2C is required by lib"
 #endif
 
+/* Compile-time geometry. If all displays are of the same size, define both
+ * OLED_STATIC_WIDTH and OLED_STATIC_HEIGHT to it. Drawing then uses them
+ * instead of width and height of OLED, so that bounds are constants and
+ * frame buffer offsets are shifts. OLED_init checks its w and h against
+ * them. Banded rendering is not available, as it draws on 8-row bands
+ */
+#if defined(OLED_STATIC_WIDTH) != defined(OLED_STATIC_HEIGHT)
+	#error "OLED: OLED_STATIC_WIDTH and OLED_STATIC_HEIGHT go together"
+#endif
+#if defined(OLED_STATIC_WIDTH)
+	#define OLED_WIDTH_(oled) ((uint8_t)OLED_STATIC_WIDTH)
+	#define OLED_HEIGHT_(oled) ((uint8_t)OLED_STATIC_HEIGHT)
+	#define OLED_GEOMETRY_ASSERT_(w, h)							  \
+		_Static_assert(((w) == OLED_STATIC_WIDTH) && ((h) == OLED_STATIC_HEIGHT),	  \
+			       "OLED_init: w and h must be OLED_STATIC_WIDTH and OLED_STATIC_HEIGHT")
+	#define OLED_BANDED_ASSERT_()								  \
+		_Static_assert(0, "OLED_init_banded: not available with OLED_STATIC_WIDTH")
+#else
+	#define OLED_WIDTH_(oled) ((oled)->width)
+	#define OLED_HEIGHT_(oled) ((oled)->height)
+	#define OLED_GEOMETRY_ASSERT_(w, h) _Static_assert(1, "")
+	#define OLED_BANDED_ASSERT_() _Static_assert(1, "")
+#endif
+
 /* GCC provides special attribute, indicating that function is not only tried */
 /* to be inlined, but must be ALWAYS inlined instead.			      */
 #define ALWAYSINLINE __attribute__((__always_inline__))
@@ -58,7 +139,8 @@ typedef enum OLED_err_e_ {
 	OLED_EOK = 0,
 	OLED_EBOUNDS,	/* Pixel is out of display bounds 	*/
 	OLED_EPARAMS,	/* Wrong parameters specified		*/
-	OLED_EBUSY	/* Indicates display is busy (locked)	*/
+	OLED_EBUSY,	/* Indicates display is busy (locked)	*/
+	OLED_ENOMEM	/* No room left in display list		*/
 } OLED_err;
 
 enum OLED_params {
@@ -66,37 +148,241 @@ enum OLED_params {
 	OLED_WHITE = 0x00,		/* Alias for 0 as color	      */
 	OLED_BLACK = 0x01,		/* Alias for 1 as color	      */
 	OLED_NO_FILL = 0x00,		/* Do not fill the drawn area */
-	OLED_FILL = 0x02		/* Fill the area	      */
+	OLED_FILL = 0x02,		/* Fill the area	      */
+	OLED_XOR = 0x04			/* Invert drawn pixels, color
+					 * is ignored. See below      */
+};
+
+/* Raster operations of drawing routines, as combinations of the above.
+ * Drawing with OLED_XOR twice restores what was under it, so cursors,
+ * selections and sprites are erased by the second pass alone
+ */
+#define OLED_SET	OLED_BLACK	/* Turn pixels on		*/
+#define OLED_CLEAR	OLED_WHITE	/* Turn pixels off		*/
+#define OLED_INVERT	OLED_XOR	/* Flip pixels			*/
+
+enum OLED_opts {
+	/* Bits in mask. Passed to OLED_init as optional last argument */
+	OLED_OPT_PAGEADDR = 0x00,	/* Page addressing mode (default)     */
+	OLED_OPT_HORIZADDR = 0x01,	/* Horizontal addressing mode	      */
+	OLED_OPT_COALESCE = 0x02,	/* See OLED_refresh_async	      */
+	OLED_OPT_CHECKSUM = 0x04	/* Skip unchanged pages, see below    */
+};
+
+/* OLED_OPT_CHECKSUM: refresh keeps CRC-16 of each page as it was sent and
+ * computes it again for every page, sending those whose CRC changed as a
+ * whole and skipping the rest, dirty or not. It catches writes straight to
+ * frame_buffer and drawing which put back what was there, at the cost of
+ * whole pages instead of dirty spans for changed ones and of CRC over the
+ * whole frame on each refresh (about 1.2 ms at 16 MHz for 128x64).
+ * OLED_refresh, scroll stop and dropped transactions still send the whole
+ * frame. Not used by banded displays
+ */
+
+/* Turns of drawing on glass, clockwise. The top of drawing is at the top, */
+/* right, bottom and left edge of glass respectively			   */
+enum OLED_rotation {
+	OLED_ROTATE_0 = 0,
+	OLED_ROTATE_90,
+	OLED_ROTATE_180,
+	OLED_ROTATE_270
+};
+
+/* Time between scroll steps, in frames. Values are SSD1306 encoding */
+enum OLED_scroll_interval {
+	OLED_SCROLL_5_FRAMES = 0,
+	OLED_SCROLL_64_FRAMES,
+	OLED_SCROLL_128_FRAMES,
+	OLED_SCROLL_256_FRAMES,
+	OLED_SCROLL_3_FRAMES,
+	OLED_SCROLL_4_FRAMES,
+	OLED_SCROLL_25_FRAMES,
+	OLED_SCROLL_2_FRAMES
 };
 
 /* Lock type. Need to be volatile to prevent optimizations */
 /* 1 means unlocked, 0 means locked */
 typedef volatile uint8_t	lock_t;
 
+/* SSD1306 has at most 64 rows, which gives 8 pages of 8 rows each */
+#define OLED_MAX_PAGES 8
+
+/* Banded rendering uses one band, or two to rasterize while sending */
+#define OLED_MAX_BANDS 2
+/* Commands put before data: column and page window with data prefix */
+#define OLED_CMD_LEN 13
+/* Init commands following the common ones: geometry and addressing mode */
+#define OLED_INIT_CMD_LEN 12
+/* Scroll setup commands, diagonal one is the longest */
+#define OLED_SCROLL_CMD_LEN 12
+
 
 typedef struct OLED_s_ {
 	uint8_t width;
 	uint8_t height;
 	lock_t busy_lock;	/* Locks when operations on OLED are in process */
 	uint8_t *frame_buffer;	/* A *flat* array which contents are displayed */
+	uint8_t rotation;	/* enum OLED_rotation, see OLED_set_rotation */
 	OLED_I2CWRAP(		/* Included only if no OLED_NO_I2C defined */
 		uint8_t i2c_addr;
+		uint8_t opts;		/* enum OLED_opts given to init	   */
+		/* Commands are built per display, as they stay in use till */
+		/* sent and displays on one bus are refreshed at once	    */
+		uint8_t cmd[OLED_CMD_LEN];	/* Page or window of refresh */
+		uint8_t cmd_init[OLED_INIT_CMD_LEN];
+		uint8_t cmd_brightness[4];
+		uint8_t cmd_startline[2];
+		uint8_t cmd_orient[4];
+		uint8_t cmd_scroll[OLED_SCROLL_CMD_LEN];
+		lock_t scroll_lock;	/* Locked while cmd_scroll is queued */
 		uint8_t cur_page;
 		uint8_t num_pages;
+		uint8_t col_offset;	/* GDDRAM column of panel left edge */
+		/* Changed columns [dirty_from..dirty_to] of each page.	   */
+		/* Page is clean when dirty_from > dirty_to		   */
+		uint8_t dirty_from[OLED_MAX_PAGES];
+		uint8_t dirty_to[OLED_MAX_PAGES];
+		/* Spans taken by refresh in process, same encoding	   */
+		uint8_t tx_from[OLED_MAX_PAGES];
+		uint8_t tx_to[OLED_MAX_PAGES];
+		uint16_t refresh_bytes;	/* Bytes of GDDRAM sent by refresh */
+		/* OLED_OPT_CHECKSUM. CRC of each page when it was sent, bit */
+		/* of page in sum_stale if GDDRAM may differ from it anyway  */
+		uint16_t page_sum[OLED_MAX_PAGES];
+		uint8_t sum_stale;
+		void (*refresh_cbk)(void *);	/* Called when refresh is over */
+		void *refresh_cbk_args;
+		/* Refresh requested by OLED_refresh_async with coalescing   */
+		/* while another one is on the bus. Starts when that is over */
+		volatile bool is_refresh_pending;
+		uint8_t pending_from[OLED_MAX_PAGES];
+		uint8_t pending_to[OLED_MAX_PAGES];
+		void (*pending_cbk)(void *);
+		void *pending_cbk_args;
+		/* Double buffering. frame_buffer is always the one to draw */
+		/* on, front_buffer is the one being sent. NULL if single   */
+		uint8_t *front_buffer;
+		lock_t tx_lock;		/* Locked while front is being sent */
+		bool is_back_synced;	/* frame_buffer equals front_buffer */
+		/* Banded rendering. Drawing is recorded to display list,   */
+		/* refresh rasterizes it page by page into bands of width   */
+		/* bytes. frame_buffer is NULL then			    */
+		uint8_t *dl;		/* Display list. NULL if not banded */
+		uint16_t dl_size;
+		uint16_t dl_len;
+		uint8_t *bands;
+		uint8_t num_bands;
+		volatile uint8_t bands_busy;	/* Queued for sending	    */
+		uint8_t band_cmd[OLED_MAX_BANDS - 1][OLED_CMD_LEN];	/* First band uses cmd */
+		OLED_STATSWRAP(		/* Per display part of OLED_stats  */
+			uint32_t stat_frames;
+			uint32_t stat_spin_waits;
+			uint32_t stat_refresh_start;
+			uint32_t stat_refresh_cycles;
+		)
 	)
 } OLED;
 
 
 #if !defined(OLED_NO_I2C)
-/* Buffer used to store commands being emmitted to display */
-extern uint8_t OLED_cmdbuffer[OLED_CMDBUFFER_LEN];
+_Static_assert(OLED_CMDBUFFER_LEN > OLED_CMDBUFFER_RESERVE,
+	       "OLED: OLED_CMDBUFFER_LEN must be greater than OLED_CMDBUFFER_RESERVE");
+
+/* Descriptor of I2C transaction: START, address, prefix bytes, data bytes,
+ * STOP (or repeated START if another transaction is queued)
+ */
+typedef struct OLED_i2c_txn_s_ {
+	uint8_t *prefix;	/* Sent first. NULL if none		       */
+	uint8_t *data;		/* Sent after prefix. NULL if none	       */
+	uint8_t (*data_gen)(void *); /* If set, called with cbk_args from ISR  */
+				/* for each data byte instead of reading data */
+	uint16_t data_len;	/* Length of each row of data		       */
+	uint8_t rows;		/* Data rows, at least 1		       */
+	uint8_t skip;		/* Bytes skipped in memory between data rows   */
+	uint8_t prefix_len;
+	uint8_t addr;		/* 7-bit slave address			       */
+	bool is_fastfail;
+	void (*end_cbk)(void *); /* Called from ISR when transaction is over   */
+	void *cbk_args;
+} OLED_i2c_txn;
+
+/* Ring queue of transactions being emmitted to display */
+extern OLED_i2c_txn OLED_cmdbuffer[OLED_CMDBUFFER_LEN];
+
+
+/* OLED_i2c_tx_shed() - queues I2C write transaction
+ * @addr:	7-bit slave address
+ * @prefix:	bytes sent first (i.e. SSD1306 control and command bytes)
+ * @prefix_len:	length of prefix
+ * @bytes:	bytes sent after prefix. NULL if none
+ * @bytes_len:	length of bytes
+ * @end_cbk:	called from ISR after transaction is over. May be NULL
+ * @cbk_args:	argument passed to end_cbk
+ * @fastfail:	do not send again if it fails on the bus
+ *
+ * Never waits. Returns false if queue is full. Transactions are sent in order
+ * by ISR, which goes from one to another with repeated START without
+ * returning to main loop. Transaction of several data rows (a window of
+ * frame buffer) lets the queued one go first between rows, if it is for
+ * another address. Prefix and bytes must stay valid till end_cbk.
+ * end_cbk is called before the next transaction starts, so it may queue a
+ * transaction of its own. Such calls get OLED_CMDBUFFER_RESERVE slots which
+ * are not available otherwise, so chaining from end_cbk never fails
+ */
+bool OLED_i2c_tx_shed(uint8_t addr, uint8_t *prefix, uint8_t prefix_len, uint8_t *bytes, uint16_t bytes_len,
+		      void (*end_cbk)(void *), void *cbk_args, bool fastfail);
+#endif
+
+
+#if !defined(OLED_NO_I2C) && !defined(OLED_SPI)
+/* Cumulative TWI error counters. SPI has no acknowledge, so none are there */
+typedef struct OLED_i2c_errors_s_ {
+	uint16_t nacks;		/* Address or data byte not acknowledged */
+	uint16_t arb_lost;	/* Arbitration lost to another master	 */
+	uint16_t bus_errors;	/* Any other unexpected TWSR status	 */
+	uint16_t retries;	/* Transactions sent again		 */
+	uint16_t drops;		/* Transactions given up on		 */
+	uint16_t timeouts;	/* Bus recovered by watchdog		 */
+} OLED_i2c_errors;
+
+
+/* OLED_i2c_errors_snapshot() - copies TWI error counters
+ * @errors:	where to put them
+ * @reset:	zero counters after copying
+ */
+void OLED_i2c_errors_snapshot(OLED_i2c_errors *errors, bool reset);
+
+
+/* OLED_i2c_watchdog() - counts a wait for the bus
+ *
+ * Called by library from its wait loops. If TWI interrupt has not come for
+ * OLED_I2C_WATCHDOG_SPINS calls while transaction is on the bus, the slave
+ * is clocked out of SDA, STOP is made and transaction is dropped. Drawing
+ * of a display which lost data is then refreshed as a whole. Call it from
+ * own loops waiting for the library.
+ * Clocking takes about 100 us and keeps interrupts as the caller has them,
+ * so called from ISR it delays other interrupts for as long
+ */
+void OLED_i2c_watchdog(void);
+#define OLED_WATCHDOG_() OLED_i2c_watchdog()
+#else
+#define OLED_WATCHDOG_() do { } while (0)
 #endif
 
 
 /* Inlines should be declared in headers */
 /* For more: https://gcc.gnu.org/onlinedocs/gcc/Inline.htm */
 
-/* Unlocks the busy lock (independent of its original condition) */
+#if !defined(OLED_NO_I2C)
+/* Starts refresh left pending by OLED_refresh_async while display was
+ * locked, if it is still pending and lock is free. Used by OLED_unlock
+ */
+void OLED_refresh_pending_(OLED *oled);
+#endif
+
+/* Unlocks the busy lock (independent of its original condition). Refresh
+ * requested by OLED_refresh_async while it was locked starts then
+ */
 inline ALWAYSINLINE void OLED_unlock(OLED *oled)
 {
 	oled->busy_lock = 1;
@@ -104,6 +390,12 @@ inline ALWAYSINLINE void OLED_unlock(OLED *oled)
 	/*	ldi r0, lo8(1)		*/
 	/* 	movw r30, r24	  	*/
 	/*	std Z+6, r0		*/
+	OLED_I2CWRAP(
+		/* Request is made along with a check of lock, atomically. */
+		/* So it is either seen here, or made on unlocked display  */
+		if (oled->is_refresh_pending)
+			OLED_refresh_pending_(oled);
+	)
 }
 
 
@@ -117,32 +409,46 @@ inline ALWAYSINLINE void OLED_unlock(OLED *oled)
  *     ...OLED is busy. Do other stuff...
  * }
  */
-#ifdef __AVR_XMEGA__
-inline ALWAYSINLINE bool OLED_trylock(OLED *oled)
+#if !defined(__AVR__)
+inline ALWAYSINLINE bool OLED_lock_try_(lock_t *lock)
+{
+	/* Host build (see host/). Simply do it with interrupts disabled    */
+	uint8_t sreg = SREG;
+	cli();
+	uint8_t val = *lock;
+	*lock = 0;
+	SREG = sreg;
+	/* Lock was captured if it was unlocked (1) before */
+	return val;
+}
+#elif defined(__AVR_XMEGA__)
+inline ALWAYSINLINE bool OLED_lock_try_(lock_t *lock)
 {
 	/* Relies on assembly directives. For more, see:		    */
 	/* https://www.nongnu.org/avr-libc/user-manual/inline_asm.html 	    */
 	/* And LAC in AVR Instruction Set Manual 			    */
-	/* %0 is Z register (ptr is read-only, destination is read-written) */
-	/* %1 is r0...r31 (read-write)					    */
+	/* %0 is r0...r31 (read-write)					    */
+	/* %1 is Z register (ptr is read-only, destination is read-written) */
 	/* Works like:   (but is atomic, single instruction)		    */
 	/* lock_t old = busy_lock; 				            */
 	/* busy_lock = busy_lock & ~val;				    */
 	/* val = old;							    */
 
-	bool val = true;
-	asm volatile("lac %0, %A1" :
-		     "z" (&oled->busy_lock) :
-		     "+r" (val));
-	return !val;
+	uint8_t val = 1;
+	asm volatile("lac %a1, %0" :
+		     "+r" (val) :
+		     "z" (lock) :
+		     "memory");
+	/* Lock was captured if it was unlocked (1) before */
+	return val;
 }
 #else
-inline ALWAYSINLINE bool OLED_trylock(OLED *oled)
+inline ALWAYSINLINE bool OLED_lock_try_(lock_t *lock)
 {
 	/* We do not have atomic instructions on non-XMEGA cores, so try to */
 	/* stick with what's available					    */
 
-	bool val;
+	uint8_t val;
 	asm volatile(
 		/* Read SREG containing Interrupts Enabled flag to tmp reg */
 			"in __tmp_reg__, __SREG__\n\t"
@@ -156,19 +462,30 @@ inline ALWAYSINLINE bool OLED_trylock(OLED *oled)
 			"out __SREG__, __tmp_reg__" :
 		/* Attributes below */
 			"=&r" (val) :
-			"z" (&oled->busy_lock)
+			"z" (lock) :
+			"memory"
 		);
-	return !val;
+	/* Lock was captured if it was unlocked (1) before */
+	return val;
 }
 #endif
 
 
+inline ALWAYSINLINE bool OLED_trylock(OLED *oled)
+{
+	return OLED_lock_try_(&oled->busy_lock);
+}
+
+
 /* Cycles till the lock is unlocked, acquires it and only then exits
  * (!) Warning: may cause deadlock (infinite wait for resource to free)
  */
 inline ALWAYSINLINE bool OLED_spinlock(OLED *oled)
 {
-	while (!OLED_trylock(oled));
+	while (!OLED_trylock(oled)) {
+		OLED_STATSWRAP(oled->stat_spin_waits++;)
+		OLED_WATCHDOG_();
+	}
 	return true;
 }
 
@@ -207,48 +524,435 @@ inline ALWAYSINLINE bool OLED_spinlock(OLED *oled)
 #define OLED_WITH_TRYLOCK(...) OLED_WITH_TRYLOCK_N(, ##__VA_ARGS__, OLED_WITH_TRYLOCK_2(__VA_ARGS__), OLED_WITH_TRYLOCK_1(__VA_ARGS__))
 
 
-OLED_err __OLED_init(OLED *oled, uint8_t width, uint8_t height, uint8_t *frame_buffer, uint32_t i2c_freq_hz, uint8_t i2c_addr);
+/* OLED_init() - initializes OLED object and sends init sequence to display
+ * @o:		OLED object
+ * @w:		display width in pixels
+ * @h:		display height in pixels
+ * @fb:		frame buffer of (w * h / 8) bytes
+ * @freq:	I2C frequency, Hz. With OLED_SPI, SPI clock, Hz (at most F_CPU / 2)
+ * @addr:	7-bit I2C address of display. With OLED_SPI, CS pin number (0..7)
+ * @opts:	optional. Mask of enum OLED_opts, OLED_OPT_PAGEADDR by default
+ *
+ * With OLED_OPT_HORIZADDR display is switched to horizontal addressing mode.
+ * Refresh then sends column and page window commands and data in a single
+ * transaction. Dirty spans are either sent as one bounding window or as one
+ * window per page, whatever takes less bytes on the bus. Full frame goes
+ * as one transaction of (w * h / 8) data bytes.
+ *
+ * Several displays may share the bus, each with OLED object of its own and
+ * a distinct address. The bus is set up by the first OLED_init, freq of the
+ * later ones is ignored. Their refreshes may run at once and take turns page
+ * by page; OLED_CMDBUFFER_RESERVE must be not less than number of displays.
+ *
+ * Panels of 128x64, 128x32, 96x16, 72x40, 64x48 and 64x32 are supported.
+ * Multiplex ratio and COM pins of the panel are sent along with the init
+ * sequence, and its column offset is added by refresh, which sends only
+ * (w * h / 8) bytes at most. Returns OLED_EPARAMS for any other size.
+ * Address is checked at compile time, __OLED_init with OLED_SPI returns
+ * OLED_EPARAMS for CS pin above 7
+ */
+OLED_err __OLED_init(OLED *oled, uint8_t width, uint8_t height, uint8_t *frame_buffer, uint32_t i2c_freq_hz, uint8_t i2c_addr, uint8_t opts);
+#define OLED_OPTS_N_(a0, a1, a2, ...) a2
+#define OLED_OPTS_(...) OLED_OPTS_N_(, ##__VA_ARGS__, (__VA_ARGS__), OLED_OPT_PAGEADDR)
+#if defined(OLED_SPI)
+#define OLED_FREQ_ASSERT_(freq)									  \
+	_Static_assert(((freq) >= F_CPU / 128) && ((freq) <= F_CPU / 2),			  \
+		       "OLED_init: SPI hz freq must be in range [F_CPU/128...F_CPU/2]")
+#define OLED_ADDR_ASSERT_(addr)									  \
+	_Static_assert((addr) < 8,								  \
+		       "OLED_init: SPI CS pin must be in range [0...7]")
+#else
+#define OLED_FREQ_ASSERT_(freq)									  \
+	_Static_assert(((freq) > F_CPU / 32656 + 1) && ((freq) <= F_CPU / 16),			  \
+		       "OLED_init: I2C hz freq must be in range [1+F_CPU/32656...F_CPU/16]")
+#define OLED_ADDR_ASSERT_(addr)									  \
+	_Static_assert(((addr) & 0x80) == 0,							  \
+		       "OLED_init: I2C address must be 7-bit wide")
+#endif
 #ifdef OLED_NO_I2C
 #define OLED_init(o, w, h, fb, ...) ({								  \
 	_Static_assert(!((w) % 8) && !((h) % 8),							  \
 		       "OLED_init: Both width and height MUST BE a multiple of 8");		  \
-	OLED_err __err = __OLED_init((o), (w), (h), (fb), ##__VA_ARGS__);			  \
+	OLED_GEOMETRY_ASSERT_(w, h);								  \
+	OLED_err __err = __OLED_init((o), (w), (h), (fb), 0, 0, 0);				  \
 	__err; })
 #else
-#define OLED_init(o, w, h, fb, freq, addr) ({							  \
+#define OLED_init(o, w, h, fb, freq, addr, ...) ({						  \
 	_Static_assert(!((w) % 8) && !((h) % 8),							  \
 		       "OLED_init: Both width and height MUST BE a multiple of 8");		  \
-	_Static_assert(((freq) > F_CPU / 32656 + 1) && ((freq) <= F_CPU / 16),			  \
-		       "OLED_init: I2C hz freq must be in range [1+F_CPU/32656...F_CPU/16]");	  \
-	_Static_assert(((addr) & 0x80) == 0,							  \
-		       "OLED_init: I2C address must be 7-bit wide");				  \
-	OLED_err __err = __OLED_init((o), (w), (h), (fb), (freq), (addr));			  \
+	OLED_GEOMETRY_ASSERT_(w, h);								  \
+	OLED_FREQ_ASSERT_(freq);								  \
+	OLED_ADDR_ASSERT_(addr);								  \
+	OLED_err __err = __OLED_init((o), (w), (h), (fb), (freq), (addr), OLED_OPTS_(__VA_ARGS__)); \
 	__err; })
+
+
+/* OLED_init_double() - initializes double buffered OLED
+ * @front:	buffer being sent to display, (w * h / 8) bytes
+ * @back:	buffer to draw on, (w * h / 8) bytes
+ * Other arguments are the same as for OLED_init
+ *
+ * Drawing routines always work on oled->frame_buffer, which is the back
+ * buffer here. Use OLED_swap to present it. OLED_refresh and
+ * OLED_refresh_dirty act as OLED_swap with copy forward on such OLED
+ */
+#define OLED_init_double(o, w, h, front, back, freq, addr, ...) ({				  \
+	OLED_err __errd = OLED_init((o), (w), (h), (back), (freq), (addr), ##__VA_ARGS__);	  \
+	(o)->front_buffer = (front);								  \
+	__errd; })
+
+
+/* OLED_init_banded() - initializes OLED without frame buffer
+ * @bands:	num_bands buffers of w bytes each, one after another
+ * @num_bands:	1 or 2 (OLED_MAX_BANDS)
+ * @dl:		display list buffer
+ * @dl_size:	size of dl, bytes
+ * Other arguments are the same as for OLED_init
+ *
+ * Drawing routines do not draw, but record what they draw to display list
+ * (3..15 bytes per call, text takes its length more). Refresh rasterizes the
+ * list page by page into a band and sends it, so a 128x64 display takes
+ * 128 or 256 bytes of bands instead of 1024 bytes of frame buffer. With two
+ * bands the next page is rasterized while the previous one is on the bus.
+ * Recorded items are only removed all together by OLED_dl_clear, drawing
+ * returns OLED_ENOMEM when list is full. Bitmaps and masks, as well as
+ * strings in program memory, are recorded by pointer, so they must stay
+ * unchanged until the list is cleared.
+ * Inline OLED_put_pixel_ can not be used, as it writes to frame buffer.
+ * Not available with OLED_STATIC_WIDTH and OLED_STATIC_HEIGHT
+ */
+void __OLED_init_banded(OLED *oled, uint8_t *bands, uint8_t num_bands, uint8_t *dl, uint16_t dl_size);
+#define OLED_init_banded(o, w, h, bands, num_bands, dl, dl_size, freq, addr, ...) ({		  \
+	OLED_BANDED_ASSERT_();									  \
+	OLED_err __errb = OLED_init((o), (w), (h), NULL, (freq), (addr), ##__VA_ARGS__);	  \
+	__OLED_init_banded((o), (bands), (num_bands), (dl), (dl_size));			  \
+	__errb; })
 #endif
 
 
 #if !defined(OLED_NO_I2C)
 // TODO: document these
 
-/* Sets display brightness. Uses spinlock */
+/* Sets display brightness. Does not wait for refresh in process, command is
+ * queued in between its transactions. Waits only if transaction queue is full
+ */
 void OLED_cmd_setbrightness(OLED *oled, uint8_t level);
 
 
-/* Output frame_buffer contents to display. Uses spinlock */
+/* OLED_cmd_scroll() - starts continuous hardware scrolling
+ * @oled:	OLED object
+ * @left:	scroll to the left, otherwise to the right
+ * @page_from:	first page of scrolled area
+ * @page_to:	last page of scrolled area
+ * @interval:	time between steps of one column, enum OLED_scroll_interval
+ * @voffset:	rows the whole display is moved up by on each step. With 0
+ *		scrolling is horizontal only, otherwise it is diagonal
+ *
+ * Display moves GDDRAM contents by itself, nothing is sent while it scrolls.
+ * Setup is queued like OLED_cmd_setbrightness; waits only if the previous
+ * one has not been sent yet. Returns OLED_EPARAMS if area is out of display
+ */
+OLED_err OLED_cmd_scroll(OLED *oled, bool left, uint8_t page_from, uint8_t page_to,
+			 enum OLED_scroll_interval interval, uint8_t voffset);
+
+
+/* Stops hardware scrolling. GDDRAM is left moved, so whole frame is marked
+ * dirty to be sent by the next refresh
+ */
+void OLED_cmd_scroll_stop(OLED *oled);
+
+
+/* Sets row of GDDRAM shown at the top of display (0..63), which scrolls
+ * display vertically with no data sent. Queued like OLED_cmd_setbrightness
+ */
+void OLED_cmd_startline(OLED *oled, uint8_t line);
+
+
+/* OLED_set_rotation() - sets orientation of display and drawing
+ * @oled:	OLED object
+ * @rotation:	enum OLED_rotation
+ *
+ * Half turn is done by display itself: segment remap and COM scan direction
+ * are reversed, so it costs nothing when drawing. Quarter turns swap width
+ * and height of drawing: its point (x, y) goes to column width - 1 - y, row
+ * x of frame buffer. Pixels, rectangles and shapes have their coordinates
+ * turned, blits and text are turned by 8x8 blocks with a bit transpose, so
+ * they still write whole page bytes. OLED_ROTATE_270 is a half turn on
+ * display plus a quarter turn of drawing.
+ * Frame buffer is not redrawn, but is sent again by the next refresh, as
+ * reversed segment remap applies only to data written after it. Commands
+ * are queued like OLED_cmd_setbrightness.
+ * Returns OLED_EPARAMS for quarter turns of banded display
+ *
+ * (!) Notice: OLED_put_pixel_, OLED_mark_dirty, OLED_anim_frame, hardware
+ *     scrolling and frame buffer itself stay in coordinates of glass.
+ *     Console, strip chart and grayscale can't be set up on display turned
+ *     by a quarter. Polygon fill leaves out right and bottom edges of glass,
+ *     not of drawing
+ */
+OLED_err OLED_set_rotation(OLED *oled, enum OLED_rotation rotation);
+
+
+/* Output whole frame_buffer contents to display. Uses spinlock */
 void OLED_refresh(OLED *oled);
+
+
+/* OLED_refresh_dirty() - output only changed parts of frame_buffer
+ * @oled:	OLED object
+ *
+ * For each page with changes only the span of columns, which were touched by
+ * drawing routines since the previous refresh, is sent. Clean pages are not
+ * addressed at all. Changes are forgotten as soon as span is taken for
+ * sending, so drawing done while refresh is in process is sent by next one.
+ * After refresh finishes (lock is released), oled->refresh_bytes holds the
+ * number of GDDRAM bytes it has sent. Uses spinlock
+ */
+void OLED_refresh_dirty(OLED *oled);
+
+
+/* OLED_refresh_async() - starts OLED_refresh_dirty without waiting
+ * @oled:	single buffered OLED object
+ * @cbk:	called from ISR when refresh is over. May be NULL
+ * @cbk_args:	argument passed to cbk
+ *
+ * Returns OLED_EBUSY at once if display is locked, or if transaction queue
+ * has no free slot to start refresh with, so it is safe to call from timer
+ * interrupt. With OLED_OPT_COALESCE given to OLED_init a locked display
+ * gives OLED_EOK instead, and refresh starts from page 0 as soon as lock is
+ * released: right from ISR at the end of refresh on the bus, or in
+ * OLED_unlock. Requests made meanwhile are merged into it, the last one
+ * wins: only its cbk is called. Drawing done after the request is sent by
+ * the next one.
+ * If nothing is dirty, refresh is over at once and cbk is called before
+ * OLED_refresh_async returns, in context of its caller.
+ * Returns OLED_EPARAMS for banded or double buffered OLED
+ */
+OLED_err OLED_refresh_async(OLED *oled, void (*cbk)(void *), void *cbk_args);
+
+
+/* Returns true if no refresh, animation frame or swap of OLED is on the bus */
+inline ALWAYSINLINE bool OLED_is_idle(OLED *oled)
+{
+	return oled->busy_lock && oled->tx_lock;
+}
+
+
+/* Polling period of OLED_wait_idle, us */
+#define OLED_WAIT_POLL_US 10
+
+/* OLED_wait_idle() - waits till OLED_is_idle
+ * @oled:	OLED object
+ * @timeout_ms:	longest wait, ms. Time spent in interrupts is not counted
+ *
+ * Returns OLED_EBUSY on timeout
+ */
+OLED_err OLED_wait_idle(OLED *oled, uint16_t timeout_ms);
+
+
+/* OLED_swap() - presents back buffer of double buffered OLED
+ * @oled:		OLED object initialized with OLED_init_double
+ * @copy_forward:	copy changes of presented frame to the new back buffer
+ *
+ * Back buffer becomes front and its dirty spans are sent in background, then
+ * swap returns at once. Drawing continues on the former front buffer. With
+ * copy_forward it is brought up to date with the presented frame, so UI can
+ * be drawn incrementally. Without it, the new back buffer holds the frame
+ * before the presented one and has to be redrawn completely (whole frame
+ * is sent by the next swap then).
+ * The only wait is for the previous frame to leave the bus. Uses spinlock
+ * for the swap itself only, so drawing under lock is not stalled by transfer
+ */
+void OLED_swap(OLED *oled, bool copy_forward);
+
+
+/* Removes everything recorded to display list of banded OLED */
+void OLED_dl_clear(OLED *oled);
+
+
+/* OLED_mark_dirty() - marks area as changed to be sent by OLED_refresh_dirty
+ * @oled:	OLED object
+ * @x_from:	left column
+ * @y_from:	top row
+ * @x_to:	right column
+ * @y_to:	bottom row
+ *
+ * Drawing routines mark what they change by themselves. Use this only after
+ * writing to frame_buffer directly. Coordinates out of bounds are clipped
+ */
+void OLED_mark_dirty(OLED *oled, uint8_t x_from, uint8_t y_from, uint8_t x_to, uint8_t y_to);
 #endif
 
+#if !defined(OLED_NO_I2C)
+/* Animation stream, made by tools/oled_anim.py, is kept in program memory:
+ *	header:	number of frames (16 bit, little endian), width, pages
+ *	frame:	spans, then OLED_ANIM_END_OF_FRAME
+ *	span:	first page << 4 | last page, first column, number of columns,
+ *		then RLE codes of span window bytes (page by page)
+ *	code:	0x00..0x7F - (code + 1) literal bytes follow
+ *		0x80..0xFF - next byte is repeated (code - 0x80 + 1) times
+ * Spans hold only what has changed since the previous frame, which display
+ * still shows. First frame holds everything
+ */
+#define OLED_ANIM_HEADER_LEN	4
+#define OLED_ANIM_END_OF_FRAME	0xFF
+
+/* Animation player state */
+typedef struct OLED_anim_s_ {
+	const uint8_t *data;	/* Animation stream			*/
+	const uint8_t *pos;	/* Next byte of stream to be decoded	*/
+	OLED *oled;		/* Display frame is being sent to	*/
+	uint16_t num_frames;
+	uint16_t frame;		/* Frames sent so far			*/
+	uint8_t page, page_to;	/* Window of span being sent		*/
+	uint8_t col, ncols;
+	uint8_t run_left;	/* Bytes left in current RLE run	*/
+	uint8_t run_byte;	/* Byte of repeat run			*/
+	bool is_repeat;
+} OLED_anim;
+
+
+/* OLED_anim_init() - prepares animation for playback
+ * @oled:	OLED object animation is played on
+ * @anim:	player state
+ * @data:	animation stream in program memory
+ *
+ * Returns OLED_EPARAMS if animation does not fit display
+ */
+OLED_err OLED_anim_init(OLED *oled, OLED_anim *anim, const uint8_t *data);
+
+
+/* Makes animation start from the first frame again */
+void OLED_anim_rewind(OLED_anim *anim);
+
+
+/* OLED_anim_frame() - sends next frame of animation in background
+ * @oled:	OLED object
+ * @anim:	player state made by OLED_anim_init
+ *
+ * Frame is decoded from program memory by TWI ISR byte by byte, as it goes
+ * to the bus, so frame_buffer is not used. It even may be NULL, if display
+ * only plays animations. Otherwise, the whole frame_buffer is sent by the
+ * next refresh. Waits while previous frame or refresh is on the bus, so
+ * calling it in a loop plays animation at bus speed. Like refresh, holds
+ * spinlock (single buffered OLED) while frame is sent.
+ * Returns false if there are no frames left
+ */
+bool OLED_anim_frame(OLED *oled, OLED_anim *anim);
+#endif
+
+#if defined(OLED_STATS) && !defined(OLED_NO_I2C)
+/* Performance counters. Time is measured in OLED_STATS_TCNT ticks (CPU
+ * cycles with default Timer1 setup)
+ */
+typedef struct OLED_stats_s_ {
+	/* Counted for each display */
+	uint32_t frames;		/* Refreshes completed		      */
+	uint32_t spin_waits;		/* Spinlock iterations spent waiting  */
+	uint32_t last_refresh_cycles;	/* Duration of last refresh	      */
+	/* Counted for the bus, shared by all displays on it */
+	uint32_t bytes;			/* Bytes sent by TWI ISR	      */
+	uint32_t txns;			/* Transactions completed	      */
+	uint32_t shed_fails;		/* OLED_i2c_tx_shed failed, queue full*/
+	uint32_t isr_cycles;		/* Total time spent in TWI ISR	      */
+	uint16_t isr_cycles_max;	/* Longest TWI ISR run		      */
+} OLED_stats;
+
+
+/* OLED_stats_snapshot() - copies performance counters
+ * @oled:	OLED object
+ * @stats:	where counters of display and bus are copied
+ * @reset:	reset counters after copying
+ *
+ * ISR time does not include prologue and epilogue added by compiler.
+ * Refresh duration is kept in 32 bits, extended from 16-bit timer on each
+ * TWI interrupt, so it is valid while TWI ISR runs at least once per timer
+ * overflow, which is always the case during refresh
+ */
+void OLED_stats_snapshot(OLED *oled, OLED_stats *stats, bool reset);
+#endif
+
+
+#if defined(OLED_PACER) && !defined(OLED_NO_I2C)
+/* Frame pacer counters */
+typedef struct OLED_pacer_stats_s_ {
+	uint32_t frames;	/* Refreshes started			      */
+	uint32_t clean;		/* Deadlines with nothing to send	      */
+	uint32_t missed;	/* Deadlines hit while previous frame was on  */
+				/* the bus, or bus was taken by another user  */
+	uint32_t deferred;	/* Deadlines hit while OLED was locked. Frame */
+				/* is started as soon as lock is released     */
+} OLED_pacer_stats;
+
+
+/* OLED_pacer_start() - refreshes display at fixed rate from Timer1 interrupt
+ * @oled:	single buffered OLED object
+ * @fps:	frames per second
+ *
+ * On each deadline dirty spans are sent with OLED_refresh_async, clean frame
+ * is not sent at all. So main loop only draws, under OLED_WITH_SPINLOCK as
+ * pacer may start refresh at any moment. Drawing without lock may lose
+ * changes made while refresh takes dirty spans.
+ * Takes Timer1 compare A and its interrupt. Timer1 must run in normal mode
+ * with no prescaling (as OLED_STATS sets it up), it is started so if it is
+ * stopped. Only one display is paced. Requires OLED_PACER to be defined.
+ * Returns OLED_EPARAMS for banded or double buffered OLED
+ */
+OLED_err OLED_pacer_start(OLED *oled, uint8_t fps);
+
+
+/* Stops pacing. Refresh on the bus, if any, is finished */
+void OLED_pacer_stop(void);
+
+
+/* OLED_pacer_bus_take() - lends the bus to another driver (i.e. sensor)
+ * @us:		time the bus is needed for, us
+ *
+ * Succeeds if nothing is on the bus and the next deadline is at least us
+ * away. Transactions of displays are only queued till OLED_pacer_bus_give,
+ * deadline hit meanwhile is missed. Other driver should leave bit rate and
+ * TWEN as they are and must poll TWINT with TWIE cleared, as TWI interrupt
+ * is handled by this driver. OLED_pacer_bus_give sets TWIE again.
+ * Returns false if the bus can't be taken now
+ */
+bool OLED_pacer_bus_take(uint16_t us);
+
+
+/* Returns the bus taken by OLED_pacer_bus_take, starting queued transactions */
+void OLED_pacer_bus_give(void);
+
+
+/* Copies pacer counters, resetting them if reset is set */
+void OLED_pacer_stats_snapshot(OLED_pacer_stats *stats, bool reset);
+#endif
+
+
+/* Inline dirty span update for page, without checks. Used by draw routines */
+inline ALWAYSINLINE void OLED_mark_dirty_(OLED *oled, uint8_t page, uint8_t x_from, uint8_t x_to)
+{
+#if !defined(OLED_NO_I2C)
+	if (x_from < oled->dirty_from[page])
+		oled->dirty_from[page] = x_from;
+	if (x_to > oled->dirty_to[page])
+		oled->dirty_to[page] = x_to;
+#else
+	(void)oled; (void)page; (void)x_from; (void)x_to;
+#endif
+}
+
 /* Inline put pixel, without checks. See the full method below		     */
 /* Used to allow GCC to optimize other draw routines which use put_pixel     */
-inline ALWAYSINLINE void OLED_put_pixel_(OLED *oled, uint8_t x, uint8_t y, bool pixel_state)
+inline ALWAYSINLINE void OLED_put_pixel_(OLED *oled, uint8_t x, uint8_t y, uint8_t pixel_state)
 {
 	/* Find byte index in flat array */
-	uint16_t byte_num = (y / 8) * (uint16_t)oled->width + x;
+	uint16_t byte_num = (y / 8) * (uint16_t)OLED_WIDTH_(oled) + x;
 	uint8_t bit_y = y % 8;
-	if (pixel_state)
+	if (OLED_XOR & pixel_state)
+		oled->frame_buffer[byte_num] ^= (1 << bit_y);
+	else if (pixel_state)
 		oled->frame_buffer[byte_num] |= (1 << bit_y);
 	else
 		oled->frame_buffer[byte_num] &= ~(1 << bit_y);
+	OLED_mark_dirty_(oled, y / 8, x, x);
 }
 
 
@@ -256,7 +960,10 @@ inline ALWAYSINLINE void OLED_put_pixel_(OLED *oled, uint8_t x, uint8_t y, bool
  * @oled:	OLED object
  * @x:		horizonal coordinate (starting at 0, left-to-right)
  * @y:		vertical coordinate (starting at 0, top-to-bottom)
- * @pixel_state	value of the pixel (0 or 1)
+ * @pixel_state	value of the pixel (0 or 1), or OLED_XOR to invert it
+ *
+ * Returns OLED_EPARAMS for any other pixel_state, OLED_EBOUNDS if pixel is
+ * out of display
  *
  * Use inline OLED_put_pixel_ for faster output, but without checks
  *
@@ -267,12 +974,315 @@ inline ALWAYSINLINE void OLED_put_pixel_(OLED *oled, uint8_t x, uint8_t y, bool
  * 	OLED_put_pixel(&oled, 10, 20, 1);
  * }
  */
-OLED_err OLED_put_pixel(OLED *oled, uint8_t x, uint8_t y, bool pixel_state);
+OLED_err OLED_put_pixel(OLED *oled, uint8_t x, uint8_t y, uint8_t pixel_state);
+
+
+/* OLED_put_rectangle() - draws rectangle outline or filled rectangle
+ * @oled:	OLED object
+ * @x_from, @y_from, @x_to, @y_to: opposite corners, in any order
+ * @params:	color, OLED_FILL to fill the area. With OLED_XOR pixels of
+ *		outline or area are inverted, each of them once
+ *
+ * Coordinates beyond display bounds are moved to its edges. Works on whole
+ * page bytes, so a filled area costs its width per page touched.
+ * Returns OLED_EBOUNDS if all of coordinates are out of bounds
+ *
+ * (!) Notice: method is not atomic. If required, protect it with lock
+ */
+OLED_err OLED_put_rectangle(OLED *oled, uint8_t x_from, uint8_t y_from, uint8_t x_to, uint8_t y_to, enum OLED_params params);
+
+
+/* Shapes below take signed coordinates in range of +-OLED_COORD_LIMIT and
+ * may lie partially or completely off display. They are clipped once before
+ * drawing, not pixel by pixel. With OLED_XOR no pixel is inverted twice
+ */
+#define OLED_COORD_LIMIT 4095
+
+/* Vertex of polygon */
+typedef struct OLED_point_s_ {
+	int16_t x, y;
+} OLED_point;
+
+/* Most vertices of polygon */
+#define OLED_POLY_MAX 16
+
+
+/* OLED_put_line() - draws line between two points, both included
+ * @oled:	OLED object
+ * @x0, @y0, @x1, @y1: ends of line
+ * @params:	color or OLED_XOR
+ *
+ * Pixel at step k along the longer axis is shifted along the shorter one by
+ * k * d_short / d_long, rounded. Steps off display are skipped at once, and
+ * pixels of a vertical run within a page go to their byte together.
+ * Horizontal and vertical lines are filled as OLED_put_rectangle does.
+ * Returns OLED_EPARAMS for coordinates out of range or other params
+ *
+ * (!) Notice: shapes are not atomic. If required, protect them with lock
+ */
+OLED_err OLED_put_line(OLED *oled, int16_t x0, int16_t y0, int16_t x1, int16_t y1, enum OLED_params params);
+
+
+/* OLED_put_circle() - draws midpoint circle or filled circle
+ * @oled:	OLED object
+ * @x, @y:	center
+ * @r:		radius, 0 is a single pixel
+ * @params:	color, OLED_FILL to fill it, OLED_XOR
+ *
+ * Filled circle is drawn as one vertical span per column, each span filling
+ * whole page bytes. Outline is checked against display bounds pixel by
+ * pixel only if it is not completely on display
+ */
+OLED_err OLED_put_circle(OLED *oled, int16_t x, int16_t y, uint8_t r, enum OLED_params params);
+
+
+/* OLED_put_polygon() - draws closed polygon outline or filled polygon
+ * @oled:	OLED object
+ * @pts:	3..OLED_POLY_MAX vertices, in order. Copied by banded OLED
+ * @n:		number of vertices
+ * @params:	color, OLED_FILL to fill it, OLED_XOR
+ *
+ * Outline is made of lines, each vertex drawn once. Fill goes column by
+ * column: pixels whose centers are inside by even-odd rule are filled as
+ * vertical spans, so self-intersecting polygons have holes. Shared edges of
+ * adjacent filled polygons are not drawn twice, thus fill does not include
+ * right and bottom edges: draw outline over it if they are needed
+ */
+OLED_err OLED_put_polygon(OLED *oled, const OLED_point *pts, uint8_t n, enum OLED_params params);
+
+
+/* OLED_put_triangle() - OLED_put_polygon of three vertices */
+OLED_err OLED_put_triangle(OLED *oled, int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+			   int16_t x2, int16_t y2, enum OLED_params params);
+
+
+/* Modes of OLED_blit. Only pixels set in mask (if given) are changed	  */
+enum OLED_blit_mode {
+	OLED_BLIT_COPY = 0,	/* Replace pixels with bitmap		  */
+	OLED_BLIT_OR,		/* Set pixels which are set in bitmap	  */
+	OLED_BLIT_ANDNOT,	/* Clear pixels which are set in bitmap	  */
+	OLED_BLIT_XOR,		/* Invert pixels which are set in bitmap  */
+	OLED_BLIT_COPYINV	/* Replace pixels with inverted bitmap	  */
+};
+
+
+/* OLED_blit() - draws bitmap from RAM at specified coordinates
+ * @oled:	OLED object
+ * @x:		left column, may be negative
+ * @y:		top row, may be negative
+ * @w:		bitmap width
+ * @h:		bitmap height
+ * @bitmap:	page-organized bitmap: (h + 7) / 8 pages of w bytes each,
+ *		LSB of byte is the top row of page (same as frame_buffer)
+ * @mask:	bitmap of the same layout, pixels cleared in it are left
+ *		intact (transparent). NULL if whole bitmap is opaque
+ * @mode:	how bitmap is combined with frame_buffer, enum OLED_blit_mode
+ *
+ * Works on whole bytes: each bitmap page is shifted by y % 8 across two
+ * frame_buffer pages. When y is a multiple of 8, no mask is given and mode is
+ * OLED_BLIT_COPY, pages are copied with memcpy. Bitmap is clipped by display
+ * bounds, so sprites may move partially off-screen. Returns OLED_EBOUNDS if
+ * nothing of it is visible
+ *
+ * (!) Notice: method is not atomic. If required, protect it with lock
+ */
+OLED_err OLED_blit(OLED *oled, int16_t x, int16_t y, uint8_t w, uint8_t h, const uint8_t *bitmap,
+		   const uint8_t *mask, enum OLED_blit_mode mode);
+
+
+/* Same as OLED_blit, with bitmap and mask in program memory */
+OLED_err OLED_blit_P(OLED *oled, int16_t x, int16_t y, uint8_t w, uint8_t h, const uint8_t *bitmap,
+		     const uint8_t *mask, enum OLED_blit_mode mode);
+
+/* Bitmap font. Descriptor and all data it points to are in program memory.
+ * Each glyph is a page-organized bitmap like frame_buffer: (height + 7) / 8
+ * pages of glyph width bytes, LSB of byte is the top row of page. So glyph
+ * columns are copied to frame_buffer as is when text is page-aligned.
+ * Fonts could be made from BDF with tools/bdf2oled.py, see oled_fonts.h for
+ * the built-in ones
+ */
+typedef struct OLED_font_s_ {
+	uint8_t height;			/* Glyph height, pixels		      */
+	uint8_t width;			/* Glyph width, 0 for proportional    */
+	uint8_t spacing;		/* Blank columns after each glyph     */
+	uint8_t first;			/* Character code of the first glyph  */
+	uint8_t last;			/* Character code of the last glyph   */
+	const uint8_t *widths;		/* Proportional: width of each glyph  */
+	const uint16_t *offsets;	/* Proportional: glyph bitmap offsets */
+	const uint8_t *bitmaps;		/* Glyph bitmaps, one after another   */
+} OLED_font;
 
 
-/* OLED_put_rectangle() - ...
- * ...
+/* OLED_put_char() - draws character at specified coordinates
+ * @oled:	OLED object
+ * @font:	font in program memory
+ * @x:		left column of glyph
+ * @y:		top row of glyph
+ * @c:		character
+ * @params:	color of glyph. With OLED_FILL its background (including
+ *		spacing) is drawn with opposite color, otherwise it is kept.
+ *		With OLED_XOR glyph pixels are inverted and OLED_FILL is
+ *		ignored
+ *
+ * Glyph is clipped by display bounds. Fastest when y is a multiple of 8 and
+ * OLED_BLACK | OLED_FILL is used: glyph columns are copied with memcpy_P then.
+ * Returns OLED_EPARAMS if font has no glyph for c
  *
  * (!) Notice: method is not atomic. If required, protect it with lock
  */
-OLED_err OLED_put_rectangle(OLED *oled, uint8_t x_from, uint8_t y_from, uint8_t x_to, uint8_t y_to, enum OLED_params params);
\ No newline at end of file
+OLED_err OLED_put_char(OLED *oled, const OLED_font *font, uint8_t x, uint8_t y, char c, enum OLED_params params);
+
+
+/* OLED_put_string() - draws string, see OLED_put_char
+ *
+ * Characters are put left-to-right until the right edge of display, the
+ * last one may be clipped. Characters which font has no glyph for are skipped
+ */
+OLED_err OLED_put_string(OLED *oled, const OLED_font *font, uint8_t x, uint8_t y, const char *str, enum OLED_params params);
+
+
+/* Same as OLED_put_string, with string in program memory (i.e. PSTR("text")) */
+OLED_err OLED_put_string_P(OLED *oled, const OLED_font *font, uint8_t x, uint8_t y, PGM_P str, enum OLED_params params);
+
+
+/* Returns width of string in pixels, as drawn by OLED_put_string */
+uint16_t OLED_string_width(const OLED_font *font, const char *str);
+
+
+#if !defined(OLED_NO_I2C)
+/* Scroll console state */
+typedef struct OLED_console_s_ {
+	OLED *oled;
+	const OLED_font *font;
+	enum OLED_params params;
+	uint8_t top;		/* Page holding the oldest line, shown on top */
+} OLED_console;
+
+
+/* OLED_console_init() - turns display into a log of text lines
+ * @oled:	single buffered OLED object
+ * @con:	console state
+ * @font:	font in program memory, at most 8 rows high
+ * @params:	text color, OLED_BLACK or OLED_WHITE. Background is opposite
+ *
+ * Clears display and sends it with OLED_refresh. Each line takes one page.
+ * Returns OLED_EPARAMS for banded or double buffered OLED, too high font or
+ * display less than 64 rows high
+ */
+OLED_err OLED_console_init(OLED *oled, OLED_console *con, const OLED_font *font, enum OLED_params params);
+
+
+/* OLED_console_puts() - appends line at the bottom, scrolling the rest up
+ * @con:	console made by OLED_console_init
+ * @str:	text, clipped by the right edge of display
+ *
+ * Oldest line is overwritten in frame_buffer and only its page is sent, then
+ * display start line is moved to show it at the bottom. That is width bytes
+ * of data instead of the whole frame. So frame_buffer holds lines in GDDRAM
+ * order, rotated by start line: do not draw to it between the lines.
+ * Holds spinlock till the line is shown; waits for the previous one
+ */
+void OLED_console_puts(OLED_console *con, const char *str);
+
+
+/* Same as OLED_console_puts, with string in program memory */
+void OLED_console_puts_P(OLED_console *con, PGM_P str);
+#endif
+
+
+/* Strip chart state. Area is whole pages of frame buffer */
+typedef struct OLED_chart_s_ {
+	OLED *oled;
+	uint8_t x_from, x_to;
+	uint8_t page_from, page_to;
+	uint8_t last;		/* Previous value. 0xFF if none */
+	enum OLED_params params;
+} OLED_chart;
+
+
+/* OLED_chart_init() - makes area of display a strip chart and clears it
+ * @oled:	OLED object with frame buffer
+ * @chart:	chart state
+ * @x_from, @x_to: columns of area, x_from < x_to
+ * @page_from, @page_to: pages of area, page_from <= page_to
+ * @params:	trace color, OLED_BLACK or OLED_WHITE. Background is opposite
+ *
+ * Returns OLED_EPARAMS for banded OLED, area beyond display or other params
+ */
+OLED_err OLED_chart_init(OLED *oled, OLED_chart *chart, uint8_t x_from, uint8_t page_from,
+			 uint8_t x_to, uint8_t page_to, enum OLED_params params);
+
+
+/* OLED_chart_push() - scrolls chart left by a column and plots value in the
+ * right-most one
+ * @chart:	chart made by OLED_chart_init
+ * @value:	rows above bottom of area, clipped by its top
+ *
+ * Area is moved with memmove of each page, so it costs a few cycles per
+ * byte instead of a pixel read and write. New value is joined to the
+ * previous one with a vertical span, so the trace is continuous.
+ * The whole area is dirty then: refresh sends it
+ */
+void OLED_chart_push(OLED_chart *chart, uint8_t value);
+
+
+#if defined(OLED_PACER) && !defined(OLED_NO_I2C)
+/* Grey levels, 0 is off and 3 is fully lit */
+#define OLED_GRAY_LEVELS 4
+
+/* Grayscale state. Level of pixel is two bits in two planes, each laid out
+ * like frame_buffer
+ */
+typedef struct OLED_gray_s_ {
+	OLED *oled;
+	uint8_t *planes;	/* Plane of level bit 0, then plane of bit 1 */
+	uint8_t contrast;	/* 0 if planes are weighted by time	     */
+	uint8_t cmd_contrast[2][4];	/* Contrast command of each plane    */
+} OLED_gray;
+
+
+/* OLED_gray_init() - turns display into 4-level grayscale one
+ * @oled:	single buffered OLED object, HORIZADDR is the fastest
+ * @gray:	grayscale state
+ * @planes:	2 planes of (w * h / 8) bytes each, one after another
+ *
+ * Clears planes. Draw with OLED_gray_ routines only, frame_buffer of OLED
+ * is pointed at the plane being sent. Nothing is shown till OLED_gray_start.
+ * Two planes of 128x64 take 2048 B, which is all SRAM of ATmega328P, so
+ * smaller panels or an MCU with more SRAM are needed.
+ * Returns OLED_EPARAMS for banded or double buffered OLED
+ */
+OLED_err OLED_gray_init(OLED *oled, OLED_gray *gray, uint8_t *planes);
+
+
+/* OLED_gray_start() - shows planes one after another from Timer1 interrupt
+ * @gray:	made by OLED_gray_init
+ * @plane_hz:	planes sent per second
+ * @contrast:	0 to weight planes by time: plane of bit 1 stays on display
+ *		twice as long as plane of bit 0. Otherwise both stay for the
+ *		same time and bit 1 plane is shown with this contrast, bit 0
+ *		plane with half of it
+ *
+ * Uses frame pacer, so OLED_pacer_stop stops it and OLED_pacer_stats count
+ * planes. Each plane is a whole frame, so steady grey needs plane_hz of
+ * 150 or more, which SPI can do (3..4 ms per frame) but 400 kHz TWI can't.
+ * Plane is deferred, as for locked OLED, while queue has no room for it
+ * and its contrast command.
+ * Returns OLED_EPARAMS if plane_hz is 0
+ */
+OLED_err OLED_gray_start(OLED_gray *gray, uint16_t plane_hz, uint8_t contrast);
+
+
+/* Grayscale drawing. Same as routines without _gray_, but take level
+ * (0...OLED_GRAY_LEVELS - 1) instead of color. With OLED_FILL background
+ * of text gets the opposite level (3 - level). Return OLED_EPARAMS if
+ * level is out of range
+ */
+OLED_err OLED_gray_put_pixel(OLED_gray *gray, uint8_t x, uint8_t y, uint8_t level);
+OLED_err OLED_gray_put_rectangle(OLED_gray *gray, uint8_t x_from, uint8_t y_from, uint8_t x_to, uint8_t y_to,
+				 uint8_t level, enum OLED_params params);
+OLED_err OLED_gray_put_string(OLED_gray *gray, const OLED_font *font, uint8_t x, uint8_t y, const char *str,
+			      uint8_t level, enum OLED_params params);
+#endif
+
+#endif /* OLED_H_ */
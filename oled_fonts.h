@@ -0,0 +1,12 @@
+/* Built-in fonts for OLED_put_char/OLED_put_string. See OLED_font in oled.h
+ * More fonts could be converted from BDF with tools/bdf2oled.py
+ */
+#ifndef OLED_FONTS_H
+#define OLED_FONTS_H
+
+#include "oled.h"
+
+/* Fixed-width 5x7 font, ASCII 0x20..0x7E. Cell is 6x8 with spacing */
+extern const OLED_font OLED_font5x7;
+
+#endif /* OLED_FONTS_H */
@@ -1,6 +1,7 @@
 #define F_CPU 16000000UL
 
 #include "oled.h"
+#include "oled_fonts.h"
 #include <avr/io.h>
 
 
@@ -60,6 +61,11 @@ int main()
 
 	if (byletter) OLED_refresh(&oled);
 
+	// The same done with text, centered below the line
+	uint8_t text_x = (128 - OLED_string_width(&OLED_font5x7, "ssd1306lib")) / 2;
+	OLED_put_string_P(&oled, &OLED_font5x7, text_x, 49, PSTR("ssd1306lib"), OLED_WHITE);
+	if (byletter) OLED_refresh(&oled);
+
 	bool color = OLED_BLACK;
 	while (1) {
 		/* Horizontal line of 1 px width */
@@ -67,6 +73,7 @@ int main()
 			OLED_put_rectangle(&oled, 10, 47, 117, 47, color);
 		}
 		color = !color;
-		OLED_refresh(&oled);
+		/* Only the line changes, so send just its columns of page 5 */
+		OLED_refresh_dirty(&oled);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+"""Converts BDF bitmap font to OLED_font C source. See OLED_font in oled.h
+
+Usage: bdf2oled.py [options] font.bdf > font.c
+
+Glyph cell is FONT_ASCENT + FONT_DESCENT rows high (font bounding box if
+those are missing), baseline is FONT_ASCENT rows from the top. Each glyph is
+emitted as (height + 7) / 8 pages of its width bytes, LSB is the top row.
+Fixed width fonts use bounding box width for every glyph. Proportional ones
+use DWIDTH of each glyph, with blank columns on the right trimmed unless
+--keep-blank is given. Characters missing in BDF are emitted blank.
+"""
+import argparse
+import sys
+
+
+def parse_bdf(f):
+    props = {}
+    glyphs = {}
+    bbox = None
+    glyph = None
+    in_bitmap = False
+    for line in f:
+        words = line.split()
+        if not words:
+            continue
+        key = words[0]
+        if in_bitmap:
+            if key == 'ENDCHAR':
+                in_bitmap = False
+                if glyph['encoding'] >= 0:
+                    glyphs[glyph['encoding']] = glyph
+                glyph = None
+            else:
+                glyph['rows'].append(int(key, 16))
+        elif key == 'FONTBOUNDINGBOX':
+            bbox = [int(w) for w in words[1:5]]
+        elif key in ('FONT_ASCENT', 'FONT_DESCENT'):
+            props[key] = int(words[1])
+        elif key == 'STARTCHAR':
+            glyph = {'encoding': -1, 'dwidth': None, 'bbx': None, 'rows': []}
+        elif key == 'ENCODING' and glyph is not None:
+            glyph['encoding'] = int(words[1])
+        elif key == 'DWIDTH' and glyph is not None:
+            glyph['dwidth'] = int(words[1])
+        elif key == 'BBX' and glyph is not None:
+            glyph['bbx'] = [int(w) for w in words[1:5]]
+        elif key == 'BITMAP':
+            in_bitmap = True
+    if bbox is None:
+        sys.exit('bdf2oled: no FONTBOUNDINGBOX in font')
+    ascent = props.get('FONT_ASCENT', bbox[1] + bbox[3])
+    descent = props.get('FONT_DESCENT', -bbox[3])
+    return bbox, ascent, descent, glyphs
+
+
+def render(glyph, width, height, ascent):
+    """Returns glyph as list of columns, each one is int with bit n for row n"""
+    cols = [0] * width
+    if glyph is None or glyph['bbx'] is None:
+        return cols
+    w, h, xoff, yoff = glyph['bbx']
+    top = ascent - (yoff + h)
+    rowbits = (w + 7) // 8 * 8
+    for r, bits in enumerate(glyph['rows'][:h]):
+        y = top + r
+        if not 0 <= y < height:
+            continue
+        for c in range(w):
+            x = xoff + c
+            if 0 <= x < width and bits & (1 << (rowbits - 1 - c)):
+                cols[x] |= 1 << y
+    return cols
+
+
+def to_pages(cols, height):
+    data = []
+    for page in range((height + 7) // 8):
+        data += [(col >> (page * 8)) & 0xFF for col in cols]
+    return data
+
+
+def wrap(values, per_line=16):
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append('\t' + ', '.join(str(v) for v in values[i:i + per_line]))
+    return ',\n'.join(lines)
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Convert BDF font to OLED_font C source')
+    ap.add_argument('bdf', help='BDF font file')
+    ap.add_argument('-n', '--name', default='OLED_font',
+                    help='name of OLED_font variable (default: %(default)s)')
+    ap.add_argument('-f', '--first', type=lambda s: int(s, 0), default=0x20,
+                    help='first character code (default: 0x20)')
+    ap.add_argument('-l', '--last', type=lambda s: int(s, 0), default=0x7E,
+                    help='last character code (default: 0x7E)')
+    ap.add_argument('-p', '--proportional', action='store_true',
+                    help='emit proportional font')
+    ap.add_argument('-s', '--spacing', type=int, default=None,
+                    help='blank columns after each glyph (default: 1 for '
+                         'proportional, 0 for fixed width)')
+    ap.add_argument('--keep-blank', action='store_true',
+                    help='do not trim blank right columns of proportional glyphs')
+    args = ap.parse_args()
+
+    with open(args.bdf) as f:
+        bbox, ascent, descent, glyphs = parse_bdf(f)
+    height = ascent + descent
+    if not 0 < height <= 64:
+        sys.exit('bdf2oled: glyph height %d is not supported' % height)
+    if not 0 <= args.first <= args.last <= 0xFF:
+        sys.exit('bdf2oled: wrong character range')
+    spacing = args.spacing
+    if spacing is None:
+        spacing = 1 if args.proportional else 0
+
+    codes = range(args.first, args.last + 1)
+    bitmaps, widths, labels = [], [], []
+    for code in codes:
+        glyph = glyphs.get(code)
+        if args.proportional:
+            width = glyph['dwidth'] if glyph and glyph['dwidth'] else bbox[0]
+            cols = render(glyph, width, height, ascent)
+            if not args.keep_blank:
+                while len(cols) > 1 and not cols[-1] and any(cols):
+                    cols.pop()
+        else:
+            cols = render(glyph, bbox[0], height, ascent)
+        widths.append(len(cols))
+        bitmaps.append(to_pages(cols, height))
+        labels.append(chr(code) if 0x20 < code < 0x7F and chr(code) not in '*/\\' else '0x%02X' % code)
+
+    total = sum(len(b) for b in bitmaps)
+    if total > 0xFFFF:
+        sys.exit('bdf2oled: font is too big (%d bytes)' % total)
+    sym = args.name.lower()
+    out = ['/* Generated by tools/bdf2oled.py from %s */' % args.bdf,
+           '#include "oled.h"',
+           '#include <stddef.h>',
+           '',
+           'static const uint8_t %s_bitmaps[] PROGMEM = {' % sym]
+    pos = 0
+    offsets = []
+    for data, label in zip(bitmaps, labels):
+        offsets.append(pos)
+        pos += len(data)
+        out.append('\t' + ', '.join('0x%02X' % b for b in data) + ',\t/* %s */' % label)
+    out.append('};')
+    if args.proportional:
+        out += ['',
+                'static const uint8_t %s_widths[] PROGMEM = {' % sym,
+                wrap(widths),
+                '};',
+                '',
+                'static const uint16_t %s_offsets[] PROGMEM = {' % sym,
+                wrap(offsets),
+                '};']
+    out += ['',
+            'const OLED_font %s PROGMEM = {' % args.name,
+            '\t.height = %d,' % height,
+            '\t.width = %d,' % (0 if args.proportional else bbox[0]),
+            '\t.spacing = %d,' % spacing,
+            '\t.first = 0x%02X,' % args.first,
+            '\t.last = 0x%02X,' % args.last,
+            '\t.widths = %s,' % (sym + '_widths' if args.proportional else 'NULL'),
+            '\t.offsets = %s,' % (sym + '_offsets' if args.proportional else 'NULL'),
+            '\t.bitmaps = %s_bitmaps' % sym,
+            '};']
+    print('\n'.join(out))
+    print('%s: %d glyphs, %d bytes of bitmaps' % (args.name, len(codes), total), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
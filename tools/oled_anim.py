@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+"""Encodes animation for OLED_anim_frame. See OLED_anim in oled.h
+
+Usage: oled_anim.py [options] frame0.pbm frame1.pbm ... > anim.c
+       oled_anim.py [options] --frame-height 64 strip.pbm > anim.c
+
+Frames are PBM images (P1 or P4), black pixel is lit. A single image with
+--frame-height is split into frames stacked top to bottom. Every frame is
+sent as spans (windows) of what has changed since the previous one, first
+frame is sent whole. Span data is RLE coded. Compression ratio and bus bytes
+are reported to stderr.
+"""
+import argparse
+import sys
+
+# Bus bytes spent on span besides its data, roughly: addressing commands,
+# START, slave address and STOP
+SPAN_OVERHEAD = 16
+
+
+def read_pbm(path):
+    with open(path, 'rb') as f:
+        raw = f.read()
+    tokens = []
+    pos = 0
+
+    def token():
+        nonlocal pos
+        while True:
+            while pos < len(raw) and raw[pos:pos + 1].isspace():
+                pos += 1
+            if raw[pos:pos + 1] == b'#':
+                while pos < len(raw) and raw[pos:pos + 1] != b'\n':
+                    pos += 1
+            else:
+                break
+        start = pos
+        while pos < len(raw) and not raw[pos:pos + 1].isspace():
+            pos += 1
+        return raw[start:pos]
+
+    magic = token()
+    width, height = int(token()), int(token())
+    if magic == b'P4':
+        pos += 1
+        stride = (width + 7) // 8
+        rows = []
+        for y in range(height):
+            line = raw[pos + y * stride:pos + (y + 1) * stride]
+            rows.append([(line[x // 8] >> (7 - x % 8)) & 1 for x in range(width)])
+    elif magic == b'P1':
+        bits = [c - 0x30 for c in raw[pos:] if c in b'01']
+        rows = [bits[y * width:(y + 1) * width] for y in range(height)]
+    else:
+        sys.exit('oled_anim: %s is not a PBM image' % path)
+    if len(rows) != height or any(len(r) != width for r in rows):
+        sys.exit('oled_anim: %s is truncated' % path)
+    return width, height, rows
+
+
+def to_pages(rows, width, height):
+    """Returns frame as list of pages, each one a list of width bytes"""
+    return [[sum(rows[page * 8 + b][x] << b for b in range(8)) for x in range(width)]
+            for page in range(height // 8)]
+
+
+def rle(data):
+    out = []
+    i = 0
+    literal = []
+
+    def flush():
+        while literal:
+            chunk = literal[:128]
+            del literal[:128]
+            out.append(len(chunk) - 1)
+            out.extend(chunk)
+
+    while i < len(data):
+        run = 1
+        while i + run < len(data) and data[i + run] == data[i] and run < 128:
+            run += 1
+        if run >= 3:
+            flush()
+            out += [0x80 | (run - 1), data[i]]
+            i += run
+        else:
+            literal.append(data[i])
+            i += 1
+    flush()
+    return out
+
+
+def changed_runs(old, new, gap):
+    """Returns [from, to] column runs where old and new page differ. Runs
+    closer than gap columns are merged, as sending them is cheaper than
+    starting another span"""
+    runs = []
+    for x in range(len(new)):
+        if old is not None and old[x] == new[x]:
+            continue
+        if runs and x - runs[-1][1] - 1 <= gap:
+            runs[-1][1] = x
+        else:
+            runs.append([x, x])
+    return runs
+
+
+def frame_spans(old, new, gap):
+    """Returns spans (page_from, page_to, col_from, col_to) of the frame,
+    choosing between span per changed run and a single bounding window"""
+    per_page = []
+    for page in range(len(new)):
+        for lo, hi in changed_runs(old[page] if old else None, new[page], gap):
+            per_page.append((page, page, lo, hi))
+    if not per_page:
+        return []
+    p0 = min(s[0] for s in per_page)
+    p1 = max(s[1] for s in per_page)
+    c0 = min(s[2] for s in per_page)
+    c1 = max(s[3] for s in per_page)
+    cost_runs = sum(s[3] - s[2] + 1 + SPAN_OVERHEAD for s in per_page)
+    cost_window = (p1 - p0 + 1) * (c1 - c0 + 1) + SPAN_OVERHEAD
+    return [(p0, p1, c0, c1)] if cost_window <= cost_runs else per_page
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Encode PBM frames for OLED_anim_frame')
+    ap.add_argument('frames', nargs='+', help='PBM frames')
+    ap.add_argument('-n', '--name', default='oled_anim',
+                    help='name of animation array (default: %(default)s)')
+    ap.add_argument('--frame-height', type=int, default=None,
+                    help='split single image into frames of this height')
+    ap.add_argument('--gap', type=int, default=SPAN_OVERHEAD,
+                    help='merge changed runs closer than this (default: %(default)s)')
+    args = ap.parse_args()
+
+    frames = []
+    width = height = None
+    for path in args.frames:
+        w, h, rows = read_pbm(path)
+        fh = args.frame_height or h
+        if h % fh:
+            sys.exit('oled_anim: %s height is not a multiple of %d' % (path, fh))
+        for top in range(0, h, fh):
+            if width is None:
+                width, height = w, fh
+            elif (w, fh) != (width, height):
+                sys.exit('oled_anim: %s differs in size from previous frames' % path)
+            frames.append(rows[top:top + fh])
+    if height % 8 or not 0 < height <= 64 or not 0 < width <= 128:
+        sys.exit('oled_anim: frame must be up to 128x64 with height multiple of 8')
+    if len(frames) > 0xFFFF:
+        sys.exit('oled_anim: too many frames')
+
+    num_pages = height // 8
+    stream = [len(frames) & 0xFF, len(frames) >> 8, width, num_pages]
+    lines = ['\t%s,\t/* %d frames, %dx%d */' % (', '.join('0x%02X' % b for b in stream),
+                                               len(frames), width, height)]
+    prev = None
+    bus_bytes = 0
+    for n, rows in enumerate(frames):
+        cur = to_pages(rows, width, height)
+        code = []
+        for p0, p1, c0, c1 in frame_spans(prev, cur, args.gap):
+            data = [b for page in range(p0, p1 + 1) for b in cur[page][c0:c1 + 1]]
+            code += [p0 << 4 | p1, c0, c1 - c0 + 1] + rle(data)
+            bus_bytes += len(data) + SPAN_OVERHEAD
+        code.append(0xFF)
+        stream += code
+        lines.append('\t/* frame %d */' % n)
+        for i in range(0, len(code), 16):
+            lines.append('\t' + ', '.join('0x%02X' % b for b in code[i:i + 16]) + ',')
+        prev = cur
+
+    raw = len(frames) * width * num_pages
+    print('/* Generated by tools/oled_anim.py */')
+    print('#include "oled.h"')
+    print()
+    print('const uint8_t %s[] PROGMEM = {' % args.name)
+    print('\n'.join(lines))
+    print('};')
+    print('%s: %d frames, %d bytes raw, %d bytes encoded (%.1f:1), ~%d bus bytes '
+          '(%.1f%% of full refreshes)' % (args.name, len(frames), raw, len(stream),
+                                          raw / len(stream), bus_bytes,
+                                          100.0 * bus_bytes / (raw + SPAN_OVERHEAD * len(frames))),
+          file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()